@@ -61,7 +61,13 @@ MainWindow::MainWindow(const QString cfgfile, bool edit_conf, QWidget *parent) :
     d_lnb_lo(0),
     d_hw_freq(0),
     d_fftAvg(0.5),
+    d_fftAvgMode(FFT_AVG_IIR),
+    d_fftDropped(0),
+    d_zoomCenter(0),
+    d_zoomSpan(0),
+    d_zoomRate(0.0),
     d_have_audio(true),
+    d_vfoGui(1),
     dec_afsk1200(0)
 {
     ui->setupUi(this);
@@ -105,12 +111,10 @@ MainWindow::MainWindow(const QString cfgfile, bool edit_conf, QWidget *parent) :
     audio_fft_timer = new QTimer(this);
     connect(audio_fft_timer, SIGNAL(timeout()), this, SLOT(audioFftTimeout()));
 
-    d_fftData = new std::complex<float>[MAX_FFT_SIZE];
-    d_realFftData = new double[MAX_FFT_SIZE];
-    d_pwrFftData = new double[MAX_FFT_SIZE]();
-    d_iirFftData = new double[MAX_FFT_SIZE];
-    for (int i = 0; i < MAX_FFT_SIZE; i++)
-        d_iirFftData[i] = -120.0;  // dBFS
+    /* FFT buffers only grow, see setIqFftSize() */
+    d_fftData.resize(rx->get_iq_fft_size());
+    d_fftLineData.resize(rx->get_iq_fft_size());
+    d_audioFftData.resize(rx->get_audio_fft_size());
 
     /* timer for data decoders */
     dec_timer = new QTimer(this);
@@ -211,14 +215,19 @@ MainWindow::MainWindow(const QString cfgfile, bool edit_conf, QWidget *parent) :
     connect(uiDockAudio, SIGNAL(fftRateChanged(int)), this, SLOT(setAudioFftRate(int)));
     connect(uiDockFft, SIGNAL(fftSizeChanged(int)), this, SLOT(setIqFftSize(int)));
     connect(uiDockFft, SIGNAL(fftRateChanged(int)), this, SLOT(setIqFftRate(int)));
+    connect(uiDockFft, SIGNAL(wfLinesChanged(float,int)), this, SLOT(setWfLines(float,int)));
+    connect(uiDockFft, SIGNAL(wfHistoryChanged(int)), this, SLOT(setWfHistory(int)));
     connect(uiDockFft, SIGNAL(fftSplitChanged(int)), this, SLOT(setIqFftSplit(int)));
     connect(uiDockFft, SIGNAL(fftAvgChanged(double)), this, SLOT(setIqFftAvg(double)));
+    connect(uiDockFft, SIGNAL(fftAvgModeChanged(int)), this, SLOT(setIqFftAvgMode(int)));
+    connect(uiDockFft, SIGNAL(fftOverlapChanged(int)), this, SLOT(setIqFftOverlap(int)));
     connect(uiDockFft, SIGNAL(resetFftZoom()), ui->plotter, SLOT(resetHorizontalZoom()));
     connect(uiDockFft, SIGNAL(gotoFftCenter()), ui->plotter, SLOT(moveToCenterFreq()));
     connect(uiDockFft, SIGNAL(gotoDemodFreq()), ui->plotter, SLOT(moveToDemodFreq()));
     connect(uiDockFft, SIGNAL(fftColorChanged(QColor)), this, SLOT(setFftColor(QColor)));
     connect(uiDockFft, SIGNAL(fftFillToggled(bool)), this, SLOT(setFftFill(bool)));
     connect(uiDockFft, SIGNAL(fftPeakHoldToggled(bool)), this, SLOT(setFftPeakHold(bool)));
+    connect(uiDockFft, SIGNAL(fftPersistenceToggled(bool)), this, SLOT(setFftPersistence(bool)));
     connect(uiDockFft, SIGNAL(peakDetectionToggled(bool)), this, SLOT(setPeakDetection(bool)));
     
     // Bookmarks
@@ -334,10 +343,6 @@ MainWindow::~MainWindow()
     delete uiDockInputCtl;
     delete rx;
     delete remote;
-    delete [] d_fftData;
-    delete [] d_realFftData;
-    delete [] d_iirFftData;
-    delete [] d_pwrFftData;
 }
 
 /*! \brief Load new configuration.
@@ -749,12 +754,14 @@ void MainWindow::selectDemod(QString strModulation)
 
 /*! \brief Select new demodulator.
  *  \param demod New demodulator index.
+ *  \param update_rx Whether to configure the receiver or only the GUI.
  *
  * This slot basically maps the index of the mode selector to receiver::demod
- * and configures the default channel filter.
+ * and configures the default channel filter. The receiver is left alone when
+ * \p update_rx is false, which is used to show the settings of another VFO.
  *
  */
-void MainWindow::selectDemod(int index)
+void MainWindow::selectDemod(int index, bool update_rx)
 {
     //printf("SelectDemod: '%d'\n", index);
 
@@ -762,19 +769,20 @@ void MainWindow::selectDemod(int index)
     float maxdev;
     int filter_preset = uiDockRxOpt->currentFilter();
     int flo=0, fhi=0, click_res=100;
+    receiver::rx_demod demod = rx->get_demod();
 
 
     switch (index) {
 
     case DockRxOpt::MODE_OFF:
         /* Spectrum analyzer only */
-        if (rx->is_recording_audio())
+        if (update_rx && rx->is_recording_audio())
         {
             stopAudioRec();
             uiDockAudio->setAudioRecButtonState(false);
         }
 
-        rx->set_demod(receiver::RX_DEMOD_OFF);
+        demod = receiver::RX_DEMOD_OFF;
         flo = 0;
         fhi = 0;
         click_res = 100;
@@ -788,7 +796,7 @@ void MainWindow::selectDemod(int index)
 
         /* AM */
     case DockRxOpt::MODE_AM:
-        rx->set_demod(receiver::RX_DEMOD_AM);
+        demod = receiver::RX_DEMOD_AM;
         ui->plotter->setDemodRanges(-20000, -250, 250, 20000, true);
         uiDockAudio->setFftRange(0,15000);
         click_res = 100;
@@ -811,7 +819,7 @@ void MainWindow::selectDemod(int index)
 
         /* Narrow FM */
     case DockRxOpt::MODE_NFM:
-        rx->set_demod(receiver::RX_DEMOD_NFM);
+        demod = receiver::RX_DEMOD_NFM;
         click_res = 100;
         maxdev = uiDockRxOpt->currentMaxdev();
         if (maxdev < 20000.0)
@@ -883,14 +891,14 @@ void MainWindow::selectDemod(int index)
             break;
         }
         if (index == DockRxOpt::MODE_WFM_MONO)
-            rx->set_demod(receiver::RX_DEMOD_WFM_M);
+            demod = receiver::RX_DEMOD_WFM_M;
         else
-            rx->set_demod(receiver::RX_DEMOD_WFM_S);
+            demod = receiver::RX_DEMOD_WFM_S;
         break;
 
         /* LSB */
     case DockRxOpt::MODE_LSB:
-        rx->set_demod(receiver::RX_DEMOD_SSB);
+        demod = receiver::RX_DEMOD_SSB;
         ui->plotter->setDemodRanges(-10000, -100, -5000, 0, false);
         uiDockAudio->setFftRange(0,3500);
         click_res = 10;
@@ -913,7 +921,7 @@ void MainWindow::selectDemod(int index)
 
         /* USB */
     case DockRxOpt::MODE_USB:
-        rx->set_demod(receiver::RX_DEMOD_SSB);
+        demod = receiver::RX_DEMOD_SSB;
         ui->plotter->setDemodRanges(0, 5000, 100, 10000, false);
         uiDockAudio->setFftRange(0,3500);
         click_res = 10;
@@ -936,7 +944,7 @@ void MainWindow::selectDemod(int index)
 
         /* CW-L */
     case DockRxOpt::MODE_CWL:
-        rx->set_demod(receiver::RX_DEMOD_SSB);
+        demod = receiver::RX_DEMOD_SSB;
         ui->plotter->setDemodRanges(-10000, -100, -5000, 0, false);
         uiDockAudio->setFftRange(0,1500);
         click_res = 10;
@@ -959,7 +967,7 @@ void MainWindow::selectDemod(int index)
 
         /* CW-U */
     case DockRxOpt::MODE_CWU:
-        rx->set_demod(receiver::RX_DEMOD_SSB);
+        demod = receiver::RX_DEMOD_SSB;
         ui->plotter->setDemodRanges(0, 5000, 100, 10000, false);
         uiDockAudio->setFftRange(0,1500);
         click_res = 10;
@@ -992,7 +1000,23 @@ void MainWindow::selectDemod(int index)
     ui->plotter->setHiLowCutFrequencies(flo, fhi);
     ui->plotter->setClickResolution(click_res);
     ui->plotter->setFilterClickResolution(click_res);
-    rx->set_filter((double)flo, (double)fhi, receiver::FILTER_SHAPE_NORMAL);
+
+    if (update_rx)
+    {
+        if (index != DockRxOpt::MODE_RAW)
+        {
+            // the switch is done by the audio thread, check it a bit later
+            if (demod != rx->get_demod())
+                QTimer::singleShot(250, this, SLOT(reportDemodLatency()));
+            rx->set_demod(demod);
+        }
+        rx->set_filter((double)flo, (double)fhi, receiver::FILTER_SHAPE_NORMAL);
+
+        vfo_gui &vfo = d_vfoGui[rx->get_current_vfo()];
+        vfo.demod = index;
+        vfo.flo = flo;
+        vfo.fhi = fhi;
+    }
 
     d_have_audio = ((index != DockRxOpt::MODE_OFF) && (index != DockRxOpt::MODE_RAW));
 
@@ -1000,6 +1024,19 @@ void MainWindow::selectDemod(int index)
 }
 
 
+/*! \brief Log the latency of the last demodulator switch.
+ *
+ * Nothing is logged when the receiver had to be rebuilt or the switch has
+ * not been picked up by the audio thread yet.
+ */
+void MainWindow::reportDemodLatency()
+{
+    double latency = rx->get_demod_switch_latency();
+
+    if (latency > 0.0)
+        qDebug() << "Demodulator switched in" << latency * 1.0e3 << "ms";
+}
+
 /*! \brief New FM deviation selected.
  *  \param max_dev The enw FM deviation.
  */
@@ -1144,70 +1181,86 @@ void MainWindow::meterTimeout()
     remote->setSignalLevel(level);
 }
 
-/*! \brief Baseband FFT plot timeout. */
+/*! \brief Baseband FFT plot timeout.
+ *
+ * The FFT block delivers ready to plot data, i.e. the shifted and averaged
+ * spectrum in dBFS for the pandapter and the waterfall lines made by the
+ * work thread at their own rate since the previous update.
+ */
 void MainWindow::iqFftTimeout()
 {
     unsigned int fftsize;
-    unsigned int i;
-    double gain;
-    double pwr;
-    std::complex<float> pt;             /* a single FFT point used in calculations */
-    std::complex<float> scaleFactor;    /* normalizing factor (fftsize cast to complex) */
-
+    unsigned int linesize;
+    unsigned long dropped;
 
-    rx->get_iq_fft_data(d_fftData, fftsize);
+    rx->get_iq_fft_data(&d_fftData[0], 0, fftsize);
+    if (fftsize > 0)
+        ui->plotter->setNewFttData(&d_fftData[0], 0, fftsize);
 
-    if (fftsize == 0)
+    /* The waterfall scrolls once for each line. Lines made before an FFT
+     * size change are dropped by the plotter, lines made before a zoom
+     * change are dropped by the receiver. */
+    for (;;)
     {
-        /* nothing to do, wait until next activation. */
-        return;
+        rx->get_iq_fft_line(&d_fftLineData[0], linesize);
+        if (linesize == 0)
+            break;
+
+        ui->plotter->addWaterfallLine(&d_fftLineData[0], linesize);
     }
 
-    scaleFactor = std::complex<float>((float)fftsize);
+    /* Change the zoom only after the lines made with the current zoom have
+     * been plotted with the current data range. */
+    updateFftZoom();
 
-    /** FIXME: move post processing to rx_fft_c **/
-    /* Normalize, calculcate power and shift the FFT */
-    for (i = 0; i < fftsize; i++)
+    /* report if continuous FFT can not keep up */
+    dropped = rx->get_iq_fft_dropped();
+    if (dropped != d_fftDropped)
     {
+        ui->statusBar->showMessage(tr("FFT can not keep up, %1 frames dropped")
+                                   .arg(dropped), 2000);
+        d_fftDropped = dropped;
+    }
+}
 
-        /* normalize and shift */
-        if (i < fftsize/2)
-        {
-            pt = d_fftData[fftsize/2+i] / scaleFactor;
-        }
-        else
-        {
-            pt = d_fftData[i-fftsize/2] / scaleFactor;
-        }
-        pwr = pt.imag()*pt.imag() + pt.real()*pt.real();
-
-        /* calculate power in dBFS */
-        d_realFftData[i] = 10.0 * log10(pwr + 1.0e-20);
-
-        /* FFT averaging (aka. video filter) */
-        gain = d_fftAvg * (150.0+d_realFftData[i])/150.0;
-        //gain = 0.1;
-
-        d_iirFftData[i] = (1.0 - gain) * d_iirFftData[i] + gain * d_realFftData[i];
+/*! \brief Pass the visible part of the spectrum to the baseband FFT.
+ *
+ * The plotter can be zoomed and panned in many ways, so we simply check
+ * the span and center before each update. When zoomed in, the receiver
+ * decimates the visible part before the FFT and the FFT data only covers
+ * that part.
+ */
+void MainWindow::updateFftZoom()
+{
+    qint64 center = ui->plotter->getFftCenterFreq();
+    qint32 span = ui->plotter->getSpanFreq();
+    double rate = ui->plotter->getSampleRate();
+    double zoom_rate;
 
-    }
+    if ((center == d_zoomCenter) && (span == d_zoomSpan) && (rate == d_zoomRate))
+        return;
 
-    ui->plotter->setNewFttData(d_iirFftData, d_realFftData, fftsize);
+    d_zoomCenter = center;
+    d_zoomSpan = span;
+    d_zoomRate = rate;
 
+    zoom_rate = rx->set_iq_fft_zoom(center, span);
+    if (zoom_rate > 0.0)
+        ui->plotter->setFftDataRange(center - (qint64)(zoom_rate / 2.0),
+                                     center + (qint64)(zoom_rate / 2.0));
+    else
+        ui->plotter->setFftDataRange(0, 0);
 }
 
 /*! \brief Audio FFT plot timeout. */
 void MainWindow::audioFftTimeout()
 {
     unsigned int fftsize;
-    unsigned int i;
-    std::complex<float> pt;             /* a single FFT point used in calculations */
-    std::complex<float> scaleFactor;    /* normalizing factor (fftsize cast to complex) */
 
     if (!d_have_audio)
         return;
 
-    rx->get_audio_fft_data(d_fftData, fftsize);
+    rx->get_audio_fft_data(&d_audioFftData[0], fftsize);
 
     if (fftsize == 0)
     {
@@ -1216,27 +1269,7 @@ void MainWindow::audioFftTimeout()
         return;
     }
 
-    scaleFactor = std::complex<float>((float)fftsize);
-
-    /** FIXME: move post processing to rx_fft_f **/
-    /* Normalize, calculcate power and shift the FFT */
-    for (i = 0; i < fftsize; i++)
-    {
-        /* normalize and shift */
-        if (i < fftsize/2)
-        {
-            pt = d_fftData[fftsize/2+i] / scaleFactor;
-        }
-        else
-        {
-            pt = d_fftData[i-fftsize/2] / scaleFactor;
-        }
-
-        /* calculate power in dBFS */
-        d_realFftData[i] = 10.0 * log10(pt.imag()*pt.imag() + pt.real()*pt.real() + 1.0e-20);
-    }
-
-    uiDockAudio->setNewFttData(d_realFftData, fftsize);
+    uiDockAudio->setNewFttData(&d_audioFftData[0], fftsize);
 }
 
 /*! \brief Start audio recorder.
@@ -1468,6 +1501,15 @@ void MainWindow::seekIqFile(qint64 seek_pos)
 void MainWindow::setIqFftSize(int size)
 {
     qDebug() << "Changing baseband FFT size to" << size;
+
+    /* Frames with the old size may still arrive, so the buffers are never
+     * made smaller. The plotter only uses them in setNewFttData(). */
+    if ((unsigned int)size > d_fftData.size())
+    {
+        d_fftData.resize(size);
+        d_fftLineData.resize(size);
+    }
+
     rx->set_iq_fft_size(size);
 }
 
@@ -1484,6 +1526,7 @@ void MainWindow::setIqFftRate(int fps)
     else
     {
         interval = 1000 / fps;
+        ui->plotter->setPersistenceFrames(fps);   // 1 s decay
 
         if (iq_fft_timer->isActive())
             ui->plotter->setRunningState(true);
@@ -1504,10 +1547,59 @@ void MainWindow::setIqFftSplit(int pct_wf)
     }
 }
 
+/*! \brief FFT averaging changed.
+ *  \param avg The averaging parameter between 0 and 1 (1 = no averaging).
+ *
+ * In IIR mode this is the averaging gain; in linear mode it is mapped to
+ * between 1 and MAX_FFT_AVG_FRAMES frames.
+ */
 void MainWindow::setIqFftAvg(double avg)
 {
-    if ((avg >= 0) && (avg <= 1.0))
-        d_fftAvg = avg;
+    unsigned int frames;
+
+    if ((avg < 0) || (avg > 1.0))
+        return;
+
+    d_fftAvg = avg;
+    frames = 1 + (unsigned int)((1.0 - avg) * (MAX_FFT_AVG_FRAMES - 1) + 0.5);
+    rx->set_iq_fft_avg(d_fftAvgMode, d_fftAvg, frames);
+}
+
+/*! \brief FFT averaging mode changed.
+ *  \param mode The new averaging mode (see fft_avg_mode).
+ *
+ * Selecting max or min hold again restarts it.
+ */
+void MainWindow::setIqFftAvgMode(int mode)
+{
+    d_fftAvgMode = mode;
+    setIqFftAvg(d_fftAvg);
+    rx->reset_iq_fft_avg();
+}
+
+/*! \brief FFT overlap changed.
+ *  \param pct The overlap in percent or -1 to disable continuous FFT.
+ */
+void MainWindow::setIqFftOverlap(int pct)
+{
+    rx->set_iq_fft_overlap(pct);
+}
+
+/*! \brief Waterfall line rate or mode has changed.
+ *  \param rate Lines per second, 0 for one line per FFT update.
+ *  \param mode Line mode, see wf_line_mode in dsp/rx_fft.h.
+ */
+void MainWindow::setWfLines(float rate, int mode)
+{
+    rx->set_iq_fft_lines(rate, mode);
+}
+
+/*! \brief Waterfall history size has changed.
+ *  \param mbytes The memory budget of the history in MB.
+ */
+void MainWindow::setWfHistory(int mbytes)
+{
+    ui->plotter->setWaterfallHistorySize((size_t)mbytes << 20);
 }
 
 /*! \brief Audio FFT rate has changed. */
@@ -1541,6 +1633,11 @@ void MainWindow::setFftPeakHold(bool enable)
     ui->plotter->setPeakHold(enable);
 }
 
+void MainWindow::setFftPersistence(bool enable)
+{
+    ui->plotter->setPersistence(enable);
+}
+
 void MainWindow::setPeakDetection(bool enabled)
 {
     ui->plotter->setPeakDetection(enabled ,2);
@@ -1746,7 +1843,11 @@ void MainWindow::on_plotter_newFilterFreq(int low, int high)
     retcode = rx->set_filter((double) low, (double) high, d_filter_shape);
 
     if (retcode == receiver::STATUS_OK)
+    {
         uiDockRxOpt->setFilterParam(low, high);
+        d_vfoGui[rx->get_current_vfo()].flo = low;
+        d_vfoGui[rx->get_current_vfo()].fhi = high;
+    }
 }
 
 void MainWindow::on_plotter_newCenterFreq(qint64 f)
@@ -2050,3 +2151,97 @@ void MainWindow::on_actionAddBookmark_triggered()
     }
 
 }
+
+/*! \brief Select the VFO controlled by the GUI.
+ *  \param vfo The index of the VFO.
+ *  \return True if the VFO was selected.
+ *
+ * The filter offset, mode and filter of the VFO are shown in the GUI without
+ * reconfiguring the receiver.
+ */
+bool MainWindow::selectVfo(int vfo)
+{
+    qint64 offset, rx_freq;
+
+    if (rx->set_current_vfo(vfo) != receiver::STATUS_OK)
+    {
+        ui->statusBar->showMessage(tr("Can not select VFO %1 during audio playback")
+                                   .arg(vfo + 1), 5000);
+        return false;
+    }
+
+    offset = (qint64) rx->get_filter_offset();
+    rx_freq = d_hw_freq + d_lnb_lo + offset;
+    uiDockRxOpt->setFilterOffset(offset);
+    ui->plotter->setFilterOffset(offset);
+    ui->freqCtrl->setFrequency(rx_freq);
+    uiDockAudio->setRxFrequency(rx_freq);
+    remote->setNewFrequency(rx_freq);
+    remote->setFilterOffset(offset);
+    remote->setMode(d_vfoGui[vfo].demod);
+
+    selectDemod(d_vfoGui[vfo].demod, false);
+    ui->plotter->setHiLowCutFrequencies(d_vfoGui[vfo].flo, d_vfoGui[vfo].fhi);
+    uiDockRxOpt->setFilterParam(d_vfoGui[vfo].flo, d_vfoGui[vfo].fhi);
+
+    ui->actionMuteVfo->setChecked(rx->get_vfo_mute(vfo));
+    uiDockAudio->setAudioRecButtonState(rx->is_recording_audio());
+
+    ui->statusBar->showMessage(tr("VFO %1 of %2").arg(vfo + 1)
+                               .arg(rx->get_vfo_count()), 5000);
+
+    return true;
+}
+
+/*! \brief Add a VFO using the current mode and filter.
+ *
+ * The new VFO starts at the current filter offset and becomes the current
+ * VFO, so that it can be tuned away from the old one.
+ */
+void MainWindow::on_actionAddVfo_triggered()
+{
+    vfo_gui gui = d_vfoGui[rx->get_current_vfo()];
+    int vfo;
+
+    if (!d_have_audio)
+    {
+        ui->statusBar->showMessage(tr("Select a demodulator before adding a VFO"), 5000);
+        return;
+    }
+
+    vfo = rx->add_vfo(rx->get_filter_offset(), rx->get_demod());
+    d_vfoGui.push_back(gui);
+
+    if (selectVfo(vfo))
+    {
+        rx->set_filter((double) gui.flo, (double) gui.fhi, d_filter_shape);
+        rx->set_af_gain(float(uiDockAudio->audioGain()) / 10.0);
+    }
+}
+
+/*! \brief Remove the current VFO. The last VFO can not be removed. */
+void MainWindow::on_actionRemoveVfo_triggered()
+{
+    int vfo = rx->get_current_vfo();
+
+    if (rx->remove_vfo(vfo) != receiver::STATUS_OK)
+    {
+        ui->statusBar->showMessage(tr("Can not remove the last VFO"), 5000);
+        return;
+    }
+
+    d_vfoGui.erase(d_vfoGui.begin() + vfo);
+    selectVfo(rx->get_current_vfo());
+}
+
+/*! \brief Control the next VFO. */
+void MainWindow::on_actionNextVfo_triggered()
+{
+    selectVfo((rx->get_current_vfo() + 1) % rx->get_vfo_count());
+}
+
+/*! \brief Mute or unmute the current VFO. */
+void MainWindow::on_actionMuteVfo_triggered(bool checked)
+{
+    rx->set_vfo_mute(rx->get_current_vfo(), checked);
+}
@@ -31,6 +31,7 @@
 #include <QTimer>
 #include <QMessageBox>
 #include <QFileDialog>
+#include <vector>
 
 #include "qtgui/dockrxopt.h"
 #include "qtgui/dockaudio.h"
@@ -79,15 +80,28 @@ private:
     qint64 d_hw_freq;
 
     enum receiver::filter_shape d_filter_shape;
-    std::complex<float>* d_fftData;
-    double *d_realFftData; /** FIXME: use vector */
-    double *d_iirFftData;  /** FIXME: use vector */
-    double *d_pwrFftData;  /** FIXME: use vector */
+    std::vector<float> d_fftData;      /*!< Averaged FFT data in dBFS. */
+    std::vector<float> d_fftLineData;  /*!< Latest waterfall line in dBFS. */
+    std::vector<float> d_audioFftData; /*!< Audio FFT data in dBFS. */
     //double *d_audioFttData;
     double  d_fftAvg;      /*!< FFT averaging parameter set by user (not the true gain). */
+    int     d_fftAvgMode;  /*!< FFT averaging mode (see fft_avg_mode). */
+    unsigned long d_fftDropped; /*!< Number of dropped FFT frames reported so far. */
+    qint64  d_zoomCenter;  /*!< FFT center sent to the receiver. */
+    qint32  d_zoomSpan;    /*!< FFT span sent to the receiver. */
+    double  d_zoomRate;    /*!< Sample rate when the zoom was sent. */
 
     bool d_have_audio;  /*!< Whether we have audio (i.e. not with demod_off. */
 
+    /*! \brief GUI settings of a VFO restored when the VFO is selected. */
+    struct vfo_gui
+    {
+        int demod;  /*!< Mode selector index. */
+        int flo;    /*!< Filter low cut in Hz. */
+        int fhi;    /*!< Filter high cut in Hz. */
+    };
+    std::vector<vfo_gui> d_vfoGui;  /*!< One entry per receiver VFO. */
+
     /* dock widgets */
     DockRxOpt      *uiDockRxOpt;
     DockAudio      *uiDockAudio;
@@ -112,7 +126,9 @@ private:
 
 private:
     void updateFrequencyRange(bool ignore_limits);
+    void updateFftZoom();
     void updateGainStages();
+    bool selectVfo(int vfo);
 
 private slots:
     /* rf */
@@ -129,7 +145,8 @@ private slots:
     void setIqBalance(bool enabled);
     void setIgnoreLimits(bool ignore_limits);
     void selectDemod(QString demod);
-    void selectDemod(int index);
+    void selectDemod(int index, bool update_rx = true);
+    void reportDemodLatency();
     void setFmMaxdev(float max_dev);
     void setFmEmph(double tau);
     void setAmDcr(bool enabled);
@@ -165,11 +182,16 @@ private slots:
     void setIqFftRate(int fps);
     void setIqFftSplit(int pct_wf);
     void setIqFftAvg(double avg);
+    void setIqFftAvgMode(int mode);
+    void setIqFftOverlap(int pct);
+    void setWfLines(float rate, int mode);
+    void setWfHistory(int mbytes);
     void setAudioFftRate(int fps);
     void setFftColor(const QColor color);
     void setFftFill(bool enable);
     void setPeakDetection(bool enabled);
     void setFftPeakHold(bool enable);
+    void setFftPersistence(bool enable);
 
     /* FFT plot */
     void on_plotter_newDemodFreq(qint64 freq, qint64 delta);   /*! New demod freq (aka. filter offset). */
@@ -191,6 +213,10 @@ private slots:
     void on_actionAbout_triggered();
     void on_actionAboutQt_triggered();
     void on_actionAddBookmark_triggered();
+    void on_actionAddVfo_triggered();
+    void on_actionRemoveVfo_triggered();
+    void on_actionNextVfo_triggered();
+    void on_actionMuteVfo_triggered(bool checked);
 
 
     /* window close signals */
@@ -42,6 +42,10 @@
 #include <gnuradio/audio/sink.h>
 #endif
 
+/* Channel bandwidth required by the receivers when using the channelizer. */
+#define NBRX_CHAN_BW   48.0e3
+#define WFMRX_CHAN_BW 240.0e3
+
 
 /*! \brief Public contructor.
  *  \param input_device Input device specifier.
@@ -55,14 +59,12 @@ receiver::receiver(const std::string input_device, const std::string audio_devic
       d_input_rate(96000.0),
       d_audio_rate(48000),
       d_rf_freq(144800000.0),
-      d_filter_offset(0.0),
       d_recording_iq(false),
-      d_recording_wav(false),
       d_sniffer_active(false),
       d_iq_rev(false),
       d_dc_cancel(false),
       d_iq_balance(false),
-      d_demod(RX_DEMOD_OFF)
+      d_current_vfo(0)
 {
 
     tb = gr::make_top_block("gqrx");
@@ -70,12 +72,12 @@ receiver::receiver(const std::string input_device, const std::string audio_devic
     if (input_device.empty())
     {
         // FIXME: other OS
-        src = osmosdr::source::make("file=/dev/random,freq=428e6,rate=96000,repeat=true,throttle=true");
+        create_input("file=/dev/random,freq=428e6,rate=96000,repeat=true,throttle=true");
     }
     else
     {
         input_devstr = input_device;
-        src = osmosdr::source::make(input_device);
+        create_input(input_device);
     }
 
     // create I/Q sink and close it
@@ -83,23 +85,13 @@ receiver::receiver(const std::string input_device, const std::string audio_devic
     iq_sink->set_unbuffered(true);
     iq_sink->close();
 
-    rx = make_nbrx(d_input_rate, d_audio_rate);
-    lo = gr::analog::sig_source_c::make(d_input_rate, gr::analog::GR_SIN_WAVE, 0.0, 1.0);
-    mixer = gr::blocks::multiply_cc::make();
-
-    iq_swap = make_iq_swap_cc(false);
-    dc_corr = make_dc_corr_cc(d_input_rate, 1.0);
-    iq_fft = make_rx_fft_c(4096u, 0);
+    iq_corr = make_iq_corr_cc(d_input_rate, 1.0, d_iq_rev, d_dc_cancel,
+                              d_iq_balance);
+    iq_fft = make_rx_fft_c(4096u, 0, true);
 
     audio_fft = make_rx_fft_f(4096u);
-    audio_gain0 = gr::blocks::multiply_const_ff::make(0.1);
-    audio_gain1 = gr::blocks::multiply_const_ff::make(0.1);
-
-    wav_sink = gr::blocks::wavfile_sink::make("/dev/null", 2,
-                                              (unsigned int) d_audio_rate,
-                                              16);
-
-    audio_udp_sink = make_udp_sink_f();
+    audio_mix0 = gr::blocks::add_ff::make();
+    audio_mix1 = gr::blocks::add_ff::make();
 
 #ifdef WITH_PULSEAUDIO
     audio_snk = make_pa_sink(audio_device, d_audio_rate, "GQRX", "Audio output");
@@ -112,9 +104,11 @@ receiver::receiver(const std::string input_device, const std::string audio_devic
     /* wav sink and source is created when rec/play is started */
     audio_null_sink0 = gr::blocks::null_sink::make(sizeof(float));
     audio_null_sink1 = gr::blocks::null_sink::make(sizeof(float));
-    sniffer = make_sniffer_f();
-    /* sniffer_rr is created at each activation. */
+    sniffer = make_sniffer_f(48000, false);
+    sniffer_rr = make_resampler_ff(1.0);
+    d_sniffer_rate = (unsigned int) d_audio_rate;
 
+    d_vfo.push_back(make_vfo(0.0, RX_DEMOD_OFF));
     set_demod(RX_DEMOD_NFM);
 
 #ifndef QT_NO_DEBUG_OUTPUT
@@ -186,10 +180,11 @@ void receiver::set_input_device(const std::string device)
         tb->wait();
     }
 
-    tb->disconnect(src, 0, iq_swap, 0);
-    src.reset();
-    src = osmosdr::source::make(device);
-    tb->connect(src, 0, iq_swap, 0);
+    tb->disconnect(input_block(), 0, iq_sink, 0);
+    tb->disconnect(input_block(), 0, iq_corr, 0);
+    create_input(device);
+    tb->connect(input_block(), 0, iq_sink, 0);
+    tb->connect(input_block(), 0, iq_corr, 0);
 
     if (d_running)
         tb->start();
@@ -219,8 +214,7 @@ void receiver::set_output_device(const std::string device)
 
     tb->lock();
 
-    tb->disconnect(audio_gain0, 0, audio_snk, 0);
-    tb->disconnect(audio_gain1, 0, audio_snk, 1);
+    connect_audio_sink(false);
     audio_snk.reset();
 
 #ifdef WITH_PULSEAUDIO
@@ -229,8 +223,7 @@ void receiver::set_output_device(const std::string device)
     audio_snk = gr::audio::sink::make(d_audio_rate, device, true);
 #endif
 
-    tb->connect(audio_gain0, 0, audio_snk, 0);
-    tb->connect(audio_gain1, 0, audio_snk, 1);
+    connect_audio_sink(true);
 
     tb->unlock();
 }
@@ -238,29 +231,53 @@ void receiver::set_output_device(const std::string device)
 /*! \brief Get a list of available antenna connectors. */
 std::vector<std::string> receiver::get_antennas(void)
 {
+    if (!src)
+        return std::vector<std::string>();
+
     return src->get_antennas();
 }
 
 /*! \brief Select antenna conenctor. */
 void receiver::set_antenna(const std::string &antenna)
 {
-    src->set_antenna(antenna);
+    if (src)
+        src->set_antenna(antenna);
 }
 
 /*! \brief Set new input sample rate.
  *  \param rate The desired input rate
  *  \return The actual sample rate set.
+ *
+ * The rate of a raw source is given in its device string, so the requested
+ * rate is ignored in that case.
  */
 double receiver::set_input_rate(double rate)
 {
     tb->lock();
-    src->set_sample_rate(rate);
-    d_input_rate = src->get_sample_rate();
-    dc_corr->set_sample_rate(d_input_rate);
-    rx->set_quad_rate(d_input_rate);
-    lo->set_sampling_freq(d_input_rate);
+    if (raw_src)
+    {
+        d_input_rate = raw_src->sample_rate();
+    }
+    else
+    {
+        src->set_sample_rate(rate);
+        d_input_rate = src->get_sample_rate();
+    }
+    iq_corr->set_sample_rate(d_input_rate);
+    if (!channelizer)
+    {
+        for (unsigned int i = 0; i < d_vfo.size(); i++)
+        {
+            d_vfo[i].rx->set_quad_rate(d_input_rate);
+            d_vfo[i].lo->set_sampling_freq(d_input_rate);
+        }
+    }
     tb->unlock();
 
+    // the channelizer is designed for a specific input rate
+    if (channelizer || num_active_vfos() > 1)
+        reconnect_all();
+
     return d_input_rate;
 }
 
@@ -277,12 +294,18 @@ double receiver::get_input_rate()
  */
 double receiver::set_analog_bandwidth(double bw)
 {
+    if (!src)
+        return d_input_rate;
+
     return src->set_bandwidth(bw);
 }
 
 /*! \brief Get current analog bandwidth. */
 double receiver::get_analog_bandwidth()
 {
+    if (!src)
+        return d_input_rate;
+
     return src->get_bandwidth();
 }
 
@@ -295,7 +318,7 @@ void receiver::set_iq_swap(bool reversed)
         return;
 
     d_iq_rev = reversed;
-    iq_swap->set_enabled(d_iq_rev);
+    iq_corr->set_iq_swap(d_iq_rev);
 }
 
 /*! \brief Get current I/Q reversed setting.
@@ -316,12 +339,7 @@ void receiver::set_dc_cancel(bool enable)
         return;
 
     d_dc_cancel = enable;
-
-    // until we have a way to switch on/off
-    // inside the dc_corr_cc we do a reconf
-    rx_demod demod = d_demod;
-    d_demod = RX_DEMOD_OFF;
-    set_demod(demod);
+    iq_corr->set_dc_remove(enable);
 }
 
 /*! \brief Get auto DC cancel status.
@@ -342,8 +360,7 @@ void receiver::set_iq_balance(bool enable)
         return;
 
     d_iq_balance = enable;
-
-    src->set_iq_balance_mode(enable ? 2 : 0);
+    iq_corr->set_iq_balance(enable);
 }
 
 /*! \brief Get auto I/Q balance status.
@@ -363,7 +380,8 @@ receiver::status receiver::set_rf_freq(double freq_hz)
 {
     d_rf_freq = freq_hz;
 
-    src->set_center_freq(d_rf_freq);
+    if (src)
+        src->set_center_freq(d_rf_freq);
     // FIXME: read back frequency?
 
     return STATUS_OK;
@@ -375,7 +393,8 @@ receiver::status receiver::set_rf_freq(double freq_hz)
  */
 double receiver::get_rf_freq()
 {
-    d_rf_freq = src->get_center_freq();
+    if (src)
+        d_rf_freq = src->get_center_freq();
 
     return d_rf_freq;
 }
@@ -390,6 +409,9 @@ receiver::status receiver::get_rf_range(double *start, double *stop, double *ste
 {
     osmosdr::freq_range_t range;
 
+    if (!src)
+        return STATUS_ERROR;
+
     range = src->get_freq_range();
 
     // currently range is empty for all but E4000
@@ -411,6 +433,9 @@ receiver::status receiver::get_rf_range(double *start, double *stop, double *ste
 /*! \brief Get the names of available gain stages. */
 std::vector<std::string> receiver::get_gain_names()
 {
+    if (!src)
+        return std::vector<std::string>();
+
     return src->get_gain_names();
 }
 
@@ -426,6 +451,9 @@ receiver::status receiver::get_gain_range(std::string &name, double *start, doub
 {
     osmosdr::gain_range_t range;
 
+    if (!src)
+        return STATUS_ERROR;
+
     range = src->get_gain_range(name);
     *start = range.start();
     *stop  = range.stop();
@@ -436,6 +464,9 @@ receiver::status receiver::get_gain_range(std::string &name, double *start, doub
 
 receiver::status receiver::set_gain(std::string name, double value)
 {
+    if (!src)
+        return STATUS_ERROR;
+
     src->set_gain(value, name);
 
     return STATUS_OK;
@@ -443,6 +474,9 @@ receiver::status receiver::set_gain(std::string name, double value)
 
 double receiver::get_gain(std::string name)
 {
+    if (!src)
+        return 0.0;
+
     return src->get_gain(name);
 }
 
@@ -453,6 +487,9 @@ double receiver::get_gain(std::string name)
  */
 receiver::status receiver::set_auto_gain(bool automatic)
 {
+    if (!src)
+        return STATUS_ERROR;
+
     src->set_gain_mode(automatic);
 
     return STATUS_OK;
@@ -474,8 +511,25 @@ receiver::status receiver::set_auto_gain(bool automatic)
  */
 receiver::status receiver::set_filter_offset(double offset_hz)
 {
-    d_filter_offset = offset_hz;
-    lo->set_frequency(-d_filter_offset);
+    rx_vfo &vfo = d_vfo[d_current_vfo];
+
+    vfo.filter_offset = offset_hz;
+
+    if (vfo.chan >= 0)
+    {
+        int chan = channelizer->chan_for_offset(offset_hz);
+
+        if (chan != vfo.chan)
+        {
+            tb->lock();
+            tb->disconnect(channelizer, vfo.chan, vfo_input(vfo), 0);
+            tb->connect(channelizer, chan, vfo_input(vfo), 0);
+            tb->unlock();
+            vfo.chan = chan;
+        }
+    }
+
+    tune_vfo(vfo);
 
     return STATUS_OK;
 }
@@ -486,7 +540,7 @@ receiver::status receiver::set_filter_offset(double offset_hz)
  */
 double receiver::get_filter_offset()
 {
-    return d_filter_offset;
+    return d_vfo[d_current_vfo].filter_offset;
 }
 
 
@@ -514,7 +568,7 @@ receiver::status receiver::set_filter(double low, double high, filter_shape shap
 
     }
 
-    rx->set_filter(low, high, trans_width);
+    d_vfo[d_current_vfo].rx->set_filter(low, high, trans_width);
 
     return STATUS_OK;
 }
@@ -540,7 +594,8 @@ receiver::status receiver::set_filter_shape(filter_shape shape)
 
 receiver::status receiver::set_freq_corr(double ppm)
 {
-    src->set_freq_corr(ppm);
+    if (src)
+        src->set_freq_corr(ppm);
 
     return STATUS_OK;
 }
@@ -554,7 +609,7 @@ receiver::status receiver::set_freq_corr(double ppm)
  */
 float receiver::get_signal_pwr(bool dbfs)
 {
-    return rx->get_signal_level(dbfs);
+    return d_vfo[d_current_vfo].rx->get_signal_level(dbfs);
 }
 
 /*! \brief Set new FFT size. */
@@ -563,20 +618,118 @@ void receiver::set_iq_fft_size(int newsize)
     iq_fft->set_fft_size(newsize);
 }
 
-/*! \brief Get latest baseband FFT data. */
-void receiver::get_iq_fft_data(std::complex<float>* fftPoints, unsigned int &fftsize)
+/*! \brief Get current baseband FFT size. */
+unsigned int receiver::get_iq_fft_size(void)
+{
+    return iq_fft->get_fft_size();
+}
+
+/*! \brief Get current audio FFT size. */
+unsigned int receiver::get_audio_fft_size(void)
+{
+    return audio_fft->get_fft_size();
+}
+
+/*! \brief Set baseband FFT averaging.
+ *  \param mode The averaging mode (see fft_avg_mode in dsp/rx_fft.h).
+ *  \param gain The IIR averaging gain between 0 and 1 (1 = no averaging).
+ *  \param frames The number of frames used in linear averaging.
+ */
+void receiver::set_iq_fft_avg(int mode, float gain, unsigned int frames)
+{
+    iq_fft->set_fft_avg(mode, gain, frames);
+}
+
+/*! \brief Restart baseband FFT averaging (clears max and min hold). */
+void receiver::reset_iq_fft_avg(void)
+{
+    iq_fft->reset_fft_avg();
+}
+
+/*! \brief Set baseband FFT overlap.
+ *  \param overlap The overlap in percent or -1 to disable continuous mode.
+ *
+ * In continuous mode the baseband FFT covers all samples and each update
+ * shows the mean power spectrum since the previous one.
+ */
+void receiver::set_iq_fft_overlap(int overlap)
+{
+    if (overlap < 0)
+    {
+        iq_fft->set_continuous(false);
+    }
+    else
+    {
+        iq_fft->set_overlap(1.0e-2 * overlap);
+        iq_fft->set_continuous(true);
+    }
+}
+
+/*! \brief Get number of baseband FFT frames dropped in continuous mode. */
+unsigned long receiver::get_iq_fft_dropped(void)
+{
+    return iq_fft->get_dropped_frames();
+}
+
+/*! \brief Set the part of the baseband that is shown on the FFT plot.
+ *  \param center The center of the plot relative to the input center.
+ *  \param span The span of the plot.
+ *  \returns The frequency range covered by the FFT data around center, or
+ *           0 if the FFT data covers the full input rate.
+ *
+ * When the span is small enough the baseband FFT switches to zoom mode,
+ * where it decimates the plotted part of the spectrum before the FFT so
+ * that it is resolved by the full FFT size.
+ */
+double receiver::set_iq_fft_zoom(double center, double span)
+{
+    iq_fft->set_zoom(d_input_rate, center, span);
+
+    return rx_fft_c::zoom_rate(d_input_rate, span);
+}
+
+/*! \brief Get latest baseband FFT data.
+ *  \param fftPoints Buffer for the averaged spectrum in dBFS.
+ *  \param rawPoints Buffer for the latest, unaveraged spectrum in dBFS.
+ *  \param fftsize The FFT size or 0 if there is no new data (output).
+ */
+void receiver::get_iq_fft_data(float *fftPoints, float *rawPoints, unsigned int &fftsize)
+{
+    iq_fft->get_fft_data(fftPoints, rawPoints, fftsize);
+}
+
+/*! \brief Set the rate of waterfall lines from the baseband FFT.
+ *  \param rate Lines per second, 0 for one line per FFT update.
+ *  \param mode How the FFT frames since the previous line are combined
+ *              (see wf_line_mode in dsp/rx_fft.h).
+ */
+void receiver::set_iq_fft_lines(float rate, int mode)
+{
+    iq_fft->set_line_rate(rate, mode);
+}
+
+/*! \brief Get the oldest waterfall line not yet taken.
+ *  \param linePoints Buffer for the line in dBFS.
+ *  \param size The number of points or 0 if there are no more lines (output).
+ *
+ * Lines made before the latest set_iq_fft_zoom() that changed the FFT data
+ * are skipped.
+ */
+void receiver::get_iq_fft_line(float *linePoints, unsigned int &size)
 {
-    iq_fft->get_fft_data(fftPoints, fftsize);
+    iq_fft->get_line_data(linePoints, size);
 }
 
-/*! \brief Get latest audio FFT data. */
-void receiver::get_audio_fft_data(std::complex<float>* fftPoints, unsigned int &fftsize)
+/*! \brief Get latest audio FFT data in dBFS. */
+void receiver::get_audio_fft_data(float *fftPoints, unsigned int &fftsize)
 {
-    audio_fft->get_fft_data(fftPoints, fftsize);
+    audio_fft->get_fft_data(0, fftPoints, fftsize);
 }
 
 receiver::status receiver::set_nb_on(int nbid, bool on)
 {
+    receiver_base_cf_sptr rx = d_vfo[d_current_vfo].rx;
+
     if (rx->has_nb())
         rx->set_nb_on(nbid, on);
 
@@ -585,6 +738,8 @@ receiver::status receiver::set_nb_on(int nbid, bool on)
 
 receiver::status receiver::set_nb_threshold(int nbid, float threshold)
 {
+    receiver_base_cf_sptr rx = d_vfo[d_current_vfo].rx;
+
     if (rx->has_nb())
         rx->set_nb_threshold(nbid, threshold);
 
@@ -597,6 +752,8 @@ receiver::status receiver::set_nb_threshold(int nbid, float threshold)
  */
 receiver::status receiver::set_sql_level(double level_db)
 {
+    receiver_base_cf_sptr rx = d_vfo[d_current_vfo].rx;
+
     if (rx->has_sql())
         rx->set_sql_level(level_db);
 
@@ -607,6 +764,8 @@ receiver::status receiver::set_sql_level(double level_db)
 /*! \brief Set squelch alpha */
 receiver::status receiver::set_sql_alpha(double alpha)
 {
+    receiver_base_cf_sptr rx = d_vfo[d_current_vfo].rx;
+
     if (rx->has_sql())
         rx->set_sql_alpha(alpha);
 
@@ -619,6 +778,8 @@ receiver::status receiver::set_sql_alpha(double alpha)
  */
 receiver::status receiver::set_agc_on(bool agc_on)
 {
+    receiver_base_cf_sptr rx = d_vfo[d_current_vfo].rx;
+
     if (rx->has_agc())
         rx->set_agc_on(agc_on);
 
@@ -628,6 +789,8 @@ receiver::status receiver::set_agc_on(bool agc_on)
 /*! \brief Enable/disable AGC hang. */
 receiver::status receiver::set_agc_hang(bool use_hang)
 {
+    receiver_base_cf_sptr rx = d_vfo[d_current_vfo].rx;
+
     if (rx->has_agc())
         rx->set_agc_hang(use_hang);
 
@@ -637,6 +800,8 @@ receiver::status receiver::set_agc_hang(bool use_hang)
 /*! \brief Set AGC threshold. */
 receiver::status receiver::set_agc_threshold(int threshold)
 {
+    receiver_base_cf_sptr rx = d_vfo[d_current_vfo].rx;
+
     if (rx->has_agc())
         rx->set_agc_threshold(threshold);
 
@@ -646,6 +811,8 @@ receiver::status receiver::set_agc_threshold(int threshold)
 /*! \brief Set AGC slope. */
 receiver::status receiver::set_agc_slope(int slope)
 {
+    receiver_base_cf_sptr rx = d_vfo[d_current_vfo].rx;
+
     if (rx->has_agc())
         rx->set_agc_slope(slope);
 
@@ -655,6 +822,8 @@ receiver::status receiver::set_agc_slope(int slope)
 /*! \brief Set AGC decay time. */
 receiver::status receiver::set_agc_decay(int decay_ms)
 {
+    receiver_base_cf_sptr rx = d_vfo[d_current_vfo].rx;
+
     if (rx->has_agc())
         rx->set_agc_decay(decay_ms);
 
@@ -664,78 +833,55 @@ receiver::status receiver::set_agc_decay(int decay_ms)
 /*! \brief Set fixed gain used when AGC is OFF. */
 receiver::status receiver::set_agc_manual_gain(int gain)
 {
+    receiver_base_cf_sptr rx = d_vfo[d_current_vfo].rx;
+
     if (rx->has_agc())
         rx->set_agc_manual_gain(gain);
 
     return STATUS_OK; // FIXME
 }
 
+/*! \brief Select demodulator of the current VFO.
+ *  \param demod The new demodulator.
+ *
+ * When the new demodulator is provided by the receiver already in use, the
+ * receiver switches to it while the flow graph is running. The flow graph is
+ * only stopped and rebuilt when a VFO is turned on or off, or when switching
+ * between the narrow band and the wide band FM receivers, since these
+ * require a new receiver object.
+ */
 receiver::status receiver::set_demod(rx_demod demod)
 {
-    status ret = STATUS_OK;
+    rx_vfo &vfo = d_vfo[d_current_vfo];
+
+    if (demod < RX_DEMOD_OFF || demod > RX_DEMOD_SSB)
+        return STATUS_ERROR;
 
     // Allow reconf using same demod to provide a workaround
     // for the "jerky streaming" we may experience with rtl
     // dongles (the jerkyness disappears when we run this function)
-    //if (demod == d_demod)
-    //    return ret;
-
-    // tb->lock() seems to hang occasioanlly
-    if (d_running)
-    {
-        tb->stop();
-        tb->wait();
-    }
-
-    tb->disconnect_all();
-
-    switch (demod)
+    if (demod != vfo.demod && demod != RX_DEMOD_OFF &&
+        demod_chain(demod) == demod_chain(vfo.demod))
     {
-    case RX_DEMOD_OFF:
-        connect_all(RX_CHAIN_NONE);
-        break;
-
-    case RX_DEMOD_NONE:
-        connect_all(RX_CHAIN_NBRX);
-        rx->set_demod(nbrx::NBRX_DEMOD_NONE);
-        break;
-
-    case RX_DEMOD_AM:
-        connect_all(RX_CHAIN_NBRX);
-        rx->set_demod(nbrx::NBRX_DEMOD_AM);
-        break;
-
-    case RX_DEMOD_NFM:
-        connect_all(RX_CHAIN_NBRX);
-        rx->set_demod(nbrx::NBRX_DEMOD_FM);
-        break;
-
-    case RX_DEMOD_WFM_M:
-        connect_all(RX_CHAIN_WFMRX);
-        rx->set_demod(wfmrx::WFMRX_DEMOD_MONO);
-        break;
-
-    case RX_DEMOD_WFM_S:
-        connect_all(RX_CHAIN_WFMRX);
-        rx->set_demod(wfmrx::WFMRX_DEMOD_STEREO);
-        break;
-
-    case RX_DEMOD_SSB:
-        connect_all(RX_CHAIN_NBRX);
-        rx->set_demod(nbrx::NBRX_DEMOD_SSB);
-        break;
-
-    default:
-        ret = STATUS_ERROR;
-        break;
+        vfo.demod = demod;
+        set_vfo_demod(vfo);
+        return STATUS_OK;
     }
 
-    d_demod = demod;
+    vfo.demod = demod;
+    reconnect_all();
 
-    if (d_running)
-        tb->start();
+    return STATUS_OK;
+}
 
-    return ret;
+/*! \brief Get the latency of the last demodulator switch in the current VFO.
+ *  \returns The time in seconds from set_demod() until the new demodulator
+ *           started to produce audio, or 0 if the receiver was rebuilt or
+ *           the switch is still pending.
+ */
+double receiver::get_demod_switch_latency(void)
+{
+    return d_vfo[d_current_vfo].rx->get_demod_latency();
 }
 
 /*! \brief Set maximum deviation of the FM demodulator.
@@ -743,6 +889,8 @@ receiver::status receiver::set_demod(rx_demod demod)
  */
 receiver::status receiver::set_fm_maxdev(float maxdev_hz)
 {
+    receiver_base_cf_sptr rx = d_vfo[d_current_vfo].rx;
+
     if (rx->has_fm())
         rx->set_fm_maxdev(maxdev_hz);
 
@@ -751,6 +899,8 @@ receiver::status receiver::set_fm_maxdev(float maxdev_hz)
 
 receiver::status receiver::set_fm_deemph(double tau)
 {
+    receiver_base_cf_sptr rx = d_vfo[d_current_vfo].rx;
+
     if (rx->has_fm())
         rx->set_fm_deemph(tau);
 
@@ -759,6 +909,8 @@ receiver::status receiver::set_fm_deemph(double tau)
 
 receiver::status receiver::set_am_dcr(bool enabled)
 {
+    receiver_base_cf_sptr rx = d_vfo[d_current_vfo].rx;
+
     if (rx->has_am())
         rx->set_am_dcr(enabled);
 
@@ -772,8 +924,15 @@ receiver::status receiver::set_af_gain(float gain_db)
     /* convert dB to factor */
     k = pow(10.0, gain_db / 20.0);
     //std::cout << "G:" << gain_db << "dB / K:" << k << std::endl;
-    audio_gain0->set_k(k);
-    audio_gain1->set_k(k);
+
+    rx_vfo &vfo = d_vfo[d_current_vfo];
+
+    vfo.af_gain = k;
+    if (!vfo.muted)
+    {
+        vfo.audio_gain0->set_k(k);
+        vfo.audio_gain1->set_k(k);
+    }
 
     return STATUS_OK;
 }
@@ -782,14 +941,16 @@ receiver::status receiver::set_af_gain(float gain_db)
 /*! \brief Start WAV file recorder.
  *  \param filename The filename where to record.
  *
- * A new recorder object is created every time we start recording and deleted every time
- * we stop recording. The idea of creating one object and starting/stopping using different
- * file names does not work with WAV files (the initial /tmp/gqrx.wav will not be stopped
- * because the wav file can not be empty). See https://github.com/csete/gqrx/issues/36
+ * The WAV sink is always connected to the receiver and discards the audio
+ * while no file is open. The new file is picked up by the sink at the start
+ * of its next work() call, so the recording starts on a sample boundary
+ * without locking the flow graph.
  */
 receiver::status receiver::start_audio_recording(const std::string filename)
 {
-    if (d_recording_wav)
+    rx_vfo &vfo = d_vfo[d_current_vfo];
+
+    if (vfo.recording_wav)
     {
         /* error - we are already recording */
         std::cout << "ERROR: Can not start audio recorder (already recording)" << std::endl;
@@ -804,23 +965,17 @@ receiver::status receiver::start_audio_recording(const std::string filename)
         return STATUS_ERROR;
     }
 
-    // not strictly necessary to lock but I think it is safer
-    tb->lock();
-
     // if this fails, we don't want to go and crash now, do we
     try {
-        wav_sink->open(filename.c_str());
-        wav_sink->set_sample_rate((unsigned int) d_audio_rate);
+        vfo.wav_sink->open(filename.c_str());
+        vfo.wav_sink->set_sample_rate((unsigned int) d_audio_rate);
     }
     catch (std::runtime_error &e) {
         std::cout << "Error opening " << filename << ": " << e.what() << std::endl;
         return STATUS_ERROR;
     }
 
-    tb->connect(rx, 0, wav_sink, 0);
-    tb->connect(rx, 1, wav_sink, 1);
-    tb->unlock();
-    d_recording_wav = true;
+    vfo.recording_wav = true;
 
     std::cout << "Recording audio to " << filename << std::endl;
 
@@ -831,7 +986,9 @@ receiver::status receiver::start_audio_recording(const std::string filename)
 /*! \brief Stop WAV file recorder. */
 receiver::status receiver::stop_audio_recording()
 {
-    if (!d_recording_wav) {
+    rx_vfo &vfo = d_vfo[d_current_vfo];
+
+    if (!vfo.recording_wav) {
         /* error: we are not recording */
         std::cout << "ERROR: Can not stop audio recorder (not recording)" << std::endl;
 
@@ -845,13 +1002,8 @@ receiver::status receiver::stop_audio_recording()
         return STATUS_ERROR;
     }
 
-    // not strictly necessary to lock but I think it is safer
-    tb->lock();
-    wav_sink->close();
-    tb->disconnect(rx, 0, wav_sink, 0);
-    tb->disconnect(rx, 1, wav_sink, 1);
-    tb->unlock();
-    d_recording_wav = false;
+    vfo.wav_sink->close();
+    vfo.recording_wav = false;
 
     std::cout << "Audio recorder stopped" << std::endl;
 
@@ -898,18 +1050,28 @@ receiver::status receiver::start_audio_playback(const std::string filename)
         return STATUS_ERROR;
     }
 
+    rx_vfo &vfo = d_vfo[d_current_vfo];
+
+    if (vfo.demod == RX_DEMOD_OFF)
+    {
+        std::cout << "Can not start audio playback (VFO is off)" << std::endl;
+        wav_src.reset();
+
+        return STATUS_ERROR;
+    }
+
     stop();
-    /* route demodulator output to null sink */
-    tb->disconnect(rx, 0, audio_gain0, 0);
-    tb->disconnect(rx, 1, audio_gain1, 0);
-    tb->disconnect(rx, 0, audio_fft, 0);
-    tb->disconnect(rx, 0, audio_udp_sink, 0);
-    tb->connect(rx, 0, audio_null_sink0, 0); /** FIXME: other channel? */
-    tb->connect(rx, 1, audio_null_sink1, 0); /** FIXME: other channel? */
-    tb->connect(wav_src, 0, audio_gain0, 0);
-    tb->connect(wav_src, 1, audio_gain1, 0);
+    /* route demodulator output of the current VFO to null sink */
+    tb->disconnect(vfo.rx, 0, vfo.audio_gain0, 0);
+    tb->disconnect(vfo.rx, 1, vfo.audio_gain1, 0);
+    tb->disconnect(vfo.rx, 0, audio_fft, 0);
+    tb->disconnect(vfo.rx, 0, vfo.udp_sink, 0);
+    tb->connect(vfo.rx, 0, audio_null_sink0, 0); /** FIXME: other channel? */
+    tb->connect(vfo.rx, 1, audio_null_sink1, 0); /** FIXME: other channel? */
+    tb->connect(wav_src, 0, vfo.audio_gain0, 0);
+    tb->connect(wav_src, 1, vfo.audio_gain1, 0);
     tb->connect(wav_src, 0, audio_fft, 0);
-    tb->connect(wav_src, 0, audio_udp_sink, 0);
+    tb->connect(wav_src, 0, vfo.udp_sink, 0);
     start();
 
     std::cout << "Playing audio from " << filename << std::endl;
@@ -921,18 +1083,23 @@ receiver::status receiver::start_audio_playback(const std::string filename)
 /*! \brief Stop audio playback. */
 receiver::status receiver::stop_audio_playback()
 {
+    if (!wav_src)
+        return STATUS_ERROR;
+
+    rx_vfo &vfo = d_vfo[d_current_vfo];
+
     /* disconnect wav source and reconnect receiver */
     stop();
-    tb->disconnect(wav_src, 0, audio_gain0, 0);
-    tb->disconnect(wav_src, 1, audio_gain1, 0);
+    tb->disconnect(wav_src, 0, vfo.audio_gain0, 0);
+    tb->disconnect(wav_src, 1, vfo.audio_gain1, 0);
     tb->disconnect(wav_src, 0, audio_fft, 0);
-    tb->disconnect(wav_src, 0, audio_udp_sink, 0);
-    tb->disconnect(rx, 0, audio_null_sink0, 0);
-    tb->disconnect(rx, 1, audio_null_sink1, 0);
-    tb->connect(rx, 0, audio_gain0, 0);
-    tb->connect(rx, 1, audio_gain1, 0);
-    tb->connect(rx, 0, audio_fft, 0);  /** FIXME: other channel? */
-    tb->connect(rx, 0, audio_udp_sink, 0);
+    tb->disconnect(wav_src, 0, vfo.udp_sink, 0);
+    tb->disconnect(vfo.rx, 0, audio_null_sink0, 0);
+    tb->disconnect(vfo.rx, 1, audio_null_sink1, 0);
+    tb->connect(vfo.rx, 0, vfo.audio_gain0, 0);
+    tb->connect(vfo.rx, 1, vfo.audio_gain1, 0);
+    tb->connect(vfo.rx, 0, audio_fft, 0);  /** FIXME: other channel? */
+    tb->connect(vfo.rx, 0, vfo.udp_sink, 0);
     start();
 
     /* delete wav_src since we can not change file name */
@@ -945,20 +1112,24 @@ receiver::status receiver::stop_audio_playback()
 /*! \brief Start UDP streaming of audio. */
 receiver::status receiver::start_udp_streaming(const std::string host, int port)
 {
-    audio_udp_sink->start_streaming(host, port);
+    d_vfo[d_current_vfo].udp_sink->start_streaming(host, port);
     return STATUS_OK;
 }
 
 /*! \brief Stop UDP streaming of audio. */
 receiver::status receiver::stop_udp_streaming()
 {
-    audio_udp_sink->stop_streaming();
+    d_vfo[d_current_vfo].udp_sink->stop_streaming();
     return STATUS_OK;
 }
 
 
 /*! \brief Start I/Q data recorder.
  *  \param filename The filename where to record.
+ *
+ * The I/Q sink is always connected to the source and discards the samples
+ * while no file is open, so the recording starts on a sample boundary
+ * without locking the flow graph.
  */
 receiver::status receiver::start_iq_recording(const std::string filename)
 {
@@ -971,17 +1142,10 @@ receiver::status receiver::start_iq_recording(const std::string filename)
 
     // iq_sink was created in the constructor
     if (iq_sink) {
-        tb->lock();
         if (!iq_sink->open(filename.c_str()))
-        {
             status = STATUS_ERROR;
-        }
         else
-        {
-            tb->connect(src, 0, iq_sink, 0);
             d_recording_iq = true;
-        }
-        tb->unlock();
     }
     else {
         std::cout << __func__ << ": I/Q file sink does not exist" << std::endl;
@@ -1000,10 +1164,7 @@ receiver::status receiver::stop_iq_recording()
         return STATUS_ERROR;
     }
 
-    tb->lock();
     iq_sink->close();
-    tb->disconnect(src, 0, iq_sink, 0);
-    tb->unlock();
     d_recording_iq = false;
 
     return STATUS_OK;
@@ -1018,7 +1179,7 @@ receiver::status receiver::seek_iq_file(long pos)
 
     tb->lock();
 
-    if (src->seek(pos, SEEK_SET))
+    if (raw_src ? raw_src->seek(pos, SEEK_SET) : src->seek(pos, SEEK_SET))
     {
         status = STATUS_OK;
     }
@@ -1043,12 +1204,18 @@ receiver::status receiver::start_sniffer(unsigned int samprate, int buffsize)
         return STATUS_ERROR;
     }
 
+    if (d_vfo[d_current_vfo].demod == RX_DEMOD_OFF) {
+        /* nothing to sniff */
+        return STATUS_ERROR;
+    }
+
     sniffer->set_buffer_size(buffsize);
-    sniffer_rr = make_resampler_ff((float)samprate/(float)d_audio_rate);
-    tb->lock();
-    tb->connect(rx, 0, sniffer_rr, 0);
-    tb->connect(sniffer_rr, 0, sniffer, 0);
-    tb->unlock();
+    if (samprate != d_sniffer_rate)
+    {
+        sniffer_rr->set_rate((float)samprate/(float)d_audio_rate);
+        d_sniffer_rate = samprate;
+    }
+    sniffer->set_enabled(true);
     d_sniffer_active = true;
 
     return STATUS_OK;
@@ -1063,15 +1230,9 @@ receiver::status receiver::stop_sniffer()
         return STATUS_ERROR;
     }
 
-    tb->lock();
-    tb->disconnect(rx, 0, sniffer_rr, 0);
-    tb->disconnect(sniffer_rr, 0, sniffer, 0);
-    tb->unlock();
+    sniffer->set_enabled(false);
     d_sniffer_active = false;
 
-    /* delete resampler */
-    sniffer_rr.reset();
-
     return STATUS_OK;
 }
 
@@ -1081,99 +1242,427 @@ void receiver::get_sniffer_data(float * outbuff, unsigned int &num)
     sniffer->get_samples(outbuff, num);
 }
 
-/*! \brief Convenience function to connect all blocks. */
-void receiver::connect_all(rx_chain type)
+/*! \brief Add a new VFO.
+ *  \param offset_hz The tuning offset of the new VFO.
+ *  \param demod The demodulator used by the new VFO.
+ *  \return The index of the new VFO.
+ *
+ * The new VFO shares the I/Q stream with the existing VFOs and its audio is
+ * mixed with theirs. The current VFO is not changed, use set_current_vfo()
+ * to control the new VFO.
+ */
+int receiver::add_vfo(double offset_hz, rx_demod demod)
+{
+    d_vfo.push_back(make_vfo(offset_hz, demod));
+    reconnect_all();
+
+    return (int) d_vfo.size() - 1;
+}
+
+/*! \brief Remove a VFO.
+ *  \param vfo The index of the VFO to remove.
+ *  \return STATUS_ERROR if the index is invalid or if \p vfo is the last VFO.
+ *
+ * The indices of the VFOs following \p vfo are shifted down by one.
+ */
+receiver::status receiver::remove_vfo(int vfo)
+{
+    if (vfo < 0 || vfo >= (int) d_vfo.size() || d_vfo.size() == 1)
+        return STATUS_ERROR;
+
+    if (d_vfo[vfo].recording_wav)
+        d_vfo[vfo].wav_sink->close();
+
+    d_vfo.erase(d_vfo.begin() + vfo);
+    if (d_current_vfo > vfo || d_current_vfo >= (int) d_vfo.size())
+        d_current_vfo--;
+
+    reconnect_all();
+
+    return STATUS_OK;
+}
+
+/*! \brief Select the VFO controlled by the per-channel functions.
+ *  \param vfo The index of the VFO.
+ *  \return STATUS_ERROR if the index is invalid or audio playback is active.
+ *
+ * The audio FFT and the sniffer follow the current VFO.
+ */
+receiver::status receiver::set_current_vfo(int vfo)
+{
+    if (vfo == d_current_vfo)
+        return STATUS_OK;
+
+    if (vfo < 0 || vfo >= (int) d_vfo.size() || wav_src)
+        return STATUS_ERROR;
+
+    rx_vfo &old_vfo = d_vfo[d_current_vfo];
+    rx_vfo &new_vfo = d_vfo[vfo];
+
+    tb->lock();
+    if (old_vfo.demod != RX_DEMOD_OFF)
+    {
+        tb->disconnect(old_vfo.rx, 0, audio_fft, 0);
+        tb->disconnect(old_vfo.rx, 0, sniffer_rr, 0);
+        tb->disconnect(sniffer_rr, 0, sniffer, 0);
+    }
+    if (new_vfo.demod != RX_DEMOD_OFF)
+    {
+        tb->connect(new_vfo.rx, 0, audio_fft, 0);
+        tb->connect(new_vfo.rx, 0, sniffer_rr, 0);
+        tb->connect(sniffer_rr, 0, sniffer, 0);
+    }
+    tb->unlock();
+
+    d_current_vfo = vfo;
+
+    return STATUS_OK;
+}
+
+/*! \brief Mute or unmute the audio output of a VFO.
+ *  \param vfo The index of the VFO.
+ *  \param mute Whether the audio of this VFO should be muted.
+ *
+ * A muted VFO is removed from the audio device mix. Audio recording and
+ * UDP streaming are not affected.
+ */
+receiver::status receiver::set_vfo_mute(int vfo, bool mute)
+{
+    if (vfo < 0 || vfo >= (int) d_vfo.size())
+        return STATUS_ERROR;
+
+    rx_vfo &v = d_vfo[vfo];
+    float k = mute ? 0.0 : v.af_gain;
+
+    v.muted = mute;
+    v.audio_gain0->set_k(k);
+    v.audio_gain1->set_k(k);
+
+    return STATUS_OK;
+}
+
+/*! \brief Create the blocks belonging to a new VFO. */
+receiver::rx_vfo receiver::make_vfo(double offset_hz, rx_demod demod)
+{
+    rx_vfo vfo;
+
+    // the receiver is replaced in connect_all() if the demod requires WFMRX
+    vfo.rx = make_nbrx(d_input_rate, d_audio_rate);
+    vfo.lo = gr::analog::sig_source_c::make(d_input_rate, gr::analog::GR_SIN_WAVE,
+                                            -offset_hz, 1.0);
+    vfo.mixer = gr::blocks::multiply_cc::make();
+    vfo.audio_gain0 = gr::blocks::multiply_const_ff::make(0.1);
+    vfo.audio_gain1 = gr::blocks::multiply_const_ff::make(0.1);
+    vfo.wav_sink = gr::blocks::wavfile_sink::make("/dev/null", 2,
+                                                  (unsigned int) d_audio_rate,
+                                                  16);
+    vfo.wav_sink->close();
+    vfo.udp_sink = make_udp_sink_f();
+
+    vfo.chan = -1;
+    vfo.filter_offset = offset_hz;
+    vfo.demod = demod;
+    vfo.af_gain = 0.1;
+    vfo.muted = false;
+    vfo.recording_wav = false;
+
+    return vfo;
+}
+
+/*! \brief Get the number of VFOs with a demodulator. */
+int receiver::num_active_vfos(void) const
+{
+    int num = 0;
+
+    for (unsigned int i = 0; i < d_vfo.size(); i++)
+        if (d_vfo[i].demod != RX_DEMOD_OFF)
+            num++;
+
+    return num;
+}
+
+/*! \brief Tune a VFO to its filter offset.
+ *
+ * When the VFO is fed from the channelizer it only needs to cover the
+ * distance from the center of the channel. Receivers that can translate
+ * the frequency themselves are tuned directly, otherwise the VFO
+ * oscillator is used.
+ */
+void receiver::tune_vfo(rx_vfo &vfo)
+{
+    double offset = vfo.filter_offset;
+
+    if (vfo.chan >= 0)
+        offset -= channelizer->chan_center(vfo.chan);
+
+    if (vfo.rx->has_offset())
+        vfo.rx->set_offset(offset);
+    else
+        vfo.lo->set_frequency(-offset);
+}
+
+/*! \brief Get the receiver type needed by a demodulator. */
+receiver::rx_chain receiver::demod_chain(rx_demod demod)
 {
-    switch (type)
+    switch (demod)
+    {
+    case RX_DEMOD_NONE:
+    case RX_DEMOD_AM:
+    case RX_DEMOD_NFM:
+    case RX_DEMOD_SSB:
+        return RX_CHAIN_NBRX;
+
+    case RX_DEMOD_WFM_M:
+    case RX_DEMOD_WFM_S:
+        return RX_CHAIN_WFMRX;
+
+    case RX_DEMOD_OFF:
+    default:
+        return RX_CHAIN_NONE;
+    }
+}
+
+/*! \brief Select the demodulator of a VFO within its receiver. */
+void receiver::set_vfo_demod(rx_vfo &vfo)
+{
+    switch (vfo.demod)
     {
-    case RX_CHAIN_NONE:
-        tb->connect(src, 0, iq_swap, 0);
-        if (d_dc_cancel)
+    case RX_DEMOD_NONE:
+        vfo.rx->set_demod(nbrx::NBRX_DEMOD_NONE);
+        break;
+    case RX_DEMOD_AM:
+        vfo.rx->set_demod(nbrx::NBRX_DEMOD_AM);
+        break;
+    case RX_DEMOD_NFM:
+        vfo.rx->set_demod(nbrx::NBRX_DEMOD_FM);
+        break;
+    case RX_DEMOD_WFM_M:
+        vfo.rx->set_demod(wfmrx::WFMRX_DEMOD_MONO);
+        break;
+    case RX_DEMOD_WFM_S:
+        vfo.rx->set_demod(wfmrx::WFMRX_DEMOD_STEREO);
+        break;
+    case RX_DEMOD_SSB:
+    default:
+        vfo.rx->set_demod(nbrx::NBRX_DEMOD_SSB);
+        break;
+    }
+}
+
+/*! \brief Get the block where the I/Q input of a VFO is connected. */
+gr::basic_block_sptr receiver::vfo_input(rx_vfo &vfo)
+{
+    if (vfo.rx->has_offset())
+        return vfo.rx;
+    else
+        return vfo.mixer;
+}
+
+/*! \brief Create the input source for a device string.
+ *
+ * Device strings starting with "raw=" create a raw_source that reads the
+ * native sample format of the hardware, all others are passed to osmosdr.
+ * Only one of src and raw_src exists at a time, and the functions that
+ * control the hardware do nothing when using a raw source.
+ */
+void receiver::create_input(const std::string &device)
+{
+    src.reset();
+    raw_src.reset();
+
+    if (is_raw_source(device))
+        raw_src = make_raw_source(device);
+    else
+        src = osmosdr::source::make(device);
+}
+
+/*! \brief Get the block that provides the I/Q stream. */
+gr::basic_block_sptr receiver::input_block(void)
+{
+    if (raw_src)
+        return raw_src;
+    else
+        return src;
+}
+
+/*! \brief Stop the flow graph, reconnect all blocks and restart. */
+void receiver::reconnect_all(void)
+{
+    // tb->lock() seems to hang occasioanlly
+    if (d_running)
+    {
+        tb->stop();
+        tb->wait();
+    }
+
+    tb->disconnect_all();
+    connect_all();
+
+    if (d_running)
+        tb->start();
+}
+
+/*! \brief Connect or disconnect the audio device.
+ *
+ * With a single active VFO its audio gain blocks feed the audio device
+ * directly, otherwise the audio goes through the mixers.
+ */
+void receiver::connect_audio_sink(bool connect)
+{
+    gr::basic_block_sptr    out0, out1;
+    int                     num = num_active_vfos();
+
+    if (num == 0)
+        return;
+
+    if (num > 1)
+    {
+        out0 = audio_mix0;
+        out1 = audio_mix1;
+    }
+    else
+    {
+        for (unsigned int i = 0; i < d_vfo.size(); i++)
         {
-            tb->connect(iq_swap, 0, dc_corr, 0);
-            tb->connect(dc_corr, 0, iq_fft, 0);
+            if (d_vfo[i].demod != RX_DEMOD_OFF)
+            {
+                out0 = d_vfo[i].audio_gain0;
+                out1 = d_vfo[i].audio_gain1;
+            }
         }
-        else
+    }
+
+    if (connect)
+    {
+        tb->connect(out0, 0, audio_snk, 0);
+        tb->connect(out1, 0, audio_snk, 1);
+    }
+    else
+    {
+        tb->disconnect(out0, 0, audio_snk, 0);
+        tb->disconnect(out1, 0, audio_snk, 1);
+    }
+}
+
+/*! \brief Convenience function to connect all blocks. */
+void receiver::connect_all(void)
+{
+    gr::basic_block_sptr    iq_out;   // output of the I/Q front end
+    int                     mix_port = 0;
+    bool                    mixing = num_active_vfos() > 1;
+    unsigned int            num_chans = 0;
+    double                  chan_bw = NBRX_CHAN_BW;
+
+    // I/Q swap, DC removal and I/Q balance are done by one block that is
+    // always connected; the I/Q recorder discards samples while it is closed
+    tb->connect(input_block(), 0, iq_sink, 0);
+    tb->connect(input_block(), 0, iq_corr, 0);
+    iq_out = iq_corr;
+    tb->connect(iq_out, 0, iq_fft, 0);
+
+    // Several VFOs are fed from a channelizer so that each of them only
+    // has to process its own channel at a reduced rate.
+    if (num_active_vfos() >= RX_CHANNELIZER_MIN_VFOS)
+    {
+        for (unsigned int i = 0; i < d_vfo.size(); i++)
+            if (d_vfo[i].demod == RX_DEMOD_WFM_M || d_vfo[i].demod == RX_DEMOD_WFM_S)
+                chan_bw = WFMRX_CHAN_BW;
+
+        num_chans = rx_channelizer_cc::calc_num_chans(d_input_rate, chan_bw);
+    }
+
+    if (num_chans > 0)
+    {
+        if (!channelizer || channelizer->num_chans() != num_chans ||
+            channelizer->sample_rate() != d_input_rate)
         {
-            tb->connect(iq_swap, 0, iq_fft, 0);
+            channelizer.reset();
+            channelizer = make_rx_channelizer_cc(d_input_rate, num_chans);
         }
-        break;
+        tb->connect(iq_out, 0, channelizer, 0);
+    }
+    else
+    {
+        channelizer.reset();
+    }
 
-    case RX_CHAIN_NBRX:
-        if (rx->name() != "NBRX")
+    for (unsigned int i = 0; i < d_vfo.size(); i++)
+    {
+        rx_vfo &vfo = d_vfo[i];
+
+        vfo.chan = -1;
+
+        switch (vfo.demod)
         {
-            rx.reset();
-            rx = make_nbrx(d_input_rate, d_audio_rate);
+        case RX_DEMOD_NONE:
+        case RX_DEMOD_AM:
+        case RX_DEMOD_NFM:
+        case RX_DEMOD_SSB:
+            if (vfo.rx->name() != "NBRX")
+            {
+                vfo.rx.reset();
+                vfo.rx = make_nbrx(d_input_rate, d_audio_rate);
+            }
+            break;
+
+        case RX_DEMOD_WFM_M:
+        case RX_DEMOD_WFM_S:
+            if (vfo.rx->name() != "WFMRX")
+            {
+                vfo.rx.reset();
+                vfo.rx = make_wfmrx(d_input_rate, d_audio_rate);
+            }
+            break;
+
+        case RX_DEMOD_OFF:
+        default:
+            continue;
         }
-        tb->connect(src, 0, iq_swap, 0);
-        if (d_dc_cancel)
+
+        if (channelizer)
         {
-            tb->connect(iq_swap, 0, dc_corr, 0);
-            tb->connect(dc_corr, 0, iq_fft, 0);
-            tb->connect(dc_corr, 0, mixer, 0);
+            vfo.chan = channelizer->chan_for_offset(vfo.filter_offset);
+            vfo.lo->set_sampling_freq(channelizer->chan_rate());
+            vfo.rx->set_quad_rate(channelizer->chan_rate());
+            tb->connect(channelizer, vfo.chan, vfo_input(vfo), 0);
         }
         else
         {
-            tb->connect(iq_swap, 0, iq_fft, 0);
-            tb->connect(iq_swap, 0, mixer, 0);
+            vfo.lo->set_sampling_freq(d_input_rate);
+            vfo.rx->set_quad_rate(d_input_rate);
+            tb->connect(iq_out, 0, vfo_input(vfo), 0);
         }
-        tb->connect(lo, 0, mixer, 1);
-        tb->connect(mixer, 0, rx, 0);
-        tb->connect(rx, 0, audio_fft, 0);
-        tb->connect(rx, 0, audio_udp_sink, 0);
-        tb->connect(rx, 0, audio_gain0, 0);
-        tb->connect(rx, 1, audio_gain1, 0);
-        tb->connect(audio_gain0, 0, audio_snk, 0);
-        tb->connect(audio_gain1, 0, audio_snk, 1);
-        break;
+        tune_vfo(vfo);
 
-    case RX_CHAIN_WFMRX:
-        if (rx->name() != "WFMRX")
+        if (!vfo.rx->has_offset())
         {
-            rx.reset();
-            rx = make_wfmrx(d_input_rate, d_audio_rate);
+            tb->connect(vfo.lo, 0, vfo.mixer, 1);
+            tb->connect(vfo.mixer, 0, vfo.rx, 0);
         }
-        tb->connect(src, 0, iq_swap, 0);
-        if (d_dc_cancel)
-        {
-            tb->connect(iq_swap, 0, dc_corr, 0);
-            tb->connect(dc_corr, 0, iq_fft, 0);
-            tb->connect(dc_corr, 0, mixer, 0);
-        }
-        else
+        tb->connect(vfo.rx, 0, vfo.udp_sink, 0);
+        tb->connect(vfo.rx, 0, vfo.audio_gain0, 0);
+        tb->connect(vfo.rx, 1, vfo.audio_gain1, 0);
+
+        if (mixing)
         {
-            tb->connect(iq_swap, 0, iq_fft, 0);
-            tb->connect(iq_swap, 0, mixer, 0);
+            tb->connect(vfo.audio_gain0, 0, audio_mix0, mix_port);
+            tb->connect(vfo.audio_gain1, 0, audio_mix1, mix_port);
+            mix_port++;
         }
-        tb->connect(lo, 0, mixer, 1);
-        tb->connect(mixer, 0, rx, 0);
-        tb->connect(rx, 0, audio_fft, 0);
-        tb->connect(rx, 0, audio_udp_sink, 0);
-        tb->connect(rx, 0, audio_gain0, 0);
-        tb->connect(rx, 1, audio_gain1, 0);
-        tb->connect(audio_gain0, 0, audio_snk, 0);
-        tb->connect(audio_gain1, 0, audio_snk, 1);
-        break;
 
-    default:
-        break;
-    }
+        tb->connect(vfo.rx, 0, vfo.wav_sink, 0);
+        tb->connect(vfo.rx, 1, vfo.wav_sink, 1);
 
-    // reconnect recorders and sniffers
-    if (d_recording_iq)
-    {
-        tb->connect(src, 0, iq_sink, 0);
+        set_vfo_demod(vfo);
     }
 
-    if (d_recording_wav)
-    {
-        tb->connect(rx, 0, wav_sink, 0);
-        tb->connect(rx, 1, wav_sink, 1);
-    }
+    connect_audio_sink(true);
 
-    if (d_sniffer_active)
+    // audio FFT and sniffer follow the current VFO
+    if (d_vfo[d_current_vfo].demod != RX_DEMOD_OFF)
     {
-        tb->connect(rx, 0, sniffer_rr, 0);
+        tb->connect(d_vfo[d_current_vfo].rx, 0, audio_fft, 0);
+        tb->connect(d_vfo[d_current_vfo].rx, 0, sniffer_rr, 0);
         tb->connect(sniffer_rr, 0, sniffer, 0);
     }
 }
@@ -24,7 +24,9 @@
 #define RECEIVER_H
 
 #include <string>
+#include <vector>
 
+#include <gnuradio/blocks/add_ff.h>
 #include <gnuradio/blocks/file_sink.h>
 #include <gnuradio/blocks/multiply_const_ff.h>
 #include <gnuradio/blocks/multiply_cc.h>
@@ -37,6 +39,7 @@
 #include <osmosdr/source.h>
 
 #include "dsp/correct_iq_cc.h"
+#include "dsp/rx_channelizer.h"
 #include "dsp/rx_noise_blanker_cc.h"
 #include "dsp/rx_filter.h"
 #include "dsp/rx_meter.h"
@@ -46,6 +49,7 @@
 #include "dsp/rx_fft.h"
 #include "dsp/sniffer_f.h"
 #include "dsp/resampler_xx.h"
+#include "interfaces/raw_source.h"
 #include "interfaces/udp_sink_f.h"
 #include "receivers/receiver_base.h"
 
@@ -66,6 +70,16 @@
  * Front-ends should only control the receiver through the interface provided
  * by this class.
  *
+ * The receiver can run several VFOs off the same I/Q stream. Each VFO has its
+ * own tuning offset, filter, demodulator, squelch and audio sinks while the
+ * input device, the I/Q correction blocks and the baseband FFT are shared.
+ * The audio of all VFOs is mixed to the audio device. All the per-channel
+ * functions act on the current VFO, see set_current_vfo().
+ *
+ * When several VFOs are active and the input rate is high enough, the VFOs
+ * are fed from a polyphase channelizer instead of tuning the full rate
+ * stream. Each VFO then only tunes the residual offset within its channel
+ * at the channel rate.
  */
 class receiver
 {
@@ -154,8 +168,17 @@ public:
     float get_signal_pwr(bool dbfs);
 
     void set_iq_fft_size(int newsize);
-    void get_iq_fft_data(std::complex<float>* fftPoints, unsigned int &fftsize);
-    void get_audio_fft_data(std::complex<float>* fftPoints, unsigned int &fftsize);
+    unsigned int get_iq_fft_size(void);
+    unsigned int get_audio_fft_size(void);
+    void set_iq_fft_avg(int mode, float gain, unsigned int frames);
+    void reset_iq_fft_avg(void);
+    void set_iq_fft_overlap(int overlap);
+    unsigned long get_iq_fft_dropped(void);
+    double set_iq_fft_zoom(double center, double span);
+    void get_iq_fft_data(float *fftPoints, float *rawPoints, unsigned int &fftsize);
+    void set_iq_fft_lines(float rate, int mode);
+    void get_iq_fft_line(float *linePoints, unsigned int &size);
+    void get_audio_fft_data(float *fftPoints, unsigned int &fftsize);
 
     /* Noise blanker */
     status set_nb_on(int nbid, bool on);
@@ -174,6 +197,8 @@ public:
     status set_agc_manual_gain(int gain);
 
     status set_demod(rx_demod demod);
+    rx_demod get_demod(void) const { return d_vfo[d_current_vfo].demod; }
+    double get_demod_switch_latency(void);
 
     /* FM parameters */
     status set_fm_maxdev(float maxdev_hz);
@@ -202,21 +227,58 @@ public:
     status stop_sniffer();
     void   get_sniffer_data(float * outbuff, unsigned int &num);
 
-    bool is_recording_audio(void) const { return d_recording_wav; }
+    bool is_recording_audio(void) const { return d_vfo[d_current_vfo].recording_wav; }
     bool is_snifffer_active(void) const { return d_sniffer_active; }
 
+    /* Multiple VFOs */
+    int    add_vfo(double offset_hz, rx_demod demod);
+    status remove_vfo(int vfo);
+    status set_current_vfo(int vfo);
+    int    get_current_vfo(void) const { return d_current_vfo; }
+    int    get_vfo_count(void) const { return (int) d_vfo.size(); }
+    status set_vfo_mute(int vfo, bool mute);
+    bool   get_vfo_mute(int vfo) const { return d_vfo[vfo].muted; }
+
 private:
-    void connect_all(rx_chain type);
+    /*! \brief Blocks and settings belonging to one VFO. */
+    struct rx_vfo
+    {
+        receiver_base_cf_sptr               rx;          /*!< receiver. */
+        gr::analog::sig_source_c::sptr      lo;          /*!< oscillator used for tuning if rx can not. */
+        gr::blocks::multiply_cc::sptr       mixer;
+        gr::blocks::multiply_const_ff::sptr audio_gain0; /*!< Audio gain block. */
+        gr::blocks::multiply_const_ff::sptr audio_gain1; /*!< Audio gain block. */
+        gr::blocks::wavfile_sink::sptr      wav_sink;    /*!< WAV file sink for recording. */
+        udp_sink_f_sptr                     udp_sink;    /*!< UDP sink to stream audio over the network. */
+
+        int       chan;            /*!< Channelizer output used by this VFO or -1. */
+        double    filter_offset;   /*!< Current filter offset (tune within passband). */
+        rx_demod  demod;           /*!< Current demodulator. */
+        float     af_gain;         /*!< Audio gain factor. */
+        bool      muted;           /*!< Audio is not sent to the audio device. */
+        bool      recording_wav;   /*!< Whether we are recording WAV file. */
+    };
+
+    rx_vfo make_vfo(double offset_hz, rx_demod demod);
+    void   reconnect_all(void);
+    void   connect_all(void);
+    void   connect_audio_sink(bool connect);
+    void   tune_vfo(rx_vfo &vfo);
+    gr::basic_block_sptr vfo_input(rx_vfo &vfo);
+    void   create_input(const std::string &device);
+    gr::basic_block_sptr input_block(void);
+    void   set_vfo_demod(rx_vfo &vfo);
+    static rx_chain demod_chain(rx_demod demod);
+    int    num_active_vfos(void) const;
 
 private:
     bool   d_running;          /*!< Whether receiver is running or not. */
     double d_input_rate;       /*!< Input sample rate. */
     double d_audio_rate;       /*!< Audio output rate. */
     double d_rf_freq;          /*!< Current RF frequency. */
-    double d_filter_offset;    /*!< Current filter offset (tune within passband). */
     bool   d_recording_iq;     /*!< Whether we are recording I/Q file. */
-    bool   d_recording_wav;    /*!< Whether we are recording WAV file. */
     bool   d_sniffer_active;   /*!< Only one data decoder allowed. */
+    unsigned int d_sniffer_rate; /*!< Output rate of the sniffer resampler. */
     bool   d_iq_rev;           /*!< Whether I/Q is reversed or not. */
     bool   d_dc_cancel;        /*!< Enable automatic DC removal. */
     bool   d_iq_balance;       /*!< Enable automatic IQ balance. */
@@ -224,33 +286,29 @@ private:
     std::string input_devstr;  /*!< Current input device string. */
     std::string output_devstr; /*!< Current output device string. */
 
-    rx_demod  d_demod;          /*!< Current demodulator. */
+    std::vector<rx_vfo>  d_vfo;         /*!< The VFOs sharing the I/Q stream. */
+    int                  d_current_vfo; /*!< The VFO controlled by the per-channel API. */
 
     gr::top_block_sptr         tb;        /*!< The GNU Radio top block. */
 
     osmosdr::source::sptr     src;       /*!< Real time I/Q source. */
-    receiver_base_cf_sptr     rx;        /*!< receiver. */
+    raw_source_sptr           raw_src;   /*!< Raw sample source, used instead of src. */
 
-    dc_corr_cc_sptr           dc_corr;   /*!< DC corrector block. */
-    iq_swap_cc_sptr           iq_swap;   /*!< I/Q swapping block. */
+    iq_corr_cc_sptr           iq_corr;   /*!< I/Q swap, DC and balance correction. */
+    rx_channelizer_cc_sptr    channelizer; /*!< Channelizer used with several VFOs. */
 
     rx_fft_c_sptr             iq_fft;     /*!< Baseband FFT block. */
     rx_fft_f_sptr             audio_fft;  /*!< Audio FFT block. */
 
-    gr::analog::sig_source_c::sptr      lo;  /*!< oscillator used for tuning. */
-    gr::blocks::multiply_cc::sptr       mixer;
-
-    gr::blocks::multiply_const_ff::sptr audio_gain0; /*!< Audio gain block. */
-    gr::blocks::multiply_const_ff::sptr audio_gain1; /*!< Audio gain block. */
+    gr::blocks::add_ff::sptr            audio_mix0;  /*!< Audio mixer used with several VFOs. */
+    gr::blocks::add_ff::sptr            audio_mix1;  /*!< Audio mixer used with several VFOs. */
 
     gr::blocks::file_sink::sptr         iq_sink;     /*!< I/Q file sink. */
 
-    gr::blocks::wavfile_sink::sptr      wav_sink;   /*!< WAV file sink for recording. */
     gr::blocks::wavfile_source::sptr    wav_src;    /*!< WAV file source for playback. */
     gr::blocks::null_sink::sptr         audio_null_sink0; /*!< Audio null sink used during playback. */
     gr::blocks::null_sink::sptr         audio_null_sink1; /*!< Audio null sink used during playback. */
 
-    udp_sink_f_sptr   audio_udp_sink;  /*!< UDP sink to stream audio over the network. */
     sniffer_f_sptr    sniffer;    /*!< Sample sniffer for data decoders. */
     resampler_ff_sptr sniffer_rr; /*!< Sniffer resampler. */
 
@@ -0,0 +1,62 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           http://gqrx.dk/
+ *
+ * Copyright 2011-2014 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+#include <gnuradio/gr_complex.h>
+#include <gnuradio/top_block.h>
+
+/*! \brief CPU time used by all threads of the process in seconds. */
+static inline double bench_cpu_time(void)
+{
+    return (double) std::clock() / CLOCKS_PER_SEC;
+}
+
+/*! \brief Run a flow graph to completion.
+ *  \return The CPU time used by all blocks in seconds.
+ */
+static inline double bench_run(gr::top_block_sptr tb)
+{
+    double t0 = bench_cpu_time();
+
+    tb->run();
+
+    return bench_cpu_time() - t0;
+}
+
+/*! \brief Uniform complex noise between -0.5 and 0.5 used as test input. */
+static inline std::vector<gr_complex> bench_noise_c(unsigned int num)
+{
+    std::vector<gr_complex> buf(num);
+
+    srand48(1);
+    for (unsigned int i = 0; i < num; i++)
+        buf[i] = gr_complex(drand48() - 0.5, drand48() - 0.5);
+
+    return buf;
+}
+
+#endif // BENCH_H
@@ -0,0 +1,29 @@
+#--------------------------------------------------------------------------------
+#
+# Common qmake settings for the gqrx DSP benchmarks
+#
+#--------------------------------------------------------------------------------
+
+TEMPLATE = app
+CONFIG  += console link_pkgconfig
+CONFIG  -= qt app_bundle
+
+# benchmark the release build without debug output
+DEFINES += QT_NO_DEBUG QT_NO_DEBUG_OUTPUT
+
+INCLUDEPATH += $$PWD/..
+HEADERS     += $$PWD/bench.h
+
+PKGCONFIG += gnuradio-analog \
+             gnuradio-blocks \
+             gnuradio-filter \
+             gnuradio-fft \
+             volk
+
+unix:!macx {
+    LIBS += -lboost_system$$BOOST_SUFFIX -lboost_thread$$BOOST_SUFFIX
+}
+
+macx {
+    LIBS += -lboost_system-mt -lboost_thread-mt
+}
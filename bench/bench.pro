@@ -0,0 +1,24 @@
+#--------------------------------------------------------------------------------
+#
+# Qmake project file for the gqrx DSP benchmarks
+#
+# The benchmarks are not part of the gqrx build. To build and run them:
+#
+#    mkdir build-bench && cd build-bench
+#    qmake ../bench/bench.pro && make
+#    ./bench_channelizer 2e6 8
+#
+# Run without arguments to get the usage of each benchmark.
+#--------------------------------------------------------------------------------
+
+TEMPLATE = subdirs
+
+SUBDIRS += bench_agc \
+           bench_channelizer \
+           bench_demod_fm \
+           bench_hb_decim
+
+bench_agc.file         = bench_agc.pro
+bench_channelizer.file = bench_channelizer.pro
+bench_demod_fm.file    = bench_demod_fm.pro
+bench_hb_decim.file    = bench_hb_decim.pro
@@ -0,0 +1,104 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           http://gqrx.dk/
+ *
+ * Copyright 2011-2014 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Measure the CPU time of rx_agc_cc for the decay and hang settings
+ * offered by the GUI. The input is 48 kHz noise in 100 ms bursts that
+ * alternate between strong and weak, so the AGC keeps attacking and
+ * decaying.
+ *
+ * The interface of rx_agc_cc has not changed with the float AGC, so
+ * building this file on an older revision gives the numbers to compare
+ * with.
+ *
+ * Usage: bench_agc [seconds]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <gnuradio/blocks/head.h>
+#include <gnuradio/blocks/null_sink.h>
+#include <gnuradio/blocks/vector_source_c.h>
+#include "bench/bench.h"
+#include "dsp/rx_agc_xx.h"
+
+#define AGC_RATE  48000
+#define AGC_BURST 4800
+
+
+/*! \brief Run rx_agc_cc on the test signal.
+ *  \return The CPU time per second of audio in ms.
+ */
+static double run_agc(const std::vector<gr_complex> &signal, double secs,
+                      int decay, bool hang)
+{
+    gr::top_block_sptr tb = gr::make_top_block("agc");
+    gr::blocks::vector_source_c::sptr src = gr::blocks::vector_source_c::make(signal, true);
+    gr::blocks::head::sptr head = gr::blocks::head::make(sizeof(gr_complex),
+                                                         (unsigned long)(AGC_RATE * secs));
+    rx_agc_cc_sptr agc = make_rx_agc_cc(AGC_RATE, true, -100, 0, 2, decay, hang);
+    gr::blocks::null_sink::sptr sink = gr::blocks::null_sink::make(sizeof(gr_complex));
+
+    tb->connect(src, 0, head, 0);
+    tb->connect(head, 0, agc, 0);
+    tb->connect(agc, 0, sink, 0);
+
+    return 1.0e3 * bench_run(tb) / secs;
+}
+
+/*! \brief Run the flow graph without the AGC to get the overhead. */
+static double run_empty(const std::vector<gr_complex> &signal, double secs)
+{
+    gr::top_block_sptr tb = gr::make_top_block("empty");
+    gr::blocks::vector_source_c::sptr src = gr::blocks::vector_source_c::make(signal, true);
+    gr::blocks::head::sptr head = gr::blocks::head::make(sizeof(gr_complex),
+                                                         (unsigned long)(AGC_RATE * secs));
+    gr::blocks::null_sink::sptr sink = gr::blocks::null_sink::make(sizeof(gr_complex));
+
+    tb->connect(src, 0, head, 0);
+    tb->connect(head, 0, sink, 0);
+
+    return 1.0e3 * bench_run(tb) / secs;
+}
+
+int main(int argc, char **argv)
+{
+    static const int  decay[] = { 100, 500, 2000, 500 };
+    static const bool hang[]  = { false, false, false, true };
+    double secs = argc > 1 ? atof(argv[1]) : 60.0;
+    double t_empty;
+    unsigned int i;
+
+    std::vector<gr_complex> signal = bench_noise_c(AGC_RATE);
+    for (i = 0; i < signal.size(); i++)
+        if ((i / AGC_BURST) % 2)
+            signal[i] *= 1.0e-3;
+
+    t_empty = run_empty(signal, secs);
+    printf("flow graph overhead %.2f ms/s, not subtracted\n", t_empty);
+
+    for (i = 0; i < sizeof(decay) / sizeof(decay[0]); i++)
+        printf("decay %4d ms  hang %-3s  %6.2f ms/s\n", decay[i],
+               hang[i] ? "on" : "off", run_agc(signal, secs, decay[i], hang[i]));
+
+    return 0;
+}
@@ -0,0 +1,12 @@
+include(bench.pri)
+
+TARGET = bench_agc
+
+SOURCES += \
+    bench_agc.cpp \
+    ../dsp/agc_impl.cpp \
+    ../dsp/rx_agc_xx.cpp
+
+HEADERS += \
+    ../dsp/agc_impl.h \
+    ../dsp/rx_agc_xx.h
@@ -0,0 +1,148 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           http://gqrx.dk/
+ *
+ * Copyright 2011-2014 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Compare the two ways the receiver can feed several VFOs:
+ *
+ *   mixer:       every VFO has its own oscillator, mixer and resampler
+ *                running at the input rate.
+ *   channelizer: rx_channelizer_cc splits the input and every VFO mixes
+ *                and resamples one channel at the channel rate.
+ *
+ * Both paths resample to 96 kHz using NBRX channels, like the receiver
+ * does. The result is the CPU time per second of input, summed over all
+ * threads, and is used to choose RX_CHANNELIZER_MIN_VFOS.
+ *
+ * Usage: bench_channelizer <input rate> <VFOs> [seconds]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <gnuradio/top_block.h>
+#include <gnuradio/analog/sig_source_c.h>
+#include <gnuradio/blocks/head.h>
+#include <gnuradio/blocks/multiply_cc.h>
+#include <gnuradio/blocks/null_sink.h>
+#include <gnuradio/blocks/vector_source_c.h>
+#include "bench/bench.h"
+#include "dsp/resampler_xx.h"
+#include "dsp/rx_channelizer.h"
+
+#define VFO_RATE     96.0e3
+#define NBRX_CHAN_BW 48.0e3
+
+
+/*! \brief Connect one VFO: oscillator, mixer and resampler.
+ *  \param tb The top block.
+ *  \param src The block feeding the VFO.
+ *  \param port The output port of \p src.
+ *  \param rate The sample rate of \p src.
+ *  \param offset The frequency the VFO has to tune.
+ */
+static void connect_vfo(gr::top_block_sptr tb, gr::basic_block_sptr src,
+                        int port, double rate, double offset)
+{
+    gr::analog::sig_source_c::sptr lo;
+    gr::blocks::multiply_cc::sptr  mixer;
+    resampler_cc_sptr              resampler;
+    gr::blocks::null_sink::sptr    sink;
+
+    lo = gr::analog::sig_source_c::make(rate, gr::analog::GR_SIN_WAVE,
+                                        -offset, 1.0);
+    mixer = gr::blocks::multiply_cc::make();
+    resampler = make_resampler_cc(VFO_RATE / rate);
+    sink = gr::blocks::null_sink::make(sizeof(gr_complex));
+
+    tb->connect(src, port, mixer, 0);
+    tb->connect(lo, 0, mixer, 1);
+    tb->connect(mixer, 0, resampler, 0);
+    tb->connect(resampler, 0, sink, 0);
+}
+
+int main(int argc, char **argv)
+{
+    double       rate, secs, t_mix, t_chan;
+    int          num_vfos, i;
+    unsigned int num_chans;
+
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <input rate> <VFOs> [seconds]\n", argv[0]);
+        return 1;
+    }
+
+    rate = atof(argv[1]);
+    num_vfos = atoi(argv[2]);
+    secs = argc > 3 ? atof(argv[3]) : 2.0;
+
+    num_chans = rx_channelizer_cc::calc_num_chans(rate, NBRX_CHAN_BW);
+    if (num_vfos < 1 || num_chans == 0)
+    {
+        fprintf(stderr, "Need at least one VFO and %d channels\n",
+                RX_CHANNELIZER_MIN_CHANS);
+        return 1;
+    }
+
+    std::vector<gr_complex> noise = bench_noise_c(65536);
+    unsigned long num = (unsigned long)(rate * secs);
+
+    /* mixer path */
+    {
+        gr::top_block_sptr tb = gr::make_top_block("mixer");
+        gr::blocks::vector_source_c::sptr src = gr::blocks::vector_source_c::make(noise, true);
+        gr::blocks::head::sptr head = gr::blocks::head::make(sizeof(gr_complex), num);
+
+        tb->connect(src, 0, head, 0);
+        for (i = 0; i < num_vfos; i++)
+            connect_vfo(tb, head, 0, rate, 0.4 * rate * i / num_vfos - 0.2 * rate);
+
+        t_mix = bench_run(tb);
+    }
+
+    /* channelizer path */
+    {
+        gr::top_block_sptr tb = gr::make_top_block("channelizer");
+        gr::blocks::vector_source_c::sptr src = gr::blocks::vector_source_c::make(noise, true);
+        gr::blocks::head::sptr head = gr::blocks::head::make(sizeof(gr_complex), num);
+        rx_channelizer_cc_sptr chan = make_rx_channelizer_cc(rate, num_chans);
+        double offset;
+        int    ch;
+
+        tb->connect(src, 0, head, 0);
+        tb->connect(head, 0, chan, 0);
+        for (i = 0; i < num_vfos; i++)
+        {
+            offset = 0.4 * rate * i / num_vfos - 0.2 * rate;
+            ch = chan->chan_for_offset(offset);
+            connect_vfo(tb, chan, ch, chan->chan_rate(), offset - chan->chan_center(ch));
+        }
+
+        t_chan = bench_run(tb);
+    }
+
+    printf("%6.2f Msps %3d VFOs %4u chans   mixer %8.1f ms/s   "
+           "channelizer %8.1f ms/s   speedup %.2f\n",
+           rate / 1.0e6, num_vfos, num_chans,
+           1.0e3 * t_mix / secs, 1.0e3 * t_chan / secs, t_mix / t_chan);
+
+    return 0;
+}
@@ -0,0 +1,12 @@
+include(bench.pri)
+
+TARGET = bench_channelizer
+
+SOURCES += \
+    bench_channelizer.cpp \
+    ../dsp/resampler_xx.cpp \
+    ../dsp/rx_channelizer.cpp
+
+HEADERS += \
+    ../dsp/resampler_xx.h \
+    ../dsp/rx_channelizer.h
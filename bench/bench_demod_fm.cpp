@@ -0,0 +1,136 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           http://gqrx.dk/
+ *
+ * Copyright 2011-2014 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Compare the FM demodulator of the WFM receiver, 240 ksps in and
+ * 120 ksps out, with the chain it replaced:
+ *
+ *   old: quadrature_demod_cf, iir_filter_ffd de-emphasis and a 0.5
+ *        resampler_ff, set up like wfmrx used them.
+ *   new: rx_demod_fm decimating by 2 itself.
+ *
+ * The input is a 75 kHz deviation FM signal carrying a 1 kHz tone, a
+ * 19 kHz pilot and a 38 kHz tone. The result is the CPU time per second
+ * of signal.
+ *
+ * Usage: bench_demod_fm [seconds]
+ */
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <gnuradio/analog/quadrature_demod_cf.h>
+#include <gnuradio/blocks/head.h>
+#include <gnuradio/blocks/null_sink.h>
+#include <gnuradio/blocks/vector_source_c.h>
+#include <gnuradio/filter/iir_filter_ffd.h>
+#include "bench/bench.h"
+#include "dsp/resampler_xx.h"
+#include "dsp/rx_demod_fm.h"
+
+#define QUAD_RATE  240000.0
+#define MIDLE_RATE 120000.0
+#define MAX_DEV    75000.0
+#define TAU        50.0e-6
+
+
+/*! \brief One second of the WFM test signal.
+ *
+ * All tones have a whole number of periods, so the signal can be repeated
+ * without a phase jump.
+ */
+static std::vector<gr_complex> wfm_signal(void)
+{
+    std::vector<gr_complex> buf((unsigned int) QUAD_RATE);
+    double phase = 0.0;
+    double t, f;
+
+    for (unsigned int i = 0; i < buf.size(); i++)
+    {
+        t = i / QUAD_RATE;
+        f = 0.45 * sin(2.0 * M_PI * 1000.0 * t) +
+            0.10 * sin(2.0 * M_PI * 19000.0 * t) +
+            0.45 * sin(2.0 * M_PI * 38000.0 * t);
+        phase += 2.0 * M_PI * MAX_DEV * f / QUAD_RATE;
+        buf[i] = gr_complex(cos(phase), sin(phase));
+    }
+
+    return buf;
+}
+
+/*! \brief Connect source, demodulator chain and sink and run them.
+ *  \return The CPU time per second of signal in ms.
+ */
+static double run_chain(gr::top_block_sptr tb, gr::basic_block_sptr first,
+                        gr::basic_block_sptr last, double secs)
+{
+    gr::blocks::vector_source_c::sptr src = gr::blocks::vector_source_c::make(wfm_signal(), true);
+    gr::blocks::head::sptr head = gr::blocks::head::make(sizeof(gr_complex),
+                                                         (unsigned long)(QUAD_RATE * secs));
+    gr::blocks::null_sink::sptr sink = gr::blocks::null_sink::make(sizeof(float));
+
+    tb->connect(src, 0, head, 0);
+    tb->connect(head, 0, first, 0);
+    tb->connect(last, 0, sink, 0);
+
+    return 1.0e3 * bench_run(tb) / secs;
+}
+
+int main(int argc, char **argv)
+{
+    double secs = argc > 1 ? atof(argv[1]) : 20.0;
+    double t_old, t_new;
+
+    /* old chain, de-emphasis taps from fm_emph.py */
+    {
+        gr::top_block_sptr tb = gr::make_top_block("old");
+        std::vector<double> fftaps(2), fbtaps(2);
+        double w_pp = tan(1.0 / TAU / (QUAD_RATE * 2.0));
+
+        fftaps[0] = w_pp / (1.0 + w_pp);
+        fftaps[1] = fftaps[0];
+        fbtaps[0] = 1.0;
+        fbtaps[1] = (w_pp - 1.0) / (w_pp + 1.0);
+
+        gr::analog::quadrature_demod_cf::sptr quad =
+                gr::analog::quadrature_demod_cf::make(QUAD_RATE / (2.0 * M_PI * MAX_DEV));
+        gr::filter::iir_filter_ffd::sptr deemph = gr::filter::iir_filter_ffd::make(fftaps, fbtaps);
+        resampler_ff_sptr rr = make_resampler_ff(MIDLE_RATE / QUAD_RATE);
+
+        tb->connect(quad, 0, deemph, 0);
+        tb->connect(deemph, 0, rr, 0);
+        t_old = run_chain(tb, quad, rr, secs);
+    }
+
+    /* new block */
+    {
+        gr::top_block_sptr tb = gr::make_top_block("new");
+        rx_demod_fm_sptr demod = make_rx_demod_fm(QUAD_RATE, MIDLE_RATE, MAX_DEV, TAU);
+
+        t_new = run_chain(tb, demod, demod, secs);
+    }
+
+    printf("240k -> 120k   old chain %6.2f ms/s   rx_demod_fm %6.2f ms/s\n",
+           t_old, t_new);
+
+    return 0;
+}
@@ -0,0 +1,14 @@
+include(bench.pri)
+
+TARGET = bench_demod_fm
+
+SOURCES += \
+    bench_demod_fm.cpp \
+    ../dsp/resampler_xx.cpp \
+    ../dsp/rx_demod_fm.cpp \
+    ../dsp/rx_hb_decim.cpp
+
+HEADERS += \
+    ../dsp/resampler_xx.h \
+    ../dsp/rx_demod_fm.h \
+    ../dsp/rx_hb_decim.h
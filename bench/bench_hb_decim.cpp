@@ -0,0 +1,106 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           http://gqrx.dk/
+ *
+ * Copyright 2011-2014 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Compare the two input stages of the narrow band receiver:
+ *
+ *   xlating FIR: rx_xlating_filter decimating by the largest integer
+ *                factor that keeps the rate at or above 48 kHz, set up
+ *                like nbrx did before the halfband cascade.
+ *   cascade:     rx_hb_decim_cc as used by nbrx now.
+ *
+ * Both only have to keep aliases out of +/-19.2 kHz. The fractional
+ * resampler that follows either of them is not included. The result is
+ * the CPU time per second of input.
+ *
+ * Usage: bench_hb_decim <input rate> [seconds]
+ */
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <gnuradio/blocks/head.h>
+#include <gnuradio/blocks/null_sink.h>
+#include <gnuradio/blocks/vector_source_c.h>
+#include "bench/bench.h"
+#include "dsp/rx_filter.h"
+#include "dsp/rx_hb_decim.h"
+
+#define OUT_RATE 48000.0
+
+
+/*! \brief Run a decimator on noise.
+ *  \return The CPU time per second of input in ms.
+ */
+static double run_decim(gr::basic_block_sptr decim, double rate, double secs)
+{
+    gr::top_block_sptr tb = gr::make_top_block("decim");
+    gr::blocks::vector_source_c::sptr src = gr::blocks::vector_source_c::make(bench_noise_c(65536), true);
+    gr::blocks::head::sptr head = gr::blocks::head::make(sizeof(gr_complex),
+                                                         (unsigned long)(rate * secs));
+    gr::blocks::null_sink::sptr sink = gr::blocks::null_sink::make(sizeof(gr_complex));
+
+    tb->connect(src, 0, head, 0);
+    tb->connect(head, 0, decim, 0);
+    tb->connect(decim, 0, sink, 0);
+
+    return 1.0e3 * bench_run(tb) / secs;
+}
+
+int main(int argc, char **argv)
+{
+    double       rate, secs, offset, out_rate, cutoff;
+    unsigned int decim, stages;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <input rate> [seconds]\n", argv[0]);
+        return 1;
+    }
+
+    rate = atof(argv[1]);
+    secs = argc > 2 ? atof(argv[2]) : 10.0;
+    offset = 0.3 * rate;
+
+    decim = (unsigned int) floor(rate / OUT_RATE);
+    stages = rx_hb_decim_cc::calc_stages(rate, OUT_RATE);
+    if (decim < 2 || stages < 1)
+    {
+        fprintf(stderr, "Input rate must be at least %.0f\n", 2.0 * OUT_RATE);
+        return 1;
+    }
+
+    out_rate = rate / decim;
+    cutoff = 0.5 * out_rate;
+
+    printf("%6.2f Msps  xlating FIR (decimation %u) %7.1f ms/s   "
+           "cascade (%u stages) %7.1f ms/s\n",
+           rate / 1.0e6, decim,
+           run_decim(make_rx_xlating_filter(rate, offset, -cutoff, cutoff,
+                                            out_rate - 0.8 * OUT_RATE, decim),
+                     rate, secs),
+           stages,
+           run_decim(make_rx_hb_decim_cc(rate, stages, 0.4 * OUT_RATE, offset),
+                     rate, secs));
+
+    return 0;
+}
@@ -0,0 +1,14 @@
+include(bench.pri)
+
+TARGET = bench_hb_decim
+
+SOURCES += \
+    bench_hb_decim.cpp \
+    ../dsp/filter_crossover.cpp \
+    ../dsp/rx_filter.cpp \
+    ../dsp/rx_hb_decim.cpp
+
+HEADERS += \
+    ../dsp/filter_crossover.h \
+    ../dsp/rx_filter.h \
+    ../dsp/rx_hb_decim.h
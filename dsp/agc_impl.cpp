@@ -39,6 +39,7 @@
 
 #include <dsp/agc_impl.h>
 #include <math.h>
+#include <stdint.h>
 
 //////////////////////////////////////////////////////////////////////
 // Local Defines
@@ -73,6 +74,36 @@
 //corresponding to -160dB.
 //K = 10^( -8 + log(32767) )
 
+#define LOG10_2 0.30102999566f
+#define LOG2_10 3.32192809489f
+
+//////////////////////////////////////////////////////////////////////
+// Fast log2() and pow(2,x) approximations
+//
+// Max error is about 1e-4 for the log and 5e-5 relative for the pow,
+// i.e. well below 0.01 dB. They are branch free so the loops using them
+// can be vectorized by the compiler.
+//////////////////////////////////////////////////////////////////////
+static inline float fast_log2(float x)
+{
+    union { float f; uint32_t i; } vx = { x };
+    union { uint32_t i; float f; } mx = { (vx.i & 0x007FFFFF) | 0x3f000000 };
+    float y = vx.i * 1.1920928955078125e-7f;
+
+    return y - 124.22551499f - 1.498030302f * mx.f - 1.72587999f / (0.3520887068f + mx.f);
+}
+
+static inline float fast_pow2(float p)
+{
+    float offset = (p < 0) ? 1.0f : 0.0f;
+    float clipp = (p < -126) ? -126.0f : p;
+    int w = (int) clipp;
+    float z = clipp - w + offset;
+    union { uint32_t i; float f; } v = { (uint32_t) ((1 << 23) * (clipp + 121.2740575f + 27.7280233f / (4.84252568f - z) - 1.49012907f * z)) };
+
+    return v.f;
+}
+
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
@@ -86,6 +117,13 @@ CAgc::CAgc()
     m_SlopeFactor = 0;
     m_Decay = 0;
     m_SampleRate = 100.0;
+    m_SigDelayPtr = 0;
+    m_HangTimer = 0;
+    m_DecayAve = -5.0;
+    m_AttackAve = -5.0;
+    m_SampleCnt = 0;
+    m_PeakHead = 0;
+    m_PeakCount = 0;
 }
 
 CAgc::~CAgc()
@@ -122,17 +160,14 @@ void CAgc::SetParameters(bool AgcOn,  bool UseHang, int Threshold, int ManualGai
     {	//clear out delay buffer and init some things if sample rate changes
         m_SampleRate = SampleRate;
         for (int i=0; i<MAX_DELAY_BUF; i++)
-        {
-            m_SigDelayBuf[i].re = 0.0;
-            m_SigDelayBuf[i].im = 0.0;
-            m_MagBuf[i] = -16.0;
-        }
+            m_SigDelayBuf[i] = 0.0f;
         m_SigDelayPtr = 0;
         m_HangTimer = 0;
-        m_Peak = -16.0;
         m_DecayAve = -5.0;
         m_AttackAve = -5.0;
-        m_MagBufPos = 0;
+        m_SampleCnt = 0;
+        m_PeakHead = 0;
+        m_PeakCount = 0;
     }
 
     //convert m_ThreshGain to linear manual gain value
@@ -142,6 +177,7 @@ void CAgc::SetParameters(bool AgcOn,  bool UseHang, int Threshold, int ManualGai
     //calculate parameters for AGC gain as a function of input magnitude
     m_Knee = (double)m_Threshold/20.0;
     m_GainSlope = m_SlopeFactor/(100.0);
+    m_GainExp = (m_GainSlope - 1.0f) * LOG2_10;
     m_FixedGain = AGC_OUTSCALE * pow(10.0, m_Knee*(m_GainSlope - 1.0) );	//fixed gain value used below knee threshold
     //qDebug()<<"m_Knee = "<<m_Knee<<" m_GainSlope = "<<m_GainSlope<< "m_FixedGain = "<<m_FixedGain;
 
@@ -160,138 +196,154 @@ void CAgc::SetParameters(bool AgcOn,  bool UseHang, int Threshold, int ManualGai
     m_DelaySamples = (int)(m_SampleRate*DELAY_TIMECONST);
     m_WindowSamples = (int)(m_SampleRate*WINDOW_TIMECONST);
 
-    //clamp Delay samples within buffer limit
+    //clamp Delay and Window samples within buffer limit
     if(m_DelaySamples >= MAX_DELAY_BUF-1)
         m_DelaySamples = MAX_DELAY_BUF-1;
+    if(m_DelaySamples < 1)
+        m_DelaySamples = 1;
+    if(m_WindowSamples >= MAX_DELAY_BUF-1)
+        m_WindowSamples = MAX_DELAY_BUF-1;
+    if(m_WindowSamples < 1)
+        m_WindowSamples = 1;
+    if(m_SigDelayPtr >= m_DelaySamples)
+        m_SigDelayPtr = 0;
 
     //m_Mutex.unlock();
 }
 
 
-
 //////////////////////////////////////////////////////////////////////
-// Automatic Gain Control calculator for COMPLEX data
+// Convert a block of log magnitudes to gain values (in place)
+//
+// The peak detector and the averagers are recursive and must run sample
+// by sample, the gain calculation is done in a separate vector loop.
 //////////////////////////////////////////////////////////////////////
-void CAgc::ProcessData(int Length, TYPECPX* pInData, TYPECPX* pOutData)
+void CAgc::CalcGain(int Length, float* pMag)
 {
-    double gain;
-    double mag;
-    TYPECPX delayedin;
+    const unsigned int window = m_WindowSamples;
+    float mag;
+    float peak;
+    int i, idx;
 
-    //m_Mutex.lock();
-    if (m_AgcOn)
+    for (i = 0; i < Length; i++)
     {
-        for (int i=0; i<Length; i++)
+        mag = pMag[i];
+
+        //sliding window peak detector: drop older magnitudes that are smaller
+        //than the new one (they can never become the peak again), append the
+        //new one and drop the front if it has left the window. The front of
+        //the deque is the peak within the window.
+        while (m_PeakCount > 0 &&
+               m_PeakVal[(m_PeakHead + m_PeakCount - 1) & (MAX_DELAY_BUF - 1)] <= mag)
+            m_PeakCount--;
+
+        idx = (m_PeakHead + m_PeakCount) & (MAX_DELAY_BUF - 1);
+        m_PeakVal[idx] = mag;
+        m_PeakPos[idx] = m_SampleCnt;
+        m_PeakCount++;
+
+        if (m_SampleCnt - m_PeakPos[m_PeakHead] >= window)
         {
-            TYPECPX in = pInData[i];	//get latest input sample
-            //Get delayed sample of input signal
-            delayedin = m_SigDelayBuf[m_SigDelayPtr];
-            //put new input sample into signal delay buffer
-            m_SigDelayBuf[m_SigDelayPtr++] = in;
-            if( m_SigDelayPtr >= m_DelaySamples)	//deal with delay buffer wrap around
-                m_SigDelayPtr = 0;
+            m_PeakHead = (m_PeakHead + 1) & (MAX_DELAY_BUF - 1);
+            m_PeakCount--;
+        }
+        m_SampleCnt++;
 
-            //TYPEREAL dmag = 0.5* log10(  (dsig.re*dsig.re+dsig.im*dsig.im)/(MAX_AMPLITUDE*MAX_AMPLITUDE) + 1e-16);	//clamped to -160dBfs
-            //pOutData[i].re = 3000*dmag;
-#if 1
-            mag = fabs(in.re);
-            double mim = fabs(in.im);
-            if (mim>mag)
-                mag = mim;
-            mag = log10( mag + MIN_CONSTANT ) - log10(MAX_AMPLITUDE); //0==max  -8 is min==-160dB
-#else
-            mag = in.re*in.re+in.im*in.im;
-            //mag is power so 0.5 factor takes square root of power
-            mag = 0.5* log10( mag/(MAX_AMPLITUDE*MAX_AMPLITUDE) + 1e-16); //clamped to -160dBfs
-#endif
-            //pOutData[i].re = 3000*mag;
-
-            //pOutData[i].re = 1500*log10( ((delayedin.re*delayedin.re)+(delayedin.im*delayedin.im))/(MAX_AMPLITUDE*MAX_AMPLITUDE) + 1e-16);;
-
-            //create a sliding window of 'm_WindowSamples' magnitudes and output the peak value within the sliding window
-            double tmp = m_MagBuf[m_MagBufPos];  // get oldest mag sample from buffer into tmp
-            m_MagBuf[m_MagBufPos++] = mag;       // put latest mag sample in buffer;
-            if (m_MagBufPos >= m_WindowSamples)  // deal with magnitude buffer wrap around
-                m_MagBufPos = 0;
-            if (mag > m_Peak)
-            {
-                m_Peak = mag;	//if new sample is larger than current peak then use it, no need to look at buffer values
-            }
-            else
-            {
-                if (tmp == m_Peak)    //tmp is oldest sample pulled out of buffer
-                {                     //if oldest sample pulled out was last peak then need to find next highest peak in buffer
-                    m_Peak = -8.0;    //set to lowest value to find next max peak
-                    //search all buffer for maximum value and set as new peak
-                    for (int i=0; i<m_WindowSamples; i++)
-                    {
-                        tmp = m_MagBuf[i];
-                        if (tmp > m_Peak)
-                            m_Peak = tmp;
-                    }
-                }
-            }
+        peak = m_PeakVal[m_PeakHead];
 
-            //pOutData[i].im = 3000*m_Peak;
-
-            if (m_UseHang)
-            {	//using hang timer mode
-                if (m_Peak>m_AttackAve)	//if power is rising (use m_AttackRiseAlpha time constant)
-                    m_AttackAve = (1.0-m_AttackRiseAlpha)*m_AttackAve + m_AttackRiseAlpha*m_Peak;
-                else					//else magnitude is falling (use  m_AttackFallAlpha time constant)
-                    m_AttackAve = (1.0-m_AttackFallAlpha)*m_AttackAve + m_AttackFallAlpha*m_Peak;
-
-                if (m_Peak>m_DecayAve)	//if magnitude is rising (use m_DecayRiseAlpha time constant)
-                {
-                    m_DecayAve = (1.0-m_DecayRiseAlpha)*m_DecayAve + m_DecayRiseAlpha*m_Peak;
-                    m_HangTimer = 0;	//reset hang timer
-                }
-                else
-                {	//here if decreasing signal
-                    if (m_HangTimer<m_HangTime)
-                        m_HangTimer++;	//just inc and hold current m_DecayAve
-                    else	//else decay with m_DecayFallAlpha which is RELEASE_TIMECONST
-                        m_DecayAve = (1.0-m_DecayFallAlpha)*m_DecayAve + m_DecayFallAlpha*m_Peak;
-                }
+        // perform average of magnitude using 2 averagers each with separate rise and fall time constants
+        if (peak > m_AttackAve)	//if magnitude is rising (use m_AttackRiseAlpha time constant)
+            m_AttackAve += m_AttackRiseAlpha * (peak - m_AttackAve);
+        else					//else magnitude is falling (use  m_AttackFallAlpha time constant)
+            m_AttackAve += m_AttackFallAlpha * (peak - m_AttackAve);
+
+        if (m_UseHang)
+        {	//using hang timer mode
+            if (peak > m_DecayAve)	//if magnitude is rising (use m_DecayRiseAlpha time constant)
+            {
+                m_DecayAve += m_DecayRiseAlpha * (peak - m_DecayAve);
+                m_HangTimer = 0;	//reset hang timer
             }
             else
-            {	//using exponential decay mode
-                // perform average of magnitude using 2 averagers each with separate rise and fall time constants
-                if (m_Peak>m_AttackAve)	//if magnitude is rising (use m_AttackRiseAlpha time constant)
-                    m_AttackAve = (1.0-m_AttackRiseAlpha)*m_AttackAve + m_AttackRiseAlpha*m_Peak;
-                else					//else magnitude is falling (use  m_AttackFallAlpha time constant)
-                    m_AttackAve = (1.0-m_AttackFallAlpha)*m_AttackAve + m_AttackFallAlpha*m_Peak;
-
-                //pOutData[i].im = 3000*m_AttackAve;
-                if (m_Peak>m_DecayAve)	//if magnitude is rising (use m_DecayRiseAlpha time constant)
-                    m_DecayAve = (1.0-m_DecayRiseAlpha)*m_DecayAve + m_DecayRiseAlpha*(m_Peak);
-                else					//else magnitude is falling (use m_DecayFallAlpha time constant)
-                    m_DecayAve = (1.0-m_DecayFallAlpha)*m_DecayAve + m_DecayFallAlpha*(m_Peak);
-                //pOutData[i].im = 3000*m_DecayAve;
+            {	//here if decreasing signal
+                if (m_HangTimer<m_HangTime)
+                    m_HangTimer++;	//just inc and hold current m_DecayAve
+                else	//else decay with m_DecayFallAlpha which is RELEASE_TIMECONST
+                    m_DecayAve += m_DecayFallAlpha * (peak - m_DecayAve);
             }
-            //use greater magnitude of attack or Decay Averager
-            if (m_AttackAve>m_DecayAve)
-                mag = m_AttackAve;
-            else
-                mag = m_DecayAve;
-
-            //pOutData[i].im = 3000*mag;
-            //calc gain depending on which side of knee the magnitude is on
-            if (mag<=m_Knee)		//use fixed gain if below knee
-                gain = m_FixedGain;
-            else				//use variable gain if above knee
-                gain = AGC_OUTSCALE * pow(10.0, mag*(m_GainSlope - 1.0) );
-            //pOutData[i].re = .5*gain;
-            pOutData[i].re = delayedin.re * gain;
-            pOutData[i].im = delayedin.im * gain;
         }
+        else
+        {	//using exponential decay mode
+            if (peak > m_DecayAve)	//if magnitude is rising (use m_DecayRiseAlpha time constant)
+                m_DecayAve += m_DecayRiseAlpha * (peak - m_DecayAve);
+            else					//else magnitude is falling (use m_DecayFallAlpha time constant)
+                m_DecayAve += m_DecayFallAlpha * (peak - m_DecayAve);
+        }
+
+        //use greater magnitude of attack or Decay Averager
+        pMag[i] = (m_AttackAve > m_DecayAve) ? m_AttackAve : m_DecayAve;
     }
-    else
+
+    //calc gain depending on which side of knee the magnitude is on
+    for (i = 0; i < Length; i++)
+    {
+        mag = pMag[i];
+        pMag[i] = (mag <= m_Knee) ? m_FixedGain : AGC_OUTSCALE * fast_pow2(mag * m_GainExp);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+// Automatic Gain Control calculator for COMPLEX data
+//////////////////////////////////////////////////////////////////////
+void CAgc::ProcessData(int Length, const TYPECPX* pInData, TYPECPX* pOutData)
+{
+    int i, n, len, cnt;
+
+    //m_Mutex.lock();
+    if (!m_AgcOn)
     {	//manual gain just multiply by m_ManualGain
-        for (int i=0; i<Length; i++)
+        for (i = 0; i < Length; i++)
+            pOutData[i] = pInData[i] * m_ManualAgcGain;
+
+        return;
+    }
+
+    for (n = 0; n < Length; n += AGC_BLOCK_SIZE)
+    {
+        const TYPECPX* in = pInData + n;
+        TYPECPX* out = pOutData + n;
+
+        len = Length - n;
+        if (len > AGC_BLOCK_SIZE)
+            len = AGC_BLOCK_SIZE;
+
+        //magnitude estimate max(|I|,|Q|) converted to log scale
+        //0==max  -8 is min==-160dB
+        for (i = 0; i < len; i++)
+            m_MagBuf[i] = fmaxf(fabsf(in[i].real()), fabsf(in[i].imag()));
+        for (i = 0; i < len; i++)
+            m_MagBuf[i] = LOG10_2 * fast_log2(m_MagBuf[i] + (float)MIN_CONSTANT);
+
+        CalcGain(len, m_MagBuf);
+
+        //apply gain to the delayed signal, one contiguous run of the delay line at a time
+        for (i = 0; i < len; i += cnt)
         {
-            pOutData[i].re = m_ManualAgcGain * pInData[i].re;
-            pOutData[i].im = m_ManualAgcGain * pInData[i].im;
+            cnt = m_DelaySamples - m_SigDelayPtr;
+            if (cnt > len - i)
+                cnt = len - i;
+
+            TYPECPX* dly = m_SigDelayBuf + m_SigDelayPtr;
+            for (int k = 0; k < cnt; k++)
+            {
+                TYPECPX delayedin = dly[k];
+                dly[k] = in[i+k];
+                out[i+k] = delayedin * m_MagBuf[i+k];
+            }
+
+            m_SigDelayPtr += cnt;
+            if (m_SigDelayPtr >= m_DelaySamples)	//deal with delay buffer wrap around
+                m_SigDelayPtr = 0;
         }
     }
     //m_Mutex.unlock();
@@ -300,115 +352,44 @@ void CAgc::ProcessData(int Length, TYPECPX* pInData, TYPECPX* pOutData)
 //////////////////////////////////////////////////////////////////////
 // Automatic Gain Control calculator for REAL data
 //////////////////////////////////////////////////////////////////////
-void CAgc::ProcessData(int Length, double* pInData, double* pOutData)
+void CAgc::ProcessData(int Length, const float* pInData, float* pOutData)
 {
-    double gain;
-    double mag;
-    double delayedin;
+    int i, n, len;
 
     //m_Mutex.lock();
-    if (m_AgcOn)
-    {
-        for (int i=0; i<Length; i++)
-        {
-            double in = pInData[i]; //get latest input sample
+    if (!m_AgcOn)
+    {	// manual gain just multiply by m_ManualGain
+        for (i = 0; i < Length; i++)
+            pOutData[i] = m_ManualAgcGain * pInData[i];
 
-            //Get delayed sample of input signal
-            delayedin = m_SigDelayBuf[m_SigDelayPtr].re;
-            //put new input sample into signal delay buffer
-            m_SigDelayBuf[m_SigDelayPtr++].re = in;
-            if (m_SigDelayPtr >= m_DelaySamples) //deal with delay buffer wrap around
-                m_SigDelayPtr = 0;
+        return;
+    }
 
-            //convert |mag| to log |mag|
-            mag = log10( fabs(in) + MIN_CONSTANT ) - log10(MAX_AMPLITUDE); //0==max  -8 is min==-160dB
+    for (n = 0; n < Length; n += AGC_BLOCK_SIZE)
+    {
+        const float* in = pInData + n;
+        float* out = pOutData + n;
 
-            //create a sliding window of 'm_WindowSamples' magnitudes and output the peak value within the sliding window
-            double tmp = m_MagBuf[m_MagBufPos];  // get oldest mag sample from buffer into tmp
-            m_MagBuf[m_MagBufPos++] = mag;       // put latest mag sample in buffer;
-            if (m_MagBufPos >= m_WindowSamples)  // deal with magnitude buffer wrap around
-                m_MagBufPos = 0;
-            if (mag > m_Peak)
-            {
-                m_Peak = mag;  // if new sample is larger than current peak then use it, no need to look at buffer values
-            }
-            else
-            {
-                if (tmp == m_Peak)   // tmp is oldest sample pulled out of buffer
-                {                    // if oldest sample pulled out was last peak then need to find next highest peak in buffer
-                    m_Peak = -8.0;   // set to lowest value to find next max peak
-                    // search all buffer for maximum value and set as new peak
-                    for (int i=0; i<m_WindowSamples; i++)
-                    {
-                        tmp = m_MagBuf[i];
-                        if (tmp > m_Peak)
-                            m_Peak = tmp;
-                    }
-                }
-            }
+        len = Length - n;
+        if (len > AGC_BLOCK_SIZE)
+            len = AGC_BLOCK_SIZE;
 
-            if (m_UseHang)
-            {	//using hang timer mode
-                if (m_Peak>m_AttackAve)
-                    // if magnitude is rising (use m_AttackRiseAlpha time constant)
-                    m_AttackAve = (1.0-m_AttackRiseAlpha)*m_AttackAve + m_AttackRiseAlpha*m_Peak;
-                else
-                    // else magnitude is falling (use  m_AttackFallAlpha time constant)
-                    m_AttackAve = (1.0-m_AttackFallAlpha)*m_AttackAve + m_AttackFallAlpha*m_Peak;
-
-                if (m_Peak>m_DecayAve)
-                {
-                    // if magnitude is rising (use m_DecayRiseAlpha time constant)
-                    m_DecayAve = (1.0-m_DecayRiseAlpha)*m_DecayAve + m_DecayRiseAlpha*m_Peak;
-                    m_HangTimer = 0; // reset hang timer
-                }
-                else
-                { // here if decreasing signal
-                    if (m_HangTimer<m_HangTime)
-                        m_HangTimer++; // just inc and hold current m_DecayAve
-                    else
-                        // else decay with m_DecayFallAlpha which is RELEASE_TIMECONST
-                        m_DecayAve = (1.0-m_DecayFallAlpha)*m_DecayAve + m_DecayFallAlpha*m_Peak;
-                }
-            }
-            else
-            {	// using exponential decay mode
-                // perform average of magnitude using 2 averagers each with separate rise and fall time constants
-                if (m_Peak>m_AttackAve)
-                    // if magnitude is rising (use m_AttackRiseAlpha time constant)
-                    m_AttackAve = (1.0-m_AttackRiseAlpha)*m_AttackAve + m_AttackRiseAlpha*m_Peak;
-                else
-                    // else magnitude is falling (use  m_AttackFallAlpha time constant)
-                    m_AttackAve = (1.0-m_AttackFallAlpha)*m_AttackAve + m_AttackFallAlpha*m_Peak;
-
-                if (m_Peak>m_DecayAve)
-                    // if magnitude is rising (use m_DecayRiseAlpha time constant)
-                    m_DecayAve = (1.0-m_DecayRiseAlpha)*m_DecayAve + m_DecayRiseAlpha*(m_Peak);
-                else
-                    // else magnitude is falling (use m_DecayFallAlpha time constant)
-                    m_DecayAve = (1.0-m_DecayFallAlpha)*m_DecayAve + m_DecayFallAlpha*(m_Peak);
-            }
+        //convert |mag| to log |mag|
+        for (i = 0; i < len; i++)
+            m_MagBuf[i] = LOG10_2 * fast_log2(fabsf(in[i]) + (float)MIN_CONSTANT);
 
-            // use greater magnitude of attack or Decay Averager
-            if (m_AttackAve>m_DecayAve)
-                mag = m_AttackAve;
-            else
-                mag = m_DecayAve;
+        CalcGain(len, m_MagBuf);
 
-            // calc gain depending on which side of knee the magnitude is on
-            if (mag <= m_Knee)
-                // use fixed gain if below knee
-                gain = m_FixedGain;
-            else
-                // use variable gain if above knee
-                gain = AGC_OUTSCALE * pow(10.0, mag*(m_GainSlope - 1.0) );
-            pOutData[i] = delayedin * gain;
+        for (i = 0; i < len; i++)
+        {
+            //the real signal is kept in the real part of the delay buffer
+            float delayedin = m_SigDelayBuf[m_SigDelayPtr].real();
+            m_SigDelayBuf[m_SigDelayPtr++] = in[i];
+            if (m_SigDelayPtr >= m_DelaySamples) //deal with delay buffer wrap around
+                m_SigDelayPtr = 0;
+
+            out[i] = delayedin * m_MagBuf[i];
         }
     }
-    else
-    {	// manual gain just multiply by m_ManualGain
-        for (int i=0; i<Length; i++)
-            pOutData[i] = m_ManualAgcGain * pInData[i];
-    }
     //m_Mutex.unlock();
 }
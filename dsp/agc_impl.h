@@ -11,18 +11,15 @@
 #ifndef AGC_IMPL_H
 #define AGC_IMPL_H
 
+#include <complex>
+
 //#include "dsp/datatypes.h"
 //#include <QMutex>
 
-#define MAX_DELAY_BUF 2048
-
-typedef struct _dCplx
-{
-    double re;
-    double im;
-} tDComplex;
+#define MAX_DELAY_BUF 2048      // must be a power of 2
+#define AGC_BLOCK_SIZE 512      // samples processed per internal block
 
-#define TYPECPX tDComplex
+typedef std::complex<float> TYPECPX;
 
 
 class CAgc
@@ -31,21 +28,24 @@ public:
     CAgc();
     virtual ~CAgc();
     void SetParameters(bool AgcOn, bool UseHang, int Threshold, int ManualGain, int Slope, int Decay, double SampleRate);
-    void ProcessData(int Length, TYPECPX* pInData, TYPECPX* pOutData);
-    void ProcessData(int Length, double* pInData, double* pOutData);
+    void ProcessData(int Length, const TYPECPX* pInData, TYPECPX* pOutData);
+    void ProcessData(int Length, const float* pInData, float* pOutData);
 
 private:
+    void CalcGain(int Length, float* pMag);
+
     bool m_AgcOn;				//internal copy of AGC settings parameters
     bool m_UseHang;
     int m_Threshold;
     int m_ManualGain;
-    int m_Slope;
+    int m_SlopeFactor;
     int m_Decay;
     double m_SampleRate;
 
-    double m_SlopeFactor;
-    double m_ManualAgcGain;
+    float m_ManualAgcGain;
 
+    // the averagers are kept in double precision because the alphas of
+    // long decay times are too small to be resolved in float
     double m_DecayAve;
     double m_AttackAve;
 
@@ -54,22 +54,27 @@ private:
     double m_DecayRiseAlpha;
     double m_DecayFallAlpha;
 
-    double m_FixedGain;
-    double m_Knee;
-    double m_GainSlope;
-    double m_Peak;
+    float m_FixedGain;
+    float m_Knee;
+    float m_GainSlope;
+    float m_GainExp;            // (m_GainSlope - 1) * log2(10)
 
     int m_SigDelayPtr;
-    int m_MagBufPos;
-    int m_DelaySize;
     int m_DelaySamples;
     int m_WindowSamples;
     int m_HangTime;
     int m_HangTimer;
 
+    // sliding window peak detector (monotonic deque of magnitudes)
+    unsigned int m_SampleCnt;
+    int m_PeakHead;
+    int m_PeakCount;
+    float m_PeakVal[MAX_DELAY_BUF];
+    unsigned int m_PeakPos[MAX_DELAY_BUF];
+
     //QMutex m_Mutex;		//for keeping threads from stomping on each other
     TYPECPX m_SigDelayBuf[MAX_DELAY_BUF];
-    double m_MagBuf[MAX_DELAY_BUF];
+    float m_MagBuf[AGC_BLOCK_SIZE];
 };
 
 #endif //  AGC_IMPL_H
@@ -20,155 +20,256 @@
  * the Free Software Foundation, Inc., 51 Franklin Street,
  * Boston, MA 02110-1301, USA.
  */
+#include <cmath>
+#include <algorithm>
 #include <gnuradio/io_signature.h>
 #include <gnuradio/gr_complex.h>
+#include <string.h>
 #include <iostream>
 #include "dsp/correct_iq_cc.h"
 
+#define IQ_BLOCK    1024    /* Samples per coefficient update. */
+#define IQ_STRIDE   4       /* Use every 4th sample for the statistics. */
+#define IQ_BAL_TAU  0.25    /* Time constant of the imbalance statistics. */
 
-dc_corr_cc_sptr make_dc_corr_cc(double sample_rate, double tau)
+
+iq_corr_cc_sptr make_iq_corr_cc(double sample_rate, double tau, bool iq_swap,
+                                bool dc_remove, bool iq_balance)
 {
-    return gnuradio::get_initial_sptr(new dc_corr_cc(sample_rate, tau));
+    return gnuradio::get_initial_sptr(new iq_corr_cc(sample_rate, tau, iq_swap,
+                                                     dc_remove, iq_balance));
 }
 
 
-/*! \brief Create DC correction object.
+/*! \brief Create I/Q correction object.
  *
- * Use make_dc_corr_cc() instead.
+ * Use make_iq_corr_cc() instead.
  */
-dc_corr_cc::dc_corr_cc(double sample_rate, double tau)
-    : gr::hier_block2 ("dc_corr_cc",
+iq_corr_cc::iq_corr_cc(double sample_rate, double tau, bool iq_swap,
+                       bool dc_remove, bool iq_balance)
+    : gr::sync_block ("iq_corr_cc",
           gr::io_signature::make(1, 1, sizeof(gr_complex)),
-          gr::io_signature::make(1, 1, sizeof(gr_complex)))
+          gr::io_signature::make(1, 1, sizeof(gr_complex))),
+      d_iq_swap(iq_swap),
+      d_dc_remove(dc_remove),
+      d_iq_balance(iq_balance),
+      d_dc_active(false),
+      d_bal_active(false),
+      d_dc_i(0.0),
+      d_dc_q(0.0),
+      d_p_ii(0.0),
+      d_p_qq(0.0),
+      d_p_iq(0.0)
 {
     d_sr = sample_rate;
     d_tau = tau;
-    d_alpha = 1.0 / (1.0 + d_tau * sample_rate);
-
-#ifndef QT_NO_DEBUG_OUTPUT
-    std::cout << "IQ DCR alpha: " << d_alpha << std::endl;
-#endif
-
-    d_iir = gr::filter::single_pole_iir_filter_cc::make(d_alpha, 1);
-    d_sub = gr::blocks::sub_cc::make(1);
-
-    connect(self(), 0, d_iir, 0);
-    connect(self(), 0, d_sub, 0);
-    connect(d_iir, 0, d_sub, 1);
-    connect(d_sub, 0, self(), 0);
+    d_dc_rate = 1.0 / (d_tau * d_sr);
+    d_bal_rate = 1.0 / (IQ_BAL_TAU * d_sr);
 }
 
-dc_corr_cc::~dc_corr_cc()
+iq_corr_cc::~iq_corr_cc()
 {
 
 }
 
-/*! \brief Set new sample rate. */
-void dc_corr_cc::set_sample_rate(double sample_rate)
+int iq_corr_cc::work(int noutput_items,
+                     gr_vector_const_void_star &input_items,
+                     gr_vector_void_star &output_items)
 {
-    d_sr = sample_rate;
-    d_alpha = 1.0 / (1.0 + d_tau * sample_rate);
+    const gr_complex *in = (const gr_complex *) input_items[0];
+    gr_complex *out = (gr_complex *) output_items[0];
+    int i, n;
 
-    d_iir->set_taps(d_alpha);
+    if (!d_dc_remove && !d_iq_balance)
+        d_dc_active = false;
+    if (!d_iq_balance)
+        d_bal_active = false;
 
-#ifndef QT_NO_DEBUG_OUTPUT
-    std::cout << "IQ DCR samp_rate: " << sample_rate << std::endl;
-    std::cout << "IQ DCR alpha: " << d_alpha << std::endl;
-#endif
+    if (!d_iq_swap && !d_dc_remove && !d_iq_balance)
+    {
+        memcpy(out, in, noutput_items * sizeof(gr_complex));
+        return noutput_items;
+    }
+
+    for (i = 0; i < noutput_items; i += IQ_BLOCK)
+    {
+        n = std::min(noutput_items - i, IQ_BLOCK);
+        if (d_dc_remove || d_iq_balance)
+            update_stats(&in[i], n);
+        correct(&in[i], &out[i], n);
+    }
+
+    return noutput_items;
 }
 
-/*! \brief Set new time constant. */
-void dc_corr_cc::set_tau(double tau)
+/*! \brief Update the DC and imbalance estimates with a block of samples.
+ *
+ * The statistics are calculated from every IQ_STRIDE sample, which is
+ * plenty for quantities that change this slowly, and averaged over blocks
+ * with the respective time constants. An estimate that has just been
+ * enabled is initialised from the first block so that it does not have to
+ * settle from zero.
+ */
+void iq_corr_cc::update_stats(const gr_complex *in, int n)
 {
-    d_tau = tau;
-    d_alpha = 1.0 / (1.0 + d_tau * d_sr);
+    double sum_i = 0.0, sum_q = 0.0;
+    double sum_ii = 0.0, sum_qq = 0.0, sum_iq = 0.0;
+    double mean_i, mean_q, x_i, x_q, w;
+    int    i, cnt = 0;
 
-    d_iir->set_taps(d_alpha);
+    for (i = 0; i < n; i += IQ_STRIDE)
+    {
+        x_i = in[i].real();
+        x_q = in[i].imag();
+        sum_i += x_i;
+        sum_q += x_q;
+        sum_ii += x_i * x_i;
+        sum_qq += x_q * x_q;
+        sum_iq += x_i * x_q;
+        cnt++;
+    }
 
-#ifndef QT_NO_DEBUG_OUTPUT
-    std::cout << "IQ DCR alpha: " << d_alpha << std::endl;
-#endif
-}
+    mean_i = sum_i / cnt;
+    mean_q = sum_q / cnt;
 
+    // the DC offset is needed for the imbalance statistics, so it is
+    // estimated even if DC removal is disabled
+    w = d_dc_active ? 1.0 - exp(-n * d_dc_rate) : 1.0;
+    d_dc_i += w * (mean_i - d_dc_i);
+    d_dc_q += w * (mean_q - d_dc_q);
+    d_dc_active = true;
 
-/** I/Q swap **/
-iq_swap_cc_sptr make_iq_swap_cc(bool enabled)
-{
-    return gnuradio::get_initial_sptr(new iq_swap_cc(enabled));
+    if (!d_iq_balance)
+        return;
+
+    // second order statistics around the current DC estimate
+    sum_ii = sum_ii / cnt - d_dc_i * (2.0 * mean_i - d_dc_i);
+    sum_qq = sum_qq / cnt - d_dc_q * (2.0 * mean_q - d_dc_q);
+    sum_iq = sum_iq / cnt - d_dc_i * mean_q - d_dc_q * mean_i + d_dc_i * d_dc_q;
+
+    w = d_bal_active ? 1.0 - exp(-n * d_bal_rate) : 1.0;
+    d_p_ii += w * (sum_ii - d_p_ii);
+    d_p_qq += w * (sum_qq - d_p_qq);
+    d_p_iq += w * (sum_iq - d_p_iq);
+    d_bal_active = true;
 }
 
-iq_swap_cc::iq_swap_cc(bool enabled)
-    : gr::hier_block2 ("iq_swap_cc",
-          gr::io_signature::make(1, 1, sizeof(gr_complex)),
-          gr::io_signature::make(1, 1, sizeof(gr_complex)))
+/*! \brief Apply the corrections to a block of samples.
+ *
+ * With I and Q relative to the DC offset, the imbalance correction is
+ *
+ *   Q' = g * (Q - mu * I),  mu = P_iq / P_ii,  g = sqrt(P_ii / (P_qq - mu * P_iq))
+ *
+ * which together with the DC removal and the swap gives the coefficients
+ * of the affine transformation.
+ */
+void iq_corr_cc::correct(const gr_complex *in, gr_complex *out, int n)
 {
-    d_enabled = enabled;
-    d_c2f = gr::blocks::complex_to_float::make();
-    d_f2c = gr::blocks::float_to_complex::make();
+    const float *x = (const float *) in;
+    float  *y = (float *) out;
+    double  dc_i = 0.0, dc_q = 0.0;
+    double  mu = 0.0, g = 1.0, p_qq;
+    float   a, b, c, d, e, f;
+    float   buf[2 * IQ_BLOCK];
+    int     i;
+
+    if (d_dc_remove)
+    {
+        dc_i = d_dc_i;
+        dc_q = d_dc_q;
+    }
 
-    connect(self(), 0, d_c2f, 0);
-    if (enabled)
+    if (d_iq_balance && d_p_ii > 0.0)
     {
-        connect(d_c2f, 0, d_f2c, 1);
-        connect(d_c2f, 1, d_f2c, 0);
+        mu = d_p_iq / d_p_ii;
+        p_qq = d_p_qq - mu * d_p_iq;
+        if (p_qq > 0.0)
+            g = sqrt(d_p_ii / p_qq);
+        else
+            mu = 0.0;
+    }
+
+    // I' = I - dc_i,  Q' = g * (Q - dc_q) - g * mu * (I - dc_i)
+    a = 1.0;
+    b = 0.0;
+    c = -dc_i;
+    d = -g * mu;
+    e = g;
+    f = g * (mu * dc_i - dc_q);
+
+    if (d_iq_swap)
+    {
+        std::swap(a, d);
+        std::swap(b, e);
+        std::swap(c, f);
+    }
+
+    if (n == IQ_BLOCK)
+    {
+        // with a constant trip count and a local destination that cannot
+        // alias the input, the compiler vectorizes this loop also at -O2
+        for (i = 0; i < 2 * IQ_BLOCK; i += 2)
+        {
+            buf[i]     = a * x[i] + b * x[i + 1] + c;
+            buf[i + 1] = d * x[i] + e * x[i + 1] + f;
+        }
+        memcpy(y, buf, sizeof(buf));
     }
     else
     {
-        connect(d_c2f, 0, d_f2c, 0);
-        connect(d_c2f, 1, d_f2c, 1);
+        for (i = 0; i < 2 * n; i += 2)
+        {
+            y[i]     = a * x[i] + b * x[i + 1] + c;
+            y[i + 1] = d * x[i] + e * x[i + 1] + f;
+        }
     }
-    connect(d_f2c, 0, self(), 0);
 }
 
-iq_swap_cc::~iq_swap_cc()
+/*! \brief Set new sample rate. */
+void iq_corr_cc::set_sample_rate(double sample_rate)
 {
+    d_sr = sample_rate;
+    d_dc_rate = 1.0 / (d_tau * d_sr);
+    d_bal_rate = 1.0 / (IQ_BAL_TAU * d_sr);
 
+#ifndef QT_NO_DEBUG_OUTPUT
+    std::cout << "IQ corr samp_rate: " << sample_rate << std::endl;
+#endif
 }
 
-/*! \brief Enabled or disable I/Q swapping. */
-void iq_swap_cc::set_enabled(bool enabled)
+/*! \brief Set new time constant for the DC estimate. */
+void iq_corr_cc::set_tau(double tau)
 {
-    if (enabled == d_enabled)
-        return;
+    d_tau = tau;
+    d_dc_rate = 1.0 / (d_tau * d_sr);
+}
 
+/*! \brief Enable or disable I/Q swapping. */
+void iq_corr_cc::set_iq_swap(bool enabled)
+{
 #ifndef QT_NO_DEBUG_OUTPUT
     std::cout << "IQ swap: " << enabled << std::endl;
 #endif
 
-    d_enabled = enabled;
+    d_iq_swap = enabled;
+}
 
-    lock();
-    if (d_enabled)
-    {
-        disconnect(d_c2f, 0, d_f2c, 0);
-        disconnect(d_c2f, 1, d_f2c, 1);
-        connect(d_c2f, 0, d_f2c, 1);
-        connect(d_c2f, 1, d_f2c, 0);
-    }
-    else
-    {
-        disconnect(d_c2f, 0, d_f2c, 1);
-        disconnect(d_c2f, 1, d_f2c, 0);
-        connect(d_c2f, 0, d_f2c, 0);
-        connect(d_c2f, 1, d_f2c, 1);
-    }
+/*! \brief Enable or disable DC removal. */
+void iq_corr_cc::set_dc_remove(bool enabled)
+{
+#ifndef QT_NO_DEBUG_OUTPUT
+    std::cout << "IQ DCR: " << enabled << std::endl;
+#endif
 
-/** DEBUG **/
-/** disconnect_all() does not work here **/
-/*
-    disconnect_all();
-    connect(self(), 0, d_c2f, 0);
-    if (enabled)
-    {
-        connect(d_c2f, 0, d_f2c, 1);
-        connect(d_c2f, 1, d_f2c, 0);
-    }
-    else
-    {
-        connect(d_c2f, 0, d_f2c, 0);
-        connect(d_c2f, 1, d_f2c, 1);
-    }
-    connect(d_f2c, 0, self(), 0);
-*/
-    unlock();
+    d_dc_remove = enabled;
+}
+
+/*! \brief Enable or disable I/Q imbalance correction. */
+void iq_corr_cc::set_iq_balance(bool enabled)
+{
+#ifndef QT_NO_DEBUG_OUTPUT
+    std::cout << "IQ balance: " << enabled << std::endl;
+#endif
+
+    d_iq_balance = enabled;
 }
@@ -24,74 +24,96 @@
 #define CORRECT_IQ_CC_H
 
 #include <gnuradio/gr_complex.h>
-#include <gnuradio/blocks/complex_to_float.h>
-#include <gnuradio/blocks/float_to_complex.h>
-#include <gnuradio/hier_block2.h>
-#include <gnuradio/filter/single_pole_iir_filter_cc.h>
-#include <gnuradio/blocks/sub_cc.h>
+#include <gnuradio/sync_block.h>
+#include <boost/atomic.hpp>
 
-class dc_corr_cc;
-class iq_swap_cc;
+class iq_corr_cc;
 
-typedef boost::shared_ptr<dc_corr_cc> dc_corr_cc_sptr;
-typedef boost::shared_ptr<iq_swap_cc> iq_swap_cc_sptr;
+typedef boost::shared_ptr<iq_corr_cc> iq_corr_cc_sptr;
 
-/*! \brief Return a shared_ptr to a new instance of dc_corr_cc.
- *  \param sample_rate The sample rate
- *  \param tau The time constant for the filter
+/*! \brief Return a shared_ptr to a new instance of iq_corr_cc.
+ *  \param sample_rate The sample rate.
+ *  \param tau The time constant for the DC estimate.
+ *  \param iq_swap Whether I and Q should be swapped.
+ *  \param dc_remove Whether DC removal is enabled.
+ *  \param iq_balance Whether I/Q imbalance correction is enabled.
  */
-dc_corr_cc_sptr make_dc_corr_cc(double sample_rate, double tau=1.0);
+iq_corr_cc_sptr make_iq_corr_cc(double sample_rate, double tau=1.0,
+                                bool iq_swap=false, bool dc_remove=true,
+                                bool iq_balance=false);
 
-/*! \brief Single pole IIR filter-based DC offset correction block.
+/*! \brief I/Q swap, DC removal and I/Q imbalance correction.
  *  \ingroup DSP
  *
- * This block performs automatic DC offset removal using a single pole IIR
- * filter
+ * This block conditions the I/Q stream from the hardware in a single pass.
+ * It runs at the full input rate, so the three corrections are combined
+ * into one affine transformation of (I, Q):
+ *
+ *   I' = a*I + b*Q + c
+ *   Q' = d*I + e*Q + f
+ *
+ * The coefficients are updated once per block of samples from statistics
+ * estimated on every fourth sample of the block:
+ *
+ * - The DC offset is the mean of I and Q, averaged with time constant tau.
+ * - The imbalance correction removes the part of Q that is correlated with
+ *   I, which corrects the phase error, and scales the remainder to the
+ *   power of I, which corrects the amplitude error.
+ * - Swapping I and Q exchanges the two output rows.
+ *
+ * Each correction has its own enable flag, which may be changed while the
+ * flow graph is running. The samples are copied unmodified when all of
+ * them are disabled.
  */
-class dc_corr_cc : public gr::hier_block2
+class iq_corr_cc : public gr::sync_block
 {
-    friend dc_corr_cc_sptr make_dc_corr_cc(double sample_rate, double tau);
+    friend iq_corr_cc_sptr make_iq_corr_cc(double sample_rate, double tau,
+                                           bool iq_swap, bool dc_remove,
+                                           bool iq_balance);
 
 protected:
-    dc_corr_cc(double sample_rate, double tau);
+    iq_corr_cc(double sample_rate, double tau, bool iq_swap, bool dc_remove,
+               bool iq_balance);
 
 public:
-    ~dc_corr_cc();
-    void set_sample_rate(double sample_rate);
-    void set_tau(double tau);
-
-private:
-    gr::filter::single_pole_iir_filter_cc::sptr d_iir;
-    gr::blocks::sub_cc::sptr                    d_sub;
-
-    double d_sr;     /*!< Sample rate. */
-    double d_tau;    /*!< Time constant. */
-    double d_alpha;  /*!< 1/(1+tau/T). */
-};
+    ~iq_corr_cc();
 
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items);
 
+    void set_sample_rate(double sample_rate);
+    void set_tau(double tau);
 
-/*! \brief Return a shared_ptr to a new instance of iq_swap_cc. */
-iq_swap_cc_sptr make_iq_swap_cc(bool enabled);
-
-/*! \brief Block to swap I and Q channels.
- *  \ingroup DSP
- */
-class iq_swap_cc : public gr::hier_block2
-{
-    friend iq_swap_cc_sptr make_iq_swap_cc(bool enabled);
+    void set_iq_swap(bool enabled);
+    void set_dc_remove(bool enabled);
+    void set_iq_balance(bool enabled);
 
-protected:
-    iq_swap_cc(bool enabled);
+    bool iq_swap() const { return d_iq_swap; }
+    bool dc_remove() const { return d_dc_remove; }
+    bool iq_balance() const { return d_iq_balance; }
 
-public:
-    ~iq_swap_cc();
-    void set_enabled(bool enabled);
+private:
+    void update_stats(const gr_complex *in, int n);
+    void correct(const gr_complex *in, gr_complex *out, int n);
 
 private:
-    gr::blocks::complex_to_float::sptr d_c2f;
-    gr::blocks::float_to_complex::sptr d_f2c;
-    bool d_enabled;
+    double d_sr;     /*!< Sample rate. */
+    double d_tau;    /*!< Time constant of the DC estimate. */
+
+    boost::atomic<double> d_dc_rate;     /*!< 1/(tau*sample_rate). */
+    boost::atomic<double> d_bal_rate;    /*!< Same for the imbalance statistics. */
+    boost::atomic<bool>   d_iq_swap;     /*!< Requested I/Q swap state. */
+    boost::atomic<bool>   d_dc_remove;   /*!< Requested DC removal state. */
+    boost::atomic<bool>   d_iq_balance;  /*!< Requested I/Q balance state. */
+
+    bool   d_dc_active;  /*!< DC estimate is valid. */
+    bool   d_bal_active; /*!< Imbalance statistics are valid. */
+    double d_dc_i;       /*!< DC offset of I. */
+    double d_dc_q;       /*!< DC offset of Q. */
+    double d_p_ii;       /*!< Power of I. */
+    double d_p_qq;       /*!< Power of Q. */
+    double d_p_iq;       /*!< Cross correlation of I and Q. */
 };
 
 #endif /* CORRECT_IQ_CC_H */
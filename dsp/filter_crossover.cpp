@@ -0,0 +1,146 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           http://gqrx.dk/
+ *
+ * Copyright 2011-2014 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <iostream>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <gnuradio/gr_complex.h>
+#include <gnuradio/high_res_timer.h>
+#include <gnuradio/prefs.h>
+#include <gnuradio/filter/fir_filter.h>
+#include <gnuradio/filter/fft_filter.h>
+#include "dsp/filter_crossover.h"
+
+#define XOVER_CCC       128     /* Default crossover for complex taps. */
+#define XOVER_FFF       256     /* Default crossover for float taps. */
+#define XOVER_MIN_TAPS  16      /* Smallest tap count tried. */
+#define XOVER_MAX_TAPS  4096    /* Largest tap count tried. */
+#define XOVER_NEVER     100000  /* Returned if the FFT filter never won. */
+#define XOVER_SAMPLES   8192    /* Samples filtered in each measurement. */
+#define XOVER_PAD       16384   /* Room for the FFT filter to overrun. */
+
+static boost::mutex xover_mutex;
+static unsigned int xover_ccc = 0;
+static unsigned int xover_fff = 0;
+
+
+/*! \brief Time the filter kernels for one tap count.
+ *  \param ntaps The number of taps.
+ *  \param t_fir Time spent in the direct form filter.
+ *  \param t_fft Time spent in the FFT filter.
+ *
+ * The FFT filter processes input in blocks of a size that depends on the
+ * number of taps, so the buffers are padded for the last block to fit.
+ * Both filters are run once before the timing to warm the caches.
+ */
+template <class T, class FIR, class FFT>
+static void time_filters(unsigned int ntaps, gr::high_res_timer_type &t_fir,
+                         gr::high_res_timer_type &t_fft)
+{
+    std::vector<T> taps(ntaps, T(1.0 / ntaps));
+    std::vector<T> in(XOVER_SAMPLES + XOVER_PAD, T(0.5));
+    std::vector<T> out(XOVER_SAMPLES + XOVER_PAD);
+    FIR fir(1, taps);
+    FFT fft(1, taps);
+    gr::high_res_timer_type t0;
+
+    fir.filterN(&out[0], &in[0], XOVER_SAMPLES);
+    t0 = gr::high_res_timer_now();
+    fir.filterN(&out[0], &in[0], XOVER_SAMPLES);
+    t_fir = gr::high_res_timer_now() - t0;
+
+    fft.filter(XOVER_SAMPLES, &in[0], &out[0]);
+    t0 = gr::high_res_timer_now();
+    fft.filter(XOVER_SAMPLES, &in[0], &out[0]);
+    t_fft = gr::high_res_timer_now() - t0;
+}
+
+/*! \brief Find the smallest power of two tap count for which the FFT filter wins. */
+template <class T, class FIR, class FFT>
+static unsigned int measure_crossover(const char *name)
+{
+    gr::high_res_timer_type t_fir, t_fft;
+    unsigned int ntaps;
+
+    for (ntaps = XOVER_MIN_TAPS; ntaps <= XOVER_MAX_TAPS; ntaps *= 2)
+    {
+        time_filters<T, FIR, FFT>(ntaps, t_fir, t_fft);
+        if (t_fft < t_fir)
+            break;
+    }
+
+    if (ntaps > XOVER_MAX_TAPS)
+        ntaps = XOVER_NEVER;
+
+#ifndef QT_NO_DEBUG_OUTPUT
+    std::cout << "FFT filter crossover (" << name << "): " << ntaps
+              << " taps" << std::endl;
+#else
+    (void) name;
+#endif
+
+    return ntaps;
+}
+
+/*! \brief Get a crossover from the GNU Radio preferences.
+ *  \param option The option in the [gqrx] section.
+ *  \param default_val The value to use if the option is not set.
+ *  \return The configured crossover, 0 if it shall be measured.
+ */
+static unsigned int configured_crossover(const char *option, long default_val)
+{
+    long val = gr::prefs::singleton()->get_long("gqrx", option, default_val);
+
+    return val < 0 ? default_val : val;
+}
+
+unsigned int fft_crossover_ccc(void)
+{
+    boost::mutex::scoped_lock lock(xover_mutex);
+
+    if (xover_ccc == 0)
+    {
+        xover_ccc = configured_crossover("fft_crossover_ccc", XOVER_CCC);
+        if (xover_ccc == 0)
+            xover_ccc = measure_crossover<gr_complex,
+                                          gr::filter::kernel::fir_filter_ccc,
+                                          gr::filter::kernel::fft_filter_ccc>("ccc");
+    }
+
+    return xover_ccc;
+}
+
+unsigned int fft_crossover_fff(void)
+{
+    boost::mutex::scoped_lock lock(xover_mutex);
+
+    if (xover_fff == 0)
+    {
+        xover_fff = configured_crossover("fft_crossover_fff", XOVER_FFF);
+        if (xover_fff == 0)
+            xover_fff = measure_crossover<float,
+                                          gr::filter::kernel::fir_filter_fff,
+                                          gr::filter::kernel::fft_filter_fff>("fff");
+    }
+
+    return xover_fff;
+}
@@ -0,0 +1,46 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           http://gqrx.dk/
+ *
+ * Copyright 2011-2014 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef FILTER_CROSSOVER_H
+#define FILTER_CROSSOVER_H
+
+/*! \brief Get the tap count above which fft_filter_ccc is faster than fir_filter_ccc.
+ *
+ * The crossover is a fixed default, so that the filter topology does not
+ * depend on the machine load at startup. It can be tuned with the
+ * fft_crossover_ccc option in the [gqrx] section of the GNU Radio config
+ * or the GR_CONF_GQRX_FFT_CROSSOVER_CCC environment variable. A value of 0
+ * makes the first call run a short benchmark of both filter kernels with
+ * increasing tap counts and use the smallest tap count for which the FFT
+ * filter was faster. Subsequent calls return the stored value.
+ */
+unsigned int fft_crossover_ccc(void);
+
+/*! \brief Get the tap count above which fft_filter_fff is faster than fir_filter_fff.
+ *
+ * The option is called fft_crossover_fff.
+ *
+ * \sa fft_crossover_ccc()
+ */
+unsigned int fft_crossover_fff(void);
+
+#endif // FILTER_CROSSOVER_H
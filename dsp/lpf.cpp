@@ -23,6 +23,7 @@
 #include <cmath>
 #include <gnuradio/io_signature.h>
 #include <gnuradio/filter/firdes.h>
+#include "dsp/filter_crossover.h"
 #include "dsp/lpf.h"
 
 static const int MIN_IN  = 1; /* Mininum number of input streams. */
@@ -48,6 +49,7 @@ lpf_ff::lpf_ff(double sample_rate, double cutoff_freq,
     : gr::hier_block2("lpf_ff",
                      gr::io_signature::make(MIN_IN,  MAX_IN,  sizeof (float)),
                      gr::io_signature::make(MIN_OUT, MAX_OUT, sizeof (float))),
+    d_use_fft(false),
     d_sample_rate(sample_rate),
     d_cutoff_freq(cutoff_freq),
     d_trans_width(trans_width),
@@ -58,11 +60,21 @@ lpf_ff::lpf_ff(double sample_rate, double cutoff_freq,
                                  d_cutoff_freq, d_trans_width);
 
     /* create low-pass filter (decimation=1) */
-    lpf = gr::filter::fir_filter_fff::make(1, d_taps);
+    if (d_taps.size() >= fft_crossover_fff())
+    {
+        d_use_fft = true;
+        fft_lpf = gr::filter::fft_filter_fff::make(1, d_taps);
 
-    /* connect filter */
-    connect(self(), 0, lpf, 0);
-    connect(lpf, 0, self(), 0);
+        connect(self(), 0, fft_lpf, 0);
+        connect(fft_lpf, 0, self(), 0);
+    }
+    else
+    {
+        lpf = gr::filter::fir_filter_fff::make(1, d_taps);
+
+        connect(self(), 0, lpf, 0);
+        connect(lpf, 0, self(), 0);
+    }
 }
 
 
@@ -81,6 +93,52 @@ void lpf_ff::set_param(double cutoff_freq, double trans_width)
     d_taps = gr::filter::firdes::low_pass(d_gain, d_sample_rate,
                                  d_cutoff_freq, d_trans_width);
 
-    lpf->set_taps(d_taps);
+    set_taps();
+}
+
+/*! \brief Load d_taps into the FIR or FFT filter depending on the number of taps. */
+void lpf_ff::set_taps(void)
+{
+    bool use_fft = d_taps.size() >= fft_crossover_fff();
+
+    if (use_fft == d_use_fft)
+    {
+        if (d_use_fft)
+            fft_lpf->set_taps(d_taps);
+        else
+            lpf->set_taps(d_taps);
+        return;
+    }
+
+    if (use_fft)
+    {
+        if (fft_lpf)
+            fft_lpf->set_taps(d_taps);
+        else
+            fft_lpf = gr::filter::fft_filter_fff::make(1, d_taps);
+
+        lock();
+        disconnect(self(), 0, lpf, 0);
+        disconnect(lpf, 0, self(), 0);
+        connect(self(), 0, fft_lpf, 0);
+        connect(fft_lpf, 0, self(), 0);
+        unlock();
+    }
+    else
+    {
+        if (lpf)
+            lpf->set_taps(d_taps);
+        else
+            lpf = gr::filter::fir_filter_fff::make(1, d_taps);
+
+        lock();
+        disconnect(self(), 0, fft_lpf, 0);
+        disconnect(fft_lpf, 0, self(), 0);
+        connect(self(), 0, lpf, 0);
+        connect(lpf, 0, self(), 0);
+        unlock();
+    }
+
+    d_use_fft = use_fft;
 }
 
@@ -26,6 +26,7 @@
 #include <gnuradio/hier_block2.h>
 #include <gnuradio/filter/firdes.h>
 #include <gnuradio/filter/fir_filter_fff.h>
+#include <gnuradio/filter/fft_filter_fff.h>
 
 
 class lpf_ff;
@@ -56,6 +57,9 @@ lpf_ff_sptr make_lpf_ff(double sample_rate=48000.,
  * required to generate filter taps. It provides a simple
  * interface to set the filter parameters.
  *
+ * An FFT filter is used instead of the direct form FIR filter when the
+ * number of taps reaches fft_crossover_fff().
+ *
  * The user of this class is expected to provide valid parameters and no checks are
  * performed by the accessors (though the taps generator from gr::filter::firdes does perform
  * some sanity checks and throws std::out_of_range in case of bad parameter).
@@ -73,12 +77,17 @@ public:
 
     void set_param(double cutoff_freq, double trans_width);
 
+private:
+    void set_taps(void);
+
 private:
     /* GR blocks */
     gr::filter::fir_filter_fff::sptr lpf;
+    gr::filter::fft_filter_fff::sptr fft_lpf;
 
     /* other parameters */
     std::vector<float> d_taps;
+    bool   d_use_fft;
     double d_sample_rate;
     double d_cutoff_freq;
     double d_trans_width;
@@ -21,10 +21,48 @@
  * Boston, MA 02110-1301, USA.
  */
 #include <cstdio>
+#include <map>
+#include <boost/thread/mutex.hpp>
 #include <gnuradio/io_signature.h>
 #include <gnuradio/filter/firdes.h>
 #include "dsp/resampler_xx.h"
 
+#define RESAMP_FLT_SIZE   32   /* Number of filters in the PFB. */
+#define RESAMP_CACHE_SIZE 32   /* Max number of tap sets in the cache. */
+
+static boost::mutex                          taps_mutex;
+static std::map<float, std::vector<float> >  taps_cache;
+
+/*! \brief Get the prototype filter for a resampling rate.
+ *  \param rate Resampling rate, i.e. output/input.
+ *
+ * In case of decimation, we limit the cutoff to the output bandwidth to
+ * avoid "phantom" signals when we have a frequency translation in front of
+ * the PFB resampler. The filter therefore only depends on min(rate, 1).
+ *
+ * Designing the filter takes much longer than loading it into the PFB, so
+ * the taps are cached and shared by all resamplers. The cache is cleared
+ * when it gets full, which only happens if the rate is changed to many
+ * different values.
+ */
+static std::vector<float> resampler_taps(float rate)
+{
+    boost::mutex::scoped_lock lock(taps_mutex);
+    std::map<float, std::vector<float> >::iterator it;
+    float  key = rate > 1.0 ? 1.0 : rate;
+
+    it = taps_cache.find(key);
+    if (it != taps_cache.end())
+        return it->second;
+
+    if (taps_cache.size() >= RESAMP_CACHE_SIZE)
+        taps_cache.clear();
+
+    return taps_cache[key] = gr::filter::firdes::low_pass(RESAMP_FLT_SIZE,
+                                                          RESAMP_FLT_SIZE,
+                                                          0.4 * key, 0.2 * key);
+}
+
 
 /* Create a new instance of resampler_cc and return
  * a boost shared_ptr. This is effectively the public constructor.
@@ -43,20 +81,13 @@ resampler_cc::resampler_cc(float rate)
        http://gnuradio.squarespace.com/blog/2010/12/6/new-interface-for-pfb_arb_resampler_ccf.html
 
        and blks2.pfb_arb_resampler.py
-
-       Note: In case of decimation, we limit the cutoff to the output bandwidth to avoid "phantom"
-             signals when we have a frequency translation in front of the PFB resampler.
     */
 
-    /* generate taps */
-    double cutoff = rate > 1.0 ? 0.4 : 0.4*rate;
-    double trans_width = rate > 1.0 ? 0.2 : 0.2*rate;
-    unsigned int flt_size = 32;
-
-    d_taps = gr::filter::firdes::low_pass(flt_size, flt_size, cutoff, trans_width);
+    d_rate = rate;
+    d_taps = resampler_taps(rate);
 
     /* create the filter */
-    d_filter = gr::filter::pfb_arb_resampler_ccf::make(rate, d_taps, flt_size);
+    d_filter = gr::filter::pfb_arb_resampler_ccf::make(rate, d_taps, RESAMP_FLT_SIZE);
 
     /* connect filter */
     connect(self(), 0, d_filter, 0);
@@ -68,23 +99,30 @@ resampler_cc::~resampler_cc()
 
 }
 
+/*! \brief Set new resampling rate.
+ *  \param rate Resampling rate, i.e. output/input.
+ *
+ * The taps are loaded into the existing PFB, which keeps its filter
+ * state, so the output remains continuous and the flow graph does not
+ * have to be locked.
+ */
 void resampler_cc::set_rate(float rate)
 {
-    /* generate taps */
-    double cutoff = rate > 1.0 ? 0.4 : 0.4*rate;
-    double trans_width = rate > 1.0 ? 0.2 : 0.2*rate;
-    unsigned int flt_size = 32;
-    d_taps = gr::filter::firdes::low_pass(flt_size, flt_size, cutoff, trans_width);
-
-    /* FIXME: Should implement set_taps() in PFB */
-    lock();
-    disconnect(self(), 0, d_filter, 0);
-    disconnect(d_filter, 0, self(), 0);
-    d_filter.reset();
-    d_filter = gr::filter::pfb_arb_resampler_ccf::make(rate, d_taps, flt_size);
-    connect(self(), 0, d_filter, 0);
-    connect(d_filter, 0, self(), 0);
-    unlock();
+    std::vector<float> taps;
+
+    if (rate == d_rate)
+        return;
+
+    taps = resampler_taps(rate);
+
+    // the taps are the same for all interpolating rates
+    if (taps != d_taps)
+    {
+        d_taps = taps;
+        d_filter->set_taps(d_taps);
+    }
+    d_rate = rate;
+    d_filter->set_rate(rate);
 }
 
 /* Create a new instance of resampler_ff and return
@@ -104,20 +142,13 @@ resampler_ff::resampler_ff(float rate)
        http://gnuradio.squarespace.com/blog/2010/12/6/new-interface-for-pfb_arb_resampler_ccf.html
 
        and blks2.pfb_arb_resampler.py
-
-       Note: In case of decimation, we limit the cutoff to the output bandwidth to avoid "phantom"
-             signals when we have a frequency translation in front of the PFB resampler.
     */
 
-    /* generate taps */
-    double cutoff = rate > 1.0 ? 0.4 : 0.4*rate;
-    double trans_width = rate > 1.0 ? 0.2 : 0.2*rate;
-    unsigned int flt_size = 32;
-
-    d_taps = gr::filter::firdes::low_pass(flt_size, flt_size, cutoff, trans_width);
+    d_rate = rate;
+    d_taps = resampler_taps(rate);
 
     /* create the filter */
-    d_filter = gr::filter::pfb_arb_resampler_fff::make(rate, d_taps, flt_size);
+    d_filter = gr::filter::pfb_arb_resampler_fff::make(rate, d_taps, RESAMP_FLT_SIZE);
 
     /* connect filter */
     connect(self(), 0, d_filter, 0);
@@ -129,21 +160,28 @@ resampler_ff::~resampler_ff()
 
 }
 
+/*! \brief Set new resampling rate.
+ *  \param rate Resampling rate, i.e. output/input.
+ *
+ * The taps are loaded into the existing PFB, which keeps its filter
+ * state, so the output remains continuous and the flow graph does not
+ * have to be locked.
+ */
 void resampler_ff::set_rate(float rate)
 {
-    /* generate taps */
-    double cutoff = rate > 1.0 ? 0.4 : 0.4*rate;
-    double trans_width = rate > 1.0 ? 0.2 : 0.2*rate;
-    unsigned int flt_size = 32;
-    d_taps = gr::filter::firdes::low_pass(flt_size, flt_size, cutoff, trans_width);
-
-    /* FIXME: Should implement set_taps() in PFB */
-    lock();
-    disconnect(self(), 0, d_filter, 0);
-    disconnect(d_filter, 0, self(), 0);
-    d_filter.reset();
-    d_filter = gr::filter::pfb_arb_resampler_fff::make(rate, d_taps, flt_size);
-    connect(self(), 0, d_filter, 0);
-    connect(d_filter, 0, self(), 0);
-    unlock();
+    std::vector<float> taps;
+
+    if (rate == d_rate)
+        return;
+
+    taps = resampler_taps(rate);
+
+    // the taps are the same for all interpolating rates
+    if (taps != d_taps)
+    {
+        d_taps = taps;
+        d_filter->set_taps(d_taps);
+    }
+    d_rate = rate;
+    d_filter->set_rate(rate);
 }
@@ -57,8 +57,10 @@ public:
     ~resampler_cc();
 
     void set_rate(float rate);
+    float rate() const { return d_rate; }
 
 private:
+    float                         d_rate;
     std::vector<float>            d_taps;
     gr::filter::pfb_arb_resampler_ccf::sptr d_filter;
 };
@@ -87,8 +89,10 @@ public:
     ~resampler_ff();
 
     void set_rate(float rate);
+    float rate() const { return d_rate; }
 
 private:
+    float                         d_rate;
     std::vector<float>            d_taps;
     gr::filter::pfb_arb_resampler_fff::sptr d_filter;
 };
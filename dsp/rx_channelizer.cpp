@@ -0,0 +1,143 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           http://gqrx.dk/
+ *
+ * Copyright 2011-2014 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <cmath>
+#include <iostream>
+#include <gnuradio/io_signature.h>
+#include <gnuradio/filter/firdes.h>
+#include "dsp/rx_channelizer.h"
+
+
+/*
+ * Create a new instance of rx_channelizer_cc and return
+ * a boost shared_ptr. This is effectively the public constructor.
+ */
+rx_channelizer_cc_sptr make_rx_channelizer_cc(double sample_rate, unsigned int num_chans)
+{
+    return gnuradio::get_initial_sptr(new rx_channelizer_cc(sample_rate, num_chans));
+}
+
+
+rx_channelizer_cc::rx_channelizer_cc(double sample_rate, unsigned int num_chans)
+    : gr::hier_block2("rx_channelizer_cc",
+                      gr::io_signature::make(1, 1, sizeof(gr_complex)),
+                      gr::io_signature::make(num_chans, num_chans, sizeof(gr_complex))),
+      d_sample_rate(sample_rate),
+      d_num_chans(num_chans)
+{
+    double spacing = chan_spacing();
+
+    /* The output rate is twice the channel spacing, so the passband can
+     * extend to 0.75 * spacing while the stop band starts where the
+     * aliases would fall back into the passband (1.25 * spacing).
+     */
+    d_taps = gr::filter::firdes::low_pass(1.0, d_sample_rate, spacing,
+                                          0.5 * spacing,
+                                          gr::filter::firdes::WIN_BLACKMAN_hARRIS);
+
+#ifndef QT_NO_DEBUG_OUTPUT
+    std::cout << "Channelizer: " << d_num_chans << " channels, "
+              << d_taps.size() << " taps, output rate " << chan_rate()
+              << std::endl;
+#endif
+
+    s2s = gr::blocks::stream_to_streams::make(sizeof(gr_complex), d_num_chans);
+    pfb = gr::filter::pfb_channelizer_ccf::make(d_num_chans, d_taps,
+                                                RX_CHANNELIZER_OVERSAMPLE);
+    nsink = gr::blocks::null_sink::make(sizeof(gr_complex));
+
+    connect(self(), 0, s2s, 0);
+    for (unsigned int i = 0; i < d_num_chans; i++)
+    {
+        connect(s2s, i, pfb, i);
+        connect(pfb, i, self(), i);
+        connect(pfb, i, nsink, i);
+    }
+}
+
+rx_channelizer_cc::~rx_channelizer_cc()
+{
+
+}
+
+/*! \brief Calculate the number of channels for a given channel bandwidth.
+ *  \param sample_rate The input sample rate.
+ *  \param bandwidth The bandwidth needed by each channel.
+ *  \return The number of channels or 0 if the channelizer can not be used.
+ *
+ * The signal may be anywhere between two channel centers, so the channel
+ * spacing must be at least twice the bandwidth for the signal to fit in the
+ * passband. The pfb channelizer also requires the number of channels to be
+ * a multiple of the oversampling.
+ */
+unsigned int rx_channelizer_cc::calc_num_chans(double sample_rate, double bandwidth)
+{
+    unsigned int num_chans;
+
+    if (bandwidth <= 0.0)
+        return 0;
+
+    num_chans = (unsigned int) floor(0.5 * sample_rate / bandwidth);
+    num_chans -= num_chans % RX_CHANNELIZER_OVERSAMPLE;
+
+    if (num_chans < RX_CHANNELIZER_MIN_CHANS)
+        return 0;
+
+    return num_chans;
+}
+
+/*! \brief Get the sample rate of the outputs. */
+double rx_channelizer_cc::chan_rate(void) const
+{
+    return chan_spacing() * RX_CHANNELIZER_OVERSAMPLE;
+}
+
+/*! \brief Get the distance between two channel centers. */
+double rx_channelizer_cc::chan_spacing(void) const
+{
+    return d_sample_rate / d_num_chans;
+}
+
+/*! \brief Get the center frequency of a channel relative to the input. */
+double rx_channelizer_cc::chan_center(int chan) const
+{
+    if (chan >= (int) d_num_chans / 2)
+        chan -= d_num_chans;
+
+    return chan * chan_spacing();
+}
+
+/*! \brief Get the channel closest to a frequency offset.
+ *  \param offset The offset from the input center frequency in Hz.
+ */
+int rx_channelizer_cc::chan_for_offset(double offset) const
+{
+    int half = d_num_chans / 2;
+    int chan = (int) floor(offset / chan_spacing() + 0.5);
+
+    if (chan < -half)
+        chan = -half;
+    else if (chan >= half)
+        chan = half - 1;
+
+    return chan < 0 ? chan + d_num_chans : chan;
+}
@@ -0,0 +1,104 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           http://gqrx.dk/
+ *
+ * Copyright 2011-2014 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef RX_CHANNELIZER_H
+#define RX_CHANNELIZER_H
+
+#include <vector>
+#include <gnuradio/hier_block2.h>
+#include <gnuradio/blocks/null_sink.h>
+#include <gnuradio/blocks/stream_to_streams.h>
+#include <gnuradio/filter/pfb_channelizer_ccf.h>
+
+/*! \brief Oversampling ratio of the channelizer outputs. */
+#define RX_CHANNELIZER_OVERSAMPLE 2
+
+/*! \brief Smallest number of channels where the channelizer pays off. */
+#define RX_CHANNELIZER_MIN_CHANS  4
+
+/*! \brief Smallest number of active VFOs where the channelizer pays off.
+ *
+ * The channelizer has a fixed cost comparable to 3-6 full rate mixers and
+ * resamplers (3 at 2 Msps, 6 at 10 Msps), below that the VFOs are mixed
+ * down individually. Measured with bench/bench_channelizer.
+ */
+#define RX_CHANNELIZER_MIN_VFOS   6
+
+
+class rx_channelizer_cc;
+
+typedef boost::shared_ptr<rx_channelizer_cc> rx_channelizer_cc_sptr;
+
+
+/*! \brief Return a shared_ptr to a new instance of rx_channelizer_cc.
+ *  \param sample_rate The input sample rate.
+ *  \param num_chans The number of channels (must be even).
+ *
+ * This is effectively the public constructor.
+ */
+rx_channelizer_cc_sptr make_rx_channelizer_cc(double sample_rate, unsigned int num_chans);
+
+/*! \brief Polyphase filter bank channelizer.
+ *  \ingroup DSP
+ *
+ * This block splits the wideband input into num_chans channels spaced
+ * sample_rate/num_chans apart. Each output carries one channel centered
+ * at 0 Hz and oversampled by RX_CHANNELIZER_OVERSAMPLE. The passband
+ * extends to 0.75 times the channel spacing, so a signal up to half a
+ * channel spacing wide can be received anywhere between two channel
+ * centers.
+ *
+ * The outputs are numbered like FFT bins, i.e. output 0 is centered at
+ * 0 Hz and outputs above num_chans/2 hold the negative frequencies.
+ * Outputs that are not connected by the user are consumed internally.
+ */
+class rx_channelizer_cc : public gr::hier_block2
+{
+    friend rx_channelizer_cc_sptr make_rx_channelizer_cc(double sample_rate, unsigned int num_chans);
+
+protected:
+    rx_channelizer_cc(double sample_rate, unsigned int num_chans);
+
+public:
+    ~rx_channelizer_cc();
+
+    static unsigned int calc_num_chans(double sample_rate, double bandwidth);
+
+    unsigned int num_chans(void) const { return d_num_chans; }
+    double sample_rate(void) const { return d_sample_rate; }
+    double chan_rate(void) const;
+    double chan_spacing(void) const;
+    double chan_center(int chan) const;
+    int    chan_for_offset(double offset) const;
+
+private:
+    gr::blocks::stream_to_streams::sptr  s2s;     /*!< Input commutator. */
+    gr::filter::pfb_channelizer_ccf::sptr pfb;    /*!< The filter bank. */
+    gr::blocks::null_sink::sptr          nsink;   /*!< Sink for unused channels. */
+
+    std::vector<float> d_taps;
+    double       d_sample_rate;
+    unsigned int d_num_chans;
+};
+
+
+#endif // RX_CHANNELIZER_H
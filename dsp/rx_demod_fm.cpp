@@ -22,9 +22,12 @@
  */
 #include <gnuradio/io_signature.h>
 #include <gnuradio/filter/firdes.h>
+#include <volk/volk.h>
 #include <dsp/rx_demod_fm.h>
+#include <dsp/rx_hb_decim.h>
 #include <math.h>
-#include <iostream>
+#include <string.h>
+#include <algorithm>
 
 
 /* Create a new instance of rx_demod_fm and return a boost shared_ptr. */
@@ -39,49 +42,262 @@ static const int MAX_IN = 1;  /* Maximum number of input streams. */
 static const int MIN_OUT = 1; /* Minimum number of output streams. */
 static const int MAX_OUT = 1; /* Maximum number of output streams. */
 
+/* Decimation filter cutoff and transition width relative to the audio
+ * rate. The band up to 0.44 * audio_rate is free from aliases, which at
+ * 120 ksps covers the stereo sub band up to 53 kHz.
+ */
+#define DECIM_CUTOFF  0.5
+#define DECIM_TW      0.12
+#define DECIM_ATTEN   60.0  /* Stop band attenuation of the halfband filter. */
+#define DECIM_BLOCK   256   /* Output samples per block in the halfband filter. */
+
+
+/*! \brief Find the integer decimation from quad_rate to audio_rate.
+ *
+ * Returns 1 if the ratio is not an integer, in which case the block
+ * runs at the quadrature rate.
+ */
+static unsigned int calc_decim(float quad_rate, float audio_rate)
+{
+    double ratio;
+
+    if (audio_rate <= 0.0 || audio_rate >= quad_rate)
+        return 1;
+
+    ratio = quad_rate / audio_rate;
+    if (fabs(ratio - floor(ratio + 0.5)) > 1.0e-6)
+        return 1;
+
+    return (unsigned int) floor(ratio + 0.5);
+}
 
 
 rx_demod_fm::rx_demod_fm(float quad_rate, float audio_rate, float max_dev, double tau)
-    : gr::hier_block2 ("rx_demod_fm",
-                      gr::io_signature::make (MIN_IN, MAX_IN, sizeof (gr_complex)),
-                      gr::io_signature::make (MIN_OUT, MAX_OUT, sizeof (float))),
+    : gr::sync_decimator ("rx_demod_fm",
+                          gr::io_signature::make (MIN_IN, MAX_IN, sizeof (gr_complex)),
+                          gr::io_signature::make (MIN_OUT, MAX_OUT, sizeof (float)),
+                          calc_decim(quad_rate, audio_rate)),
     d_quad_rate(quad_rate),
     d_audio_rate(audio_rate),
+    d_decim(calc_decim(quad_rate, audio_rate)),
     d_max_dev(max_dev),
-    d_tau(tau)
+    d_tau(tau),
+    d_last(0.0, 0.0),
+    d_x1(0.0),
+    d_y1(0.0)
 {
-    float gain;
+    std::vector<float> taps;
 
-    /* demodulator gain */
-    gain = d_quad_rate / (2.0 * M_PI * d_max_dev);
+    calculate_iir_taps(tau);
+
+    if (d_decim == 2)
+    {
+        d_taps = rx_hb_decim_cc::halfband_taps(0.5 * (DECIM_CUTOFF - 0.5 * DECIM_TW),
+                                               DECIM_ATTEN);
+        d_hist = d_taps.size() - 1;
+        d_even.assign(d_hist, 0.0);
+        d_odd.assign(d_hist, 0.0);
+    }
+    else if (d_decim > 1)
+    {
+        taps = gr::filter::firdes::low_pass(1.0, d_quad_rate,
+                                            DECIM_CUTOFF * d_quad_rate / d_decim,
+                                            DECIM_TW * d_quad_rate / d_decim);
+        d_taps.assign(taps.rbegin(), taps.rend());
+        d_hist = d_taps.size() - 1;
+        d_demod.assign(d_hist, 0.0);
+    }
+    else
+    {
+        d_hist = 0;
+    }
+}
 
-    //std::cout << "G: " << gain << std::endl;
 
-    /* demodulator */
-    d_quad = gr::analog::quadrature_demod_cf::make(gain);
+rx_demod_fm::~rx_demod_fm ()
+{
+
+}
+
+
+/*! \brief Demodulate, de-emphasize and decimate. */
+int rx_demod_fm::work(int noutput_items,
+                      gr_vector_const_void_star &input_items,
+                      gr_vector_void_star &output_items)
+{
+    const gr_complex *in = (const gr_complex *) input_items[0];
+    float *out = (float *) output_items[0];
+    unsigned int nin = noutput_items * d_decim;
+    double tau = d_tau;
+    float  norm;
+    float *buf;
+    float  b, p, x1, y1, x;
+    unsigned int i;
+
+    if (tau != d_cur_tau)
+        calculate_iir_taps(tau);
+
+    if (d_prod.size() < nin)
+        d_prod.resize(nin);
+
+    if (d_decim == 2)
+    {
+        if (d_demod.size() < nin)
+            d_demod.resize(nin);
+        buf = &d_demod[0];
+    }
+    else if (d_decim > 1)
+    {
+        d_demod.resize(d_hist + nin);
+        buf = &d_demod[d_hist];
+    }
+    else
+    {
+        buf = out;
+    }
+
+    /* phase difference between consecutive samples scaled to max_dev */
+    d_prod[0] = in[0] * conj(d_last);
+    if (nin > 1)
+        volk_32fc_x2_multiply_conjugate_32fc(&d_prod[1], in + 1, in, nin - 1);
+    d_last = in[nin - 1];
+
+    norm = 2.0 * M_PI * d_max_dev / d_quad_rate;
+    volk_32fc_s32f_atan2_32f(buf, &d_prod[0], norm, nin);
+
+    if (d_decim == 2)
+    {
+        load_halfband(buf, noutput_items);
+        filter_halfband(noutput_items, out);
+        return noutput_items;
+    }
 
     /* de-emphasis */
-    d_fftaps.resize(2);
-    d_fbtaps.resize(2);
-    calculate_iir_taps(d_tau);
-    d_deemph = gr::filter::iir_filter_ffd::make(d_fftaps, d_fbtaps);
-
-    /* connect block */
-    connect(self(), 0, d_quad, 0);
-    if (d_tau > 1.0e-9) {
-        connect(d_quad, 0, d_deemph, 0);
-        connect(d_deemph, 0, self(), 0);
+    if (d_cur_tau > 1.0e-9)
+    {
+        b = d_b;
+        p = d_p;
+        x1 = d_x1;
+        y1 = d_y1;
+        for (i = 0; i < nin; i++)
+        {
+            x = buf[i];
+            y1 = b * (x + x1) + p * y1;
+            x1 = x;
+            buf[i] = y1;
+        }
+        d_x1 = x1;
+        d_y1 = y1;
     }
-    else {
-        connect(d_quad, 0, self(), 0);
+
+    /* decimation */
+    if (d_decim > 1)
+    {
+        for (i = 0; i < (unsigned int) noutput_items; i++)
+            volk_32f_x2_dot_prod_32f(&out[i], &d_demod[(i + 1) * d_decim - 1],
+                                     &d_taps[0], d_taps.size());
+
+        memmove(&d_demod[0], &d_demod[nin], d_hist * sizeof(float));
     }
 
+    return noutput_items;
 }
 
 
-rx_demod_fm::~rx_demod_fm ()
+/*! \brief De-emphasize and append to the even and odd phases.
+ *  \param in The demodulated samples.
+ *  \param nout The number of output samples, i.e. half the input samples.
+ */
+void rx_demod_fm::load_halfband(const float *in, unsigned int nout)
 {
+    float  b = d_b, p = d_p, x1 = d_x1, y1 = d_y1;
+    float *ev, *od;
+    unsigned int i;
+
+    d_even.resize(d_hist + nout);
+    d_odd.resize(d_hist + nout);
+    ev = &d_even[d_hist];
+    od = &d_odd[d_hist];
+
+    if (d_cur_tau > 1.0e-9)
+    {
+        for (i = 0; i < nout; i++)
+        {
+            y1 = b * (in[2 * i] + x1) + p * y1;
+            ev[i] = y1;
+            y1 = b * (in[2 * i + 1] + in[2 * i]) + p * y1;
+            od[i] = y1;
+            x1 = in[2 * i + 1];
+        }
+        d_x1 = x1;
+        d_y1 = y1;
+    }
+    else
+    {
+        for (i = 0; i < nout; i++)
+        {
+            ev[i] = in[2 * i];
+            od[i] = in[2 * i + 1];
+        }
+    }
+}
+
+/*! \brief Halfband filter kernel.
+ *  \param y Output for n samples.
+ *  \param ev Even samples.
+ *  \param od Odd samples starting at the center of the first output.
+ *  \param h The non-zero taps except the center.
+ *  \param m Number of taps in h minus one.
+ *  \param n Number of output samples.
+ */
+static inline void hb_filter(float *y, const float *ev, const float *od,
+                             const float *h, unsigned int m, unsigned int n)
+{
+    const float *a, *b;
+    float        g;
+    unsigned int j, k;
+
+    for (j = 0; j < n; j++)
+        y[j] = 0.5f * od[j];
+
+    for (k = 0; k < (m + 1) / 2; k++)
+    {
+        a = ev + k;
+        b = ev + m - k;
+        g = h[k];
+        for (j = 0; j < n; j++)
+            y[j] += g * (a[j] + b[j]);
+    }
+}
 
+/*! \brief Run the halfband decimator on the loaded samples.
+ *  \param nout The number of output samples.
+ *  \param out Output buffer.
+ *
+ * Output j has the center tap on odd[j + (m-1)/2] and the other taps on
+ * even[j] ... even[j+m], like in rx_hb_decim_cc. Full blocks are computed
+ * on the stack with a constant length, which lets the compiler vectorize
+ * the kernel.
+ */
+void rx_demod_fm::filter_halfband(unsigned int nout, float *out)
+{
+    unsigned int m = d_taps.size() - 1;
+    float        y[DECIM_BLOCK];
+    unsigned int j, n;
+
+    for (j = 0; j < nout; j += n)
+    {
+        n = std::min(nout - j, (unsigned int) DECIM_BLOCK);
+        if (n == DECIM_BLOCK)
+            hb_filter(y, &d_even[j], &d_odd[j + (m - 1) / 2], &d_taps[0], m, DECIM_BLOCK);
+        else
+            hb_filter(y, &d_even[j], &d_odd[j + (m - 1) / 2], &d_taps[0], m, n);
+        memcpy(&out[j], y, n * sizeof(float));
+    }
+
+    // keep the history for the next call
+    memmove(&d_even[0], &d_even[nout], d_hist * sizeof(float));
+    memmove(&d_odd[0], &d_odd[nout], d_hist * sizeof(float));
 }
 
 
@@ -89,85 +305,54 @@ rx_demod_fm::~rx_demod_fm ()
  *  \param max_dev The new mximum deviation in Hz
  *
  * The maximum deviation is related to the gain of the
- * quadrature demodulator by:
+ * discriminator by:
  *
  *   gain = quad_rate / (2 * PI * max_dev)
+ *
+ * The new value is picked up by the next call to work().
  */
 void rx_demod_fm::set_max_dev(float max_dev)
 {
-    float gain;
-
     if ((max_dev < 500.0) || (max_dev > d_quad_rate/2.0)) {
         return;
     }
 
     d_max_dev = max_dev;
-
-    gain = d_quad_rate / (2.0 * M_PI * max_dev);
-    d_quad->set_gain(gain);
-
 }
 
 
 /*! \brief Set FM de-emphasis time constant.
- *  \param tau The new time costant.
+ *  \param tau The new time costant (0.0 disables de-emphasis).
  *
- * \bug Assumes that IIR filter has already been constructed so that we
- *      can use the set_taps() method.
+ * The filter taps are recalculated by the next call to work().
  */
 void rx_demod_fm::set_tau(double tau)
 {
-    if (fabs(tau - d_tau) < 1.0e-9) {
-        /* no change */
-        return;
-    }
-
-    if (tau > 1.0e-9) {
-        calculate_iir_taps(tau);
-        d_deemph->set_taps(d_fftaps, d_fbtaps);
-
-        /* check to see if we need to rewire flow graph */
-        if (d_tau <= 1.0e-9) {
-            /* need to put deemph into the flowgraph */
-            lock();
-            disconnect(d_quad, 0, self(), 0);
-            connect(d_quad, 0, d_deemph, 0);
-            connect(d_deemph, 0, self(), 0);
-            unlock();
-        }
-
-        d_tau = tau;
-    }
-    else {
-        //std::cout << "TAU is 0: " << tau << std::endl;
-        /* diable de-emph if conencted */
-        if (d_tau > 1.0e-9) {
-            //std::cout << "  Disable deemph" << std::endl;
-            lock();
-            disconnect(d_quad, 0, d_deemph, 0);
-            disconnect(d_deemph, 0, self(), 0);
-            connect(d_quad, 0, self(), 0);
-            unlock();
-        }
-
-        d_tau = 0.0;
-    }
-
+    d_tau = tau > 1.0e-9 ? tau : 0.0;
 }
 
 
-/*! \brief Calculate taps for FM de-emph IIR filter. */
+/*! \brief Calculate taps for FM de-emph IIR filter.
+ *
+ * Bilinear transform of a single pole low pass filter with the corner
+ * frequency prewarped as in fm_emph.py in gnuradio-core. The filter state
+ * is kept so that changing tau does not cause a click.
+ */
 void rx_demod_fm::calculate_iir_taps(double tau)
 {
-    /* copied from fm_emph.py in gnuradio-core */
     double w_p, w_pp;
 
+    d_cur_tau = tau > 1.0e-9 ? tau : 0.0;
+    if (d_cur_tau == 0.0)
+    {
+        d_x1 = 0.0;
+        d_y1 = 0.0;
+        return;
+    }
+
     w_p = 1.0/tau;
     w_pp = tan(w_p / (d_quad_rate * 2.0)); /* prewarped analog freq */
 
-    d_fftaps[0] = w_pp/(1 + w_pp);
-    d_fftaps[1] = d_fftaps[0];
-
-    d_fbtaps[0] = 1.0;
-    d_fbtaps[1] = (w_pp - 1)/(w_pp + 1);
+    d_b = w_pp/(1 + w_pp);
+    d_p = (1 - w_pp)/(1 + w_pp);
 }
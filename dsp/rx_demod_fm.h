@@ -23,10 +23,9 @@
 #ifndef RX_DEMOD_FM_H
 #define RX_DEMOD_FM_H
 
-#include <gnuradio/hier_block2.h>
-#include <gnuradio/analog/quadrature_demod_cf.h>
-#include <gnuradio/filter/iir_filter_ffd.h>
-#include <gnuradio/filter/pfb_arb_resampler_ccf.h>
+#include <gnuradio/sync_decimator.h>
+#include <gnuradio/gr_complex.h>
+#include <boost/atomic.hpp>
 #include <vector>
 
 
@@ -52,39 +51,69 @@ rx_demod_fm_sptr make_rx_demod_fm(float quad_rate, float audio_rate, float max_d
 /*! \brief FM demodulator.
  *  \ingroup DSP
  *
- * This class implements the FM demodulator using the gr_quadrature_demod block.
- * It also provides de-emphasis with variable time constant (use 0.0 to disable).
+ * This block does the FM discrimination, the de-emphasis and, when the
+ * quadrature rate is an integer multiple of the audio rate, the decimation
+ * to the audio rate in a single pass over each buffer:
  *
+ *  - The phase difference between consecutive samples is the argument of
+ *    x[n]*conj(x[n-1]), which is computed with volk together with the
+ *    polynomial atan2 approximation from volk.
+ *  - De-emphasis is a single pole IIR filter in single precision, applied
+ *    in place on the discriminator output (use tau = 0.0 to disable).
+ *  - Decimation by 2, which takes WFM from 240 to 120 ksps, uses a halfband
+ *    filter whose zero taps are skipped and whose symmetric taps are
+ *    folded. The de-emphasis writes its output directly to the even and
+ *    odd phases of the filter. Other ratios use a low pass FIR filter that
+ *    is only evaluated at the output samples.
+ *
+ * If the rates are not an integer ratio the block runs at the quadrature
+ * rate and the caller has to resample the output.
  */
-class rx_demod_fm : public gr::hier_block2
+class rx_demod_fm : public gr::sync_decimator
 {
+    friend rx_demod_fm_sptr make_rx_demod_fm(float quad_rate, float audio_rate,
+                                             float max_dev, double tau);
+
+protected:
+    rx_demod_fm(float quad_rate, float audio_rate, float max_dev, double tau);
 
 public:
-    rx_demod_fm(float quad_rate=48000.0, float audio_rate=48000.0, float max_dev=5000.0, double tau=50.0e-6); // FIXME: should be private
     ~rx_demod_fm();
 
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items);
+
     void set_max_dev(float max_dev);
     void set_tau(double tau);
 
 private:
-    /* GR blocks */
-    gr::analog::quadrature_demod_cf::sptr   d_quad;      /*! The quadrature demodulator block. */
-    gr::filter::iir_filter_ffd::sptr        d_deemph;    /*! De-emphasis IIR filter. */
-    gr::filter::pfb_arb_resampler_ccf::sptr d_resampler; /*! PFB resampler. */
-    std::vector<float>            d_taps;      /*! Taps for the PFB resampler. */
+    void calculate_iir_taps(double tau);
+    void load_halfband(const float *in, unsigned int nout);
+    void filter_halfband(unsigned int nout, float *out);
 
-    /* other parameters */
     float  d_quad_rate;     /*! Quadrature rate. */
     float  d_audio_rate;    /*! Audio rate. */
-    float  d_max_dev;       /*! Max deviation. */
-    double d_tau;           /*! De-emphasis time constant. */
-
-    /* De-emph IIR filter taps */
-    std::vector<double> d_fftaps;  /*! Feed forward taps. */
-    std::vector<double> d_fbtaps;  /*! Feed back taps. */
-
-    void calculate_iir_taps(double tau);
-
+    unsigned int d_decim;   /*! Decimation from quad_rate to the output rate. */
+
+    boost::atomic<float>  d_max_dev;  /*! Max deviation requested by the user. */
+    boost::atomic<double> d_tau;      /*! De-emphasis time constant requested by the user. */
+    double d_cur_tau;       /*! De-emphasis time constant currently in use. */
+
+    gr_complex d_last;      /*! Last input sample of the previous buffer. */
+
+    /* De-emph IIR filter: y[n] = b*(x[n] + x[n-1]) + p*y[n-1] */
+    float  d_b;             /*! Feed forward tap. */
+    float  d_p;             /*! Pole. */
+    float  d_x1;            /*! Previous input sample. */
+    float  d_y1;            /*! Previous output sample. */
+
+    std::vector<gr_complex> d_prod;   /*! Conjugate products. */
+    std::vector<float>      d_demod;  /*! Filter history followed by new demodulated samples. */
+    std::vector<float>      d_taps;   /*! Decimation filter taps in reverse order, or halfband taps. */
+    unsigned int            d_hist;   /*! Number of history samples in the filter buffers. */
+    std::vector<float>      d_even;   /*! Halfband history followed by new even samples. */
+    std::vector<float>      d_odd;    /*! Halfband history followed by new odd samples. */
 };
 
 
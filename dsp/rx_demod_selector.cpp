@@ -0,0 +1,127 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           http://gqrx.dk/
+ *
+ * Copyright 2011-2014 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <string.h>
+#include <algorithm>
+#include <gnuradio/io_signature.h>
+#include <dsp/rx_demod_selector.h>
+
+
+rx_demod_selector_ff_sptr make_rx_demod_selector_ff(int num_sources,
+                                                    int num_channels,
+                                                    int source,
+                                                    int fade_len)
+{
+    return gnuradio::get_initial_sptr(new rx_demod_selector_ff(num_sources,
+                                                               num_channels,
+                                                               source,
+                                                               fade_len));
+}
+
+rx_demod_selector_ff::rx_demod_selector_ff(int num_sources, int num_channels,
+                                           int source, int fade_len)
+    : gr::sync_block ("rx_demod_selector_ff",
+          gr::io_signature::make(num_sources * num_channels,
+                                 num_sources * num_channels, sizeof(float)),
+          gr::io_signature::make(num_channels, num_channels, sizeof(float))),
+      d_num_sources(num_sources),
+      d_num_channels(num_channels),
+      d_fade_len(fade_len),
+      d_fade_pos(fade_len),
+      d_source(source),
+      d_prev(source),
+      d_new_source(source),
+      d_req_time(0),
+      d_latency(0)
+{
+
+}
+
+rx_demod_selector_ff::~rx_demod_selector_ff()
+{
+
+}
+
+int rx_demod_selector_ff::work(int noutput_items,
+                               gr_vector_const_void_star &input_items,
+                               gr_vector_void_star &output_items)
+{
+    int          new_source = d_new_source;
+    int          ch, i;
+    int          n = 0;
+    float        g, step;
+    const float *a, *b;
+    float       *out;
+
+    // a new request is picked up when the previous fade is complete
+    if (new_source != d_source && d_fade_pos >= d_fade_len)
+    {
+        d_prev = d_source;
+        d_source = new_source;
+        d_fade_pos = 0;
+        d_latency = gr::high_res_timer_now() - d_req_time;
+    }
+
+    if (d_fade_pos < d_fade_len)
+    {
+        n = std::min(noutput_items, d_fade_len - d_fade_pos);
+        step = 1.0f / (float) d_fade_len;
+
+        for (ch = 0; ch < d_num_channels; ch++)
+        {
+            a = (const float *) input_items[d_prev * d_num_channels + ch];
+            b = (const float *) input_items[d_source * d_num_channels + ch];
+            out = (float *) output_items[ch];
+            g = step * (float) d_fade_pos;
+            for (i = 0; i < n; i++)
+            {
+                g += step;
+                out[i] = a[i] + g * (b[i] - a[i]);
+            }
+        }
+        d_fade_pos += n;
+    }
+
+    for (ch = 0; ch < d_num_channels; ch++)
+    {
+        b = (const float *) input_items[d_source * d_num_channels + ch];
+        out = (float *) output_items[ch];
+        memcpy(out + n, b + n, (noutput_items - n) * sizeof(float));
+    }
+
+    return noutput_items;
+}
+
+void rx_demod_selector_ff::set_source(int source)
+{
+    if (source < 0 || source >= d_num_sources || source == d_new_source)
+        return;
+
+    d_latency = 0;
+    d_req_time = gr::high_res_timer_now();
+    d_new_source = source;
+}
+
+double rx_demod_selector_ff::get_switch_latency() const
+{
+    return (double) d_latency / (double) gr::high_res_timer_tps();
+}
@@ -0,0 +1,111 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           http://gqrx.dk/
+ *
+ * Copyright 2011-2014 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef RX_DEMOD_SELECTOR_H
+#define RX_DEMOD_SELECTOR_H
+
+#include <gnuradio/sync_block.h>
+#include <gnuradio/high_res_timer.h>
+#include <boost/atomic.hpp>
+
+
+class rx_demod_selector_ff;
+
+typedef boost::shared_ptr<rx_demod_selector_ff> rx_demod_selector_ff_sptr;
+
+
+/*! \brief Return a shared_ptr to a new instance of rx_demod_selector_ff.
+ *  \param num_sources The number of demodulators connected to the selector.
+ *  \param num_channels The number of audio channels per demodulator.
+ *  \param source The initially selected source.
+ *  \param fade_len The length of the cross fade in samples.
+ */
+rx_demod_selector_ff_sptr make_rx_demod_selector_ff(int num_sources,
+                                                    int num_channels=1,
+                                                    int source=0,
+                                                    int fade_len=256);
+
+
+/*! \brief Select the output of one of several demodulators.
+ *  \ingroup DSP
+ *
+ * All demodulators of a receiver stay connected to this block, which
+ * consumes all of its inputs and copies the selected one to the output.
+ * Input number source * num_channels + channel carries the given channel
+ * of a source.
+ *
+ * A new source is selected with set_source() without locking the flow
+ * graph. The switch takes effect at the start of the next work() call and
+ * is done with a short linear cross fade to avoid clicks. The time from
+ * the set_source() call until the new source starts to appear in the
+ * output is measured and can be read with get_switch_latency().
+ */
+class rx_demod_selector_ff : public gr::sync_block
+{
+    friend rx_demod_selector_ff_sptr make_rx_demod_selector_ff(int num_sources,
+                                                               int num_channels,
+                                                               int source,
+                                                               int fade_len);
+
+protected:
+    rx_demod_selector_ff(int num_sources, int num_channels, int source,
+                         int fade_len);
+
+public:
+    ~rx_demod_selector_ff();
+
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items);
+
+    /*! \brief Select a new source.
+     *  \param source The new source, 0 <= source < num_sources.
+     *
+     * This function may be called while the flow graph is running.
+     */
+    void set_source(int source);
+
+    /*! \brief Get the currently selected source. */
+    int get_source() const { return d_new_source; }
+
+    /*! \brief Get the latency of the last switch in seconds.
+     *  \returns The time between set_source() and the first output sample
+     *           of the new source, or 0 if no switch has been done yet or
+     *           the last switch is still pending.
+     */
+    double get_switch_latency() const;
+
+private:
+    int     d_num_sources;    /*! Number of sources. */
+    int     d_num_channels;   /*! Number of channels per source. */
+    int     d_fade_len;       /*! Length of the cross fade. */
+    int     d_fade_pos;       /*! Position within the cross fade. */
+    int     d_source;         /*! Source currently copied to the output. */
+    int     d_prev;           /*! Source we are fading away from. */
+
+    boost::atomic<int>                      d_new_source; /*! Requested source. */
+    boost::atomic<gr::high_res_timer_type>  d_req_time;   /*! Time of the request. */
+    boost::atomic<gr::high_res_timer_type>  d_latency;    /*! Latency of the last switch. */
+};
+
+
+#endif /* RX_DEMOD_SELECTOR_H */
@@ -21,350 +21,1266 @@
  * Boston, MA 02110-1301, USA.
  */
 #include <math.h>
+#include <string.h>
+#include <algorithm>
 #include <gnuradio/io_signature.h>
 #include <gnuradio/filter/firdes.h>
 #include <gnuradio/gr_complex.h>
 #include <gnuradio/fft/fft.h>
+#include <volk/volk.h>
 #include "dsp/rx_fft.h"
 
 
-rx_fft_c_sptr make_rx_fft_c (unsigned int fftsize, int wintype)
+/*! \brief Create FFT post processor. */
+rx_fft_post::rx_fft_post()
+    : d_mode(FFT_AVG_IIR),
+      d_gain(0.5),
+      d_frames(1),
+      d_reset(true),
+      d_hist_len(1),
+      d_hist_pos(0),
+      d_hist_fill(0),
+      d_line_mode(WF_LINE_AVG),
+      d_line_frames(0)
 {
-    return gnuradio::get_initial_sptr(new rx_fft_c (fftsize, wintype));
 }
 
-/*! \brief Create receiver FFT object.
- *  \param fftsize The FFT size.
- *  \param wintype The window type (see gr::filter::firdes::win_type).
+/*! \brief Set averaging mode (see fft_avg_mode). */
+void rx_fft_post::set_mode(int mode)
+{
+    if ((mode < FFT_AVG_IIR) || (mode > FFT_AVG_MIN_HOLD))
+        mode = FFT_AVG_IIR;
+
+    if (mode != d_mode)
+    {
+        d_mode = mode;
+        d_reset = true;
+    }
+}
+
+/*! \brief Set IIR averaging gain.
+ *  \param gain The averaging gain between 0 and 1 (1 = no averaging).
+ */
+void rx_fft_post::set_gain(float gain)
+{
+    d_gain = std::max(0.f, std::min(gain, 1.f));
+}
+
+/*! \brief Set the number of frames used in linear averaging. */
+void rx_fft_post::set_frames(unsigned int frames)
+{
+    frames = std::max(1u, std::min(frames, (unsigned int)MAX_FFT_AVG_FRAMES));
+
+    if (frames != d_frames)
+    {
+        d_frames = frames;
+        if (d_mode == FFT_AVG_LINEAR)
+            d_reset = true;
+    }
+}
+
+/*! \brief Restart averaging with the next frame. */
+void rx_fft_post::reset(void)
+{
+    d_reset = true;
+}
+
+/*! \brief Set waterfall line mode (see wf_line_mode).
  *
+ * Changing the mode restarts the current line.
  */
-rx_fft_c::rx_fft_c(unsigned int fftsize, int wintype)
-    : gr::sync_block ("rx_fft_c",
-          gr::io_signature::make(1, 1, sizeof(gr_complex)),
-          gr::io_signature::make(0, 0, 0)),
-      d_fftsize(fftsize),
-      d_wintype(-1)
+void rx_fft_post::set_line_mode(int mode)
 {
+    if (mode != WF_LINE_PEAK)
+        mode = WF_LINE_AVG;
 
-    /* create FFT object */
-    d_fft = new gr::fft::fft_complex(d_fftsize, true);
+    if (mode != d_line_mode)
+    {
+        d_line_mode = mode;
+        d_line_frames = 0;
+    }
+}
 
-    /* allocate circular buffer */
-    d_cbuf.set_capacity(d_fftsize);
+/*! \brief Discard the frames collected for the next waterfall line. */
+void rx_fft_post::reset_line(void)
+{
+    d_line_frames = 0;
+}
 
-    /* create FFT window */
-    set_window_type(wintype);
+/*! \brief Number of points in the next waterfall line, 0 if there is none. */
+unsigned int rx_fft_post::line_size(void) const
+{
+    return d_line_frames > 0 ? d_line.size() : 0;
 }
 
-rx_fft_c::~rx_fft_c()
+/*! \brief Get the waterfall line and start a new one.
+ *  \param line Output buffer for line_size() points in dBFS.
+ */
+void rx_fft_post::get_line(float *line)
 {
-    delete d_fft;
+    unsigned int n = line_size();
+    float g = 1.f;
+    unsigned int i;
+
+    if (n == 0)
+        return;
+
+    if (d_line_mode == WF_LINE_AVG)
+        g = 1.f / (float)d_line_frames;
+    for (i = 0; i < n; i++)
+        line[i] = d_line[i] * g + 1.0e-20f;
+
+    volk_32f_log2_32f(line, line, n);
+    volk_32f_s32f_multiply_32f(line, line, 3.01029996f, n);   // 10*log10(2)
+
+    d_line_frames = 0;
 }
 
-/*! \brief Receiver FFT work method.
- *  \param noutput_items
- *  \param input_items
- *  \param output_items
+/*! \brief Combine scaled power with a segment of the waterfall line. */
+static inline void combine_line(float *line, const float *pwr, unsigned int n,
+                                float scale, int mode, bool first)
+{
+    unsigned int i;
+
+    if (first)
+    {
+        for (i = 0; i < n; i++)
+            line[i] = pwr[i] * scale;
+    }
+    else if (mode == WF_LINE_PEAK)
+    {
+        for (i = 0; i < n; i++)
+            line[i] = std::max(line[i], pwr[i] * scale);
+    }
+    else
+    {
+        for (i = 0; i < n; i++)
+            line[i] += pwr[i] * scale;
+    }
+}
+
+/*! \brief Add one frame to the waterfall line.
+ *  \param pwr The |X|^2 of the frame (not shifted).
+ *  \param fftsize The FFT size.
+ *  \param scale Normalization factor, i.e. 1/fftsize^2.
  *
- * This method does nothing except throwing the incoming samples into the
- * circular buffer.
- * FFT is only executed when the GUI asks for new FFT data via get_fft_data().
+ * The frame is shifted and normalized in the same pass.
  */
-int rx_fft_c::work(int noutput_items,
-                   gr_vector_const_void_star &input_items,
-                   gr_vector_void_star &output_items)
+void rx_fft_post::add_line(const float *pwr, unsigned int fftsize, float scale)
 {
-    int i;
-    const gr_complex *in = (const gr_complex*)input_items[0];
-    (void) output_items;
+    unsigned int half = fftsize / 2;
+    bool first;
 
-    /* just throw new samples into the buffer */
-    boost::mutex::scoped_lock lock(d_mutex);
-    for (i = 0; i < noutput_items; i++)
+    if (d_line.size() != fftsize)
     {
-        d_cbuf.push_back(in[i]);
+        d_line.resize(fftsize);
+        d_line_frames = 0;
     }
 
-    return noutput_items;
+    first = (d_line_frames == 0);
+    combine_line(&d_line[0], pwr + half, fftsize - half, scale, d_line_mode, first);
+    combine_line(&d_line[fftsize - half], pwr, half, scale, d_line_mode, first);
+    d_line_frames++;
+}
 
+/*! \brief Process one FFT frame.
+ *  \param fft The raw FFT output.
+ *  \param fftsize The FFT size.
+ *  \param avg Output buffer for the averaged spectrum in dBFS.
+ *  \param pwr Output buffer for the spectrum of this frame in dBFS.
+ *
+ * The spectrum is shifted so that DC is in the middle.
+ */
+void rx_fft_post::process(const gr_complex *fft, unsigned int fftsize, float *avg, float *pwr)
+{
+    unsigned int half = fftsize / 2;
+
+    /* |X|^2 with FFT shift */
+    volk_32fc_magnitude_squared_32f(pwr, fft + half, fftsize - half);
+    volk_32fc_magnitude_squared_32f(pwr + fftsize - half, fft, half);
+
+    finish(fftsize, 1.f / ((float)fftsize * (float)fftsize), avg, pwr);
+}
+
+/*! \brief Process one real FFT frame.
+ *  \param fft The raw output of a real to complex FFT.
+ *  \param fftsize The FFT size.
+ *  \param avg Output buffer for the averaged spectrum in dBFS.
+ *  \param pwr Output buffer for the spectrum of this frame in dBFS.
+ *
+ * Only the fftsize/2 bins from 0 Hz up to half the sample rate are
+ * processed. The levels are the same as for the full spectrum.
+ */
+void rx_fft_post::process_half(const gr_complex *fft, unsigned int fftsize, float *avg, float *pwr)
+{
+    unsigned int half = fftsize / 2;
+
+    volk_32fc_magnitude_squared_32f(pwr, fft, half);
+
+    finish(half, 1.f / ((float)fftsize * (float)fftsize), avg, pwr);
+}
+
+/*! \brief Process accumulated power spectrum.
+ *  \param psd The sum of |X|^2 over a number of FFT frames (not shifted).
+ *  \param fftsize The FFT size.
+ *  \param scale Normalization factor, i.e. 1/(fftsize^2 * frames).
+ *  \param avg Output buffer for the averaged spectrum in dBFS.
+ *  \param pwr Output buffer for the spectrum of this frame in dBFS.
+ */
+void rx_fft_post::process_pwr(const float *psd, unsigned int fftsize, float scale, float *avg, float *pwr)
+{
+    unsigned int half = fftsize / 2;
+
+    memcpy(pwr, psd + half, sizeof(float) * (fftsize - half));
+    memcpy(pwr + fftsize - half, psd, sizeof(float) * half);
+
+    finish(fftsize, scale, avg, pwr);
+}
+
+/*! \brief Convert shifted power spectrum to dBFS and apply averaging. */
+void rx_fft_post::finish(unsigned int fftsize, float scale, float *avg, float *pwr)
+{
+    float *a, *sum, *hist;
+    unsigned int i, k;
+
+    /* normalize and convert to dBFS */
+    for (i = 0; i < fftsize; i++)
+        pwr[i] = pwr[i] * scale + 1.0e-20f;
+    volk_32f_log2_32f(pwr, pwr, fftsize);
+    volk_32f_s32f_multiply_32f(pwr, pwr, 3.01029996f, fftsize);   // 10*log10(2)
+
+    if (d_avg.size() != fftsize)
+    {
+        d_avg.resize(fftsize);
+        d_reset = true;
+    }
+
+    a = &d_avg[0];
+
+    if (d_reset)
+    {
+        d_reset = false;
+        memcpy(a, pwr, sizeof(float) * fftsize);
+
+        if (d_mode == FFT_AVG_LINEAR)
+        {
+            /* limit memory use with large FFTs */
+            d_hist_len = std::max(1u, std::min(d_frames, (unsigned int)(MAX_FFT_AVG_DATA / fftsize)));
+            d_hist.resize(d_hist_len * fftsize);
+            d_sum.assign(pwr, pwr + fftsize);
+            memcpy(&d_hist[0], pwr, sizeof(float) * fftsize);
+            d_hist_pos = 1 % d_hist_len;
+            d_hist_fill = 1;
+        }
+        else
+        {
+            d_hist.clear();
+            d_sum.clear();
+        }
+    }
+    else switch (d_mode)
+    {
+    case FFT_AVG_LINEAR:
+        sum = &d_sum[0];
+        hist = &d_hist[d_hist_pos * fftsize];
+        if (d_hist_fill < d_hist_len)
+        {
+            for (i = 0; i < fftsize; i++)
+                sum[i] += pwr[i];
+            d_hist_fill++;
+        }
+        else
+        {
+            for (i = 0; i < fftsize; i++)
+                sum[i] += pwr[i] - hist[i];
+        }
+        memcpy(hist, pwr, sizeof(float) * fftsize);
+        d_hist_pos = (d_hist_pos + 1) % d_hist_len;
+
+        /* recalculate the sum once per round to avoid accumulating errors */
+        if ((d_hist_pos == 0) && (d_hist_fill == d_hist_len))
+        {
+            memcpy(sum, &d_hist[0], sizeof(float) * fftsize);
+            for (k = 1; k < d_hist_len; k++)
+                volk_32f_x2_add_32f(sum, sum, &d_hist[k * fftsize], fftsize);
+        }
+        volk_32f_s32f_multiply_32f(a, sum, 1.f / (float)d_hist_fill, fftsize);
+        break;
+
+    case FFT_AVG_MAX_HOLD:
+        volk_32f_x2_max_32f(a, a, pwr, fftsize);
+        break;
+
+    case FFT_AVG_MIN_HOLD:
+        volk_32f_x2_min_32f(a, a, pwr, fftsize);
+        break;
+
+    case FFT_AVG_IIR:
+    default:
+        /* gain scales with signal level so that strong signals respond faster */
+        for (i = 0; i < fftsize; i++)
+        {
+            float g = d_gain * (150.f + pwr[i]) / 150.f;
+            a[i] += g * (pwr[i] - a[i]);
+        }
+        break;
+    }
+
+    memcpy(avg, a, sizeof(float) * fftsize);
+}
+
+
+
+/**   rx_fft_base     **/
+
+/*! \brief Create the common part of an FFT block.
+ *  \param name The block name.
+ *  \param fftsize The FFT size.
+ *  \param wintype The window type (see gr::filter::firdes::win_type).
+ *  \param lines Make waterfall lines.
+ *
+ * The FFT size and window type are applied by the derived block.
+ */
+template <class T>
+rx_fft_base<T>::rx_fft_base(const std::string &name, unsigned int fftsize, int wintype, bool lines)
+    : gr::sync_block (name,
+          gr::io_signature::make(1, 1, sizeof(T)),
+          gr::io_signature::make(0, 0, 0)),
+      d_fftsize(0),
+      d_wintype(-1),
+      d_new_fftsize(4096),
+      d_new_wintype(gr::filter::firdes::WIN_HAMMING),
+      d_request(false),
+      d_avg_mode(FFT_AVG_IIR),
+      d_avg_gain(0.5),
+      d_avg_frames(1),
+      d_avg_reset(false),
+      d_line_rate(0),
+      d_line_mode(WF_LINE_AVG),
+      d_ring_pos(0),
+      d_ring_fill(0),
+      d_result(),
+      d_lines(lines),
+      d_new_line_gen(0),
+      d_line_gen(0),
+      d_line_time(0)
+{
+    set_fft_size(fftsize);
+    set_window_type(wintype);
 }
 
 /*! \brief Get FFT data.
- *  \param fftPoints Buffer to copy FFT data
- *  \param fftSize Current FFT size (output).
+ *  \param fftPoints Buffer to copy the averaged spectrum in dBFS (may be NULL).
+ *  \param rawPoints Buffer to copy the latest spectrum in dBFS (may be NULL).
+ *  \param fftSize Number of points in the spectrum (output).
+ *
+ * Returns the latest FFT result and requests a new one from the work thread.
+ * fftSize is set to 0 if no new result has been computed since the
+ * previous call. This function never blocks.
  */
-void rx_fft_c::get_fft_data(std::complex<float>* fftPoints, unsigned int &fftSize)
+template <class T>
+void rx_fft_base<T>::get_fft_data(float *fftPoints, float *rawPoints, unsigned int &fftSize)
 {
-    boost::mutex::scoped_lock lock(d_mutex);
+    d_request = true;
 
-    if (d_cbuf.size() < d_fftsize)
+    if (!d_result.fetch())
     {
-        // not enough samples in the buffer
+        // no new FFT data yet
         fftSize = 0;
 
         return;
     }
 
-    /* perform FFT */
-    do_fft(d_cbuf.linearize(), d_cbuf.size());  // FIXME: array_one() and two() may be faster
-    //d_cbuf.clear();
-
-    /* get FFT data */
-    memcpy(fftPoints, d_fft->get_outbuf(), sizeof(gr_complex)*d_fftsize);
-    fftSize = d_fftsize;
+    fftSize = d_result.front_size() / 2;
+    if (fftPoints)
+        memcpy(fftPoints, d_result.front(), sizeof(float)*fftSize);
+    if (rawPoints)
+        memcpy(rawPoints, d_result.front() + fftSize, sizeof(float)*fftSize);
 }
 
-/*! \brief Compute FFT on the available input data.
- *  \param data_in The data to compute FFT on.
- *  \param size The size of data_in.
+/*! \brief Get the oldest queued waterfall line.
+ *  \param linePoints Buffer to copy the line in dBFS.
+ *  \param lineSize Number of points in the line (output).
+ *
+ * lineSize is set to 0 if there are no more lines, so the GUI calls this
+ * until it gets 0 to take all lines made since its previous update. The
+ * queue is bounded; new lines are dropped while the GUI does not keep up.
+ * Lines made before the latest change of d_new_line_gen are skipped.
  *
- * Note that this function does not lock the mutex since the caller, get_fft_data()
- * has alrady locked it.
+ * The queue lock is only held to move buffers, never while copying.
  */
-void rx_fft_c::do_fft(const gr_complex *data_in, unsigned int size)
+template <class T>
+void rx_fft_base<T>::get_line_data(float *linePoints, unsigned int &lineSize)
 {
-    /* apply window, if any */
-    if (d_window.size())
+    unsigned int gen = d_new_line_gen.load();
+
     {
-        gr_complex *dst = d_fft->get_inbuf();
-        for (unsigned int i = 0; i < size; i++)
-            dst[i] = data_in[i] * d_window[i];
+        boost::mutex::scoped_lock lock(d_line_mutex);
+
+        while (!d_line_queue.empty() && (d_line_queue.front().gen != gen))
+            d_line_queue.pop_front();
+
+        if (d_line_queue.empty())
+        {
+            lineSize = 0;
+            return;
+        }
+
+        /* leave the previous buffer for the work thread to reuse */
+        d_line_spare.swap(d_line_front);
+        d_line_front.swap(d_line_queue.front().data);
+        d_line_queue.pop_front();
     }
-    else
+
+    lineSize = d_line_front.size();
+    memcpy(linePoints, &d_line_front[0], sizeof(float)*lineSize);
+}
+
+/*! \brief Start using a new FFT size.
+ *
+ * Clears the ring buffer and forces a new window. Called from the work
+ * thread when the derived block has a new FFT object.
+ */
+template <class T>
+void rx_fft_base<T>::reset_ring(unsigned int fftsize)
+{
+    d_fftsize = fftsize;
+
+    /* clear and resize ring buffer */
+    d_ring.assign(d_fftsize, T(0));
+    d_ring_pos = 0;
+    d_ring_fill = 0;
+
+    /* force new window */
+    d_wintype = -1;
+}
+
+/*! \brief Apply window type requested by the GUI. */
+template <class T>
+void rx_fft_base<T>::apply_window_type(void)
+{
+    int wintype = d_new_wintype.load();
+
+    if (wintype != d_wintype)
     {
-        memcpy(d_fft->get_inbuf(), data_in, sizeof(gr_complex)*size);
+        d_wintype = wintype;
+        d_window = gr::filter::firdes::window((gr::filter::firdes::win_type)d_wintype, d_fftsize, 6.76);
     }
+}
 
-    /* compute FFT */
-    d_fft->execute();
+/*! \brief Apply averaging settings requested by the GUI. */
+template <class T>
+void rx_fft_base<T>::apply_avg_settings(void)
+{
+    d_post.set_mode(d_avg_mode.load());
+    d_post.set_gain(d_avg_gain.load());
+    d_post.set_frames(d_avg_frames.load());
+    if (d_avg_reset.exchange(false))
+        d_post.reset();
 }
 
-/*! \brief Set new FFT size. */
-void rx_fft_c::set_fft_size(unsigned int fftsize)
+/*! \brief Check whether the next waterfall line is due.
+ *  \param update True when called for a frame passed to the GUI.
+ *
+ * Lines are due every 1/rate seconds on average; with rate 0 every frame
+ * passed to the GUI makes a line. Always false for blocks made without
+ * lines.
+ */
+template <class T>
+bool rx_fft_base<T>::line_due(bool update)
 {
-    if (fftsize != d_fftsize)
-    {
-        boost::mutex::scoped_lock lock(d_mutex);
+    gr::high_res_timer_type now;
+    gr::high_res_timer_type interval;
+    float rate = d_line_rate.load();
 
-        d_fftsize = fftsize;
+    if (!d_lines)
+        return false;
 
-        /* clear and resize circular buffer */
-        d_cbuf.clear();
-        d_cbuf.set_capacity(d_fftsize);
+    if (rate <= 0.f)
+        return update;
 
-        /* reset window */
-        int wintype = d_wintype; // FIXME: would be nicer with a window_reset()
-        d_wintype = -1;
-        set_window_type(wintype);
+    now = gr::high_res_timer_now();
+    interval = (gr::high_res_timer_type)(gr::high_res_timer_tps() / rate);
 
-        /* reset FFT object (also reset FFTW plan) */
-        delete d_fft;
-        d_fft = new gr::fft::fft_complex (d_fftsize, true);
+    /* start over after a rate change to a faster rate */
+    if (d_line_time > now + interval)
+        d_line_time = now;
+
+    return now >= d_line_time;
+}
+
+/*! \brief Queue the waterfall line for the GUI.
+ *
+ * Called when line_due() says so. Does nothing if no frames have been
+ * added to the line since the previous one.
+ */
+template <class T>
+void rx_fft_base<T>::publish_line(void)
+{
+    gr::high_res_timer_type now;
+    gr::high_res_timer_type interval;
+    float rate = d_line_rate.load();
+    unsigned int n = d_post.line_size();
+    unsigned int max_lines;
+
+    if (n == 0)
+        return;
+
+    if (rate > 0.f)
+    {
+        now = gr::high_res_timer_now();
+        interval = (gr::high_res_timer_type)(gr::high_res_timer_tps() / rate);
+
+        /* keep a steady rate, but do not catch up after a stall */
+        d_line_time += interval;
+        if (d_line_time <= now)
+            d_line_time = now + interval;
     }
 
+    d_line_back.resize(n);
+    d_post.get_line(&d_line_back[0]);
+
+    /* limit memory use with large FFTs */
+    max_lines = std::max(2u, std::min((unsigned int)MAX_WF_LINES, (unsigned int)(MAX_WF_LINE_DATA / n)));
+
+    boost::mutex::scoped_lock lock(d_line_mutex);
+
+    if (d_line_queue.size() >= max_lines)
+        return;
+
+    d_line_queue.push_back(wf_line());
+    d_line_queue.back().gen = d_line_gen;
+    d_line_queue.back().data.swap(d_line_back);
+    d_line_back.swap(d_line_spare);
 }
 
-/*! \brief Get currently used FFT size. */
-unsigned int rx_fft_c::get_fft_size()
+/*! \brief Copy samples into the ring buffer.
+ *  \param in The input samples.
+ *  \param n The number of samples, at most d_fftsize.
+ */
+template <class T>
+void rx_fft_base<T>::ring_write(const T *in, unsigned int n)
 {
-    return d_fftsize;
+    unsigned int n1;
+
+    /* copy into ring buffer, wrapping around at the end */
+    n1 = std::min(n, d_fftsize - d_ring_pos);
+    memcpy(&d_ring[d_ring_pos], in, sizeof(T)*n1);
+    memcpy(&d_ring[0], in + n1, sizeof(T)*(n - n1));
+    d_ring_pos = (d_ring_pos + n) % d_fftsize;
+    d_ring_fill = std::min(d_ring_fill + n, d_fftsize);
 }
 
-/*! \brief Set new window type. */
-void rx_fft_c::set_window_type(int wintype)
+/*! \brief Keep the latest samples for a snapshot FFT.
+ *  \param in The input samples.
+ *  \param n The number of input samples.
+ *  \returns true if the GUI has asked for new data and the ring is full.
+ */
+template <class T>
+bool rx_fft_base<T>::snapshot(const T *in, unsigned int n)
 {
-    if (wintype == d_wintype)
+    /* only the latest d_fftsize samples are needed */
+    if (n > d_fftsize)
     {
-        /* nothing to do */
-        return;
+        in += n - d_fftsize;
+        n = d_fftsize;
     }
 
-    d_wintype = wintype;
+    ring_write(in, n);
+
+    return (d_ring_fill == d_fftsize) && d_request.exchange(false);
+}
+
+/*! \brief Window the ring buffer into the FFT input buffer.
+ *
+ * The oldest sample is at d_ring_pos so the ring is windowed in two
+ * segments.
+ */
+template <class T>
+void rx_fft_base<T>::window_ring(T *dst)
+{
+    const T *src = &d_ring[0];
+    const float *win = &d_window[0];
+    unsigned int n1 = d_fftsize - d_ring_pos;
+    unsigned int i;
 
-    if ((d_wintype < gr::filter::firdes::WIN_HAMMING) || (d_wintype > gr::filter::firdes::WIN_BLACKMAN_hARRIS))
+    for (i = 0; i < n1; i++)
+        dst[i] = src[d_ring_pos + i] * win[i];
+    for (i = 0; i < d_ring_pos; i++)
+        dst[n1 + i] = src[i] * win[n1 + i];
+}
+
+/*! \brief Set new FFT size.
+ *
+ * The new size takes effect in the work thread. rx_fft_c plans large
+ * FFTs in the background first.
+ */
+template <class T>
+void rx_fft_base<T>::set_fft_size(unsigned int fftsize)
+{
+    if ((fftsize > 0) && (fftsize <= MAX_FFT_SIZE))
+        d_new_fftsize = fftsize;
+}
+
+/*! \brief Get currently used FFT size. */
+template <class T>
+unsigned int rx_fft_base<T>::get_fft_size()
+{
+    return d_new_fftsize;
+}
+
+/*! \brief Set FFT averaging.
+ *  \param mode The averaging mode (see fft_avg_mode).
+ *  \param gain The IIR averaging gain between 0 and 1 (1 = no averaging).
+ *  \param frames The number of frames used in linear averaging.
+ *
+ * Changing the mode or the number of frames restarts averaging.
+ */
+template <class T>
+void rx_fft_base<T>::set_fft_avg(int mode, float gain, unsigned int frames)
+{
+    d_avg_gain = gain;
+    d_avg_frames = frames;
+    d_avg_mode = mode;
+}
+
+/*! \brief Restart averaging, e.g. to clear max or min hold. */
+template <class T>
+void rx_fft_base<T>::reset_fft_avg(void)
+{
+    d_avg_reset = true;
+}
+
+/*! \brief Set the waterfall line rate.
+ *  \param rate Lines per second, 0 for one line per frame passed to the GUI.
+ *  \param mode How frames are combined into lines (see wf_line_mode).
+ */
+template <class T>
+void rx_fft_base<T>::set_line_rate(float rate, int mode)
+{
+    d_line_rate = std::max(rate, 0.f);
+    d_line_mode = mode;
+}
+
+/*! \brief Set new window type. */
+template <class T>
+void rx_fft_base<T>::set_window_type(int wintype)
+{
+    if ((wintype < gr::filter::firdes::WIN_HAMMING) || (wintype > gr::filter::firdes::WIN_BLACKMAN_hARRIS))
     {
-        d_wintype = gr::filter::firdes::WIN_HAMMING;
+        wintype = gr::filter::firdes::WIN_HAMMING;
     }
 
-    d_window.clear();
-    d_window = gr::filter::firdes::window((gr::filter::firdes::win_type)d_wintype, d_fftsize, 6.76);
+    d_new_wintype = wintype;
 }
 
 /*! \brief Get currently used window type. */
-int rx_fft_c::get_window_type()
+template <class T>
+int rx_fft_base<T>::get_window_type()
 {
-    return d_wintype;
+    return d_new_wintype;
 }
 
+template class rx_fft_base<gr_complex>;
+template class rx_fft_base<float>;
 
-/**   rx_fft_f     **/
 
-rx_fft_f_sptr make_rx_fft_f(unsigned int fftsize, int wintype)
+/**   rx_fft_c     **/
+
+rx_fft_c_sptr make_rx_fft_c (unsigned int fftsize, int wintype, bool lines)
 {
-    return gnuradio::get_initial_sptr(new rx_fft_f (fftsize, wintype));
+    return gnuradio::get_initial_sptr(new rx_fft_c (fftsize, wintype, lines));
 }
 
 /*! \brief Create receiver FFT object.
  *  \param fftsize The FFT size.
  *  \param wintype The window type (see gr::filter::firdes::win_type).
+ *  \param lines Make waterfall lines.
  *
  */
-rx_fft_f::rx_fft_f(unsigned int fftsize, int wintype)
-    : gr::sync_block ("rx_fft_f",
-          gr::io_signature::make(1, 1, sizeof(float)),
-          gr::io_signature::make(0, 0, 0)),
-      d_fftsize(fftsize),
-      d_wintype(-1)
+rx_fft_c::rx_fft_c(unsigned int fftsize, int wintype, bool lines)
+    : rx_fft_base<gr_complex>("rx_fft_c", fftsize, wintype, lines),
+      d_new_continuous(false),
+      d_new_overlap(0.5),
+      d_budget(0.5),
+      d_dropped(0),
+      d_new_zoom_center(0.0),
+      d_zoom_pending(false),
+      d_zoom_rate(0.0),
+      d_zoom_span(0.0),
+      d_planned(0),
+      d_planning(false),
+      d_plan_size(0),
+      d_fft(0),
+      d_continuous(false),
+      d_overlap(0.5),
+      d_hop(0),
+      d_since(0),
+      d_psd_frames(0),
+      d_last_work(0),
+      d_credit(0.0)
 {
-
-    /* create FFT object */
-    d_fft = new gr::fft::fft_complex(d_fftsize, true);
-
-    /* allocate circular buffer */
-    d_cbuf.set_capacity(d_fftsize);
-
-    /* create FFT window */
-    set_window_type(wintype);
+    /* create FFT object, window and ring buffer */
+    apply_settings();
 }
 
-rx_fft_f::~rx_fft_f()
+rx_fft_c::~rx_fft_c()
 {
+    if (d_planning)
+        d_planner.join();
+    delete d_planned.load();
     delete d_fft;
 }
 
-/*! \brief Audio FFT work method.
+/*! \brief Receiver FFT work method.
  *  \param noutput_items
  *  \param input_items
  *  \param output_items
  *
- * This method does nothing except throwing the incoming samples into the
- * circular buffer.
- * FFT is only executed when the GUI asks for new FFT data via get_fft_data().
+ * In snapshot mode this method copies the incoming samples into the ring
+ * buffer and, if the GUI has asked for new data since the last FFT,
+ * computes the FFT on the latest fftsize samples. Otherwise it makes the
+ * waterfall line if one is due. In continuous mode all samples are
+ * processed by work_continuous(). In zoom mode the samples are decimated
+ * first.
  */
-int rx_fft_f::work(int noutput_items,
+int rx_fft_c::work(int noutput_items,
                    gr_vector_const_void_star &input_items,
                    gr_vector_void_star &output_items)
 {
-    int i;
-    const float *in = (const float*)input_items[0];
+    const gr_complex *in = (const gr_complex*)input_items[0];
+    unsigned int n = noutput_items;
     (void) output_items;
 
-    /* just throw new samples into the buffer */
-    boost::mutex::scoped_lock lock(d_mutex);
-    for (i = 0; i < noutput_items; i++)
+    apply_settings();
+
+    if (d_zoom)
     {
-        d_cbuf.push_back(in[i]);
+        n = zoom(in, n);
+        if (n > 0)
+            in = &d_zoom_out[0];
     }
 
+    if (d_continuous)
+        work_continuous(in, n);
+    else if (snapshot(in, n))
+        do_fft();
+    else if (line_due(false))
+        make_line();
+
     return noutput_items;
+
 }
 
-/*! \brief Get FFT data.
- *  \param fftPoints Buffer to copy FFT data
- *  \param fftSize Current FFT size (output).
+/*! \brief Process input samples in continuous mode.
+ *  \param in The input samples.
+ *  \param n The number of input samples.
+ *
+ * Computes an FFT every d_hop samples and accumulates the power, which is
+ * also added to the waterfall line. FFTs are only computed while there is
+ * time left in the budget, which grows with the wall clock time between
+ * work() calls.
  */
-void rx_fft_f::get_fft_data(std::complex<float>* fftPoints, unsigned int &fftSize)
+void rx_fft_c::work_continuous(const gr_complex *in, unsigned int n)
 {
-    boost::mutex::scoped_lock lock(d_mutex);
+    gr::high_res_timer_type now = gr::high_res_timer_now();
+    gr::high_res_timer_type t0;
+    double max_credit = 0.1 * gr::high_res_timer_tps();
+    unsigned int m;
+
+    if (d_last_work)
+        d_credit = std::min(d_credit + d_budget * (double)(now - d_last_work), max_credit);
+    d_last_work = now;
 
-    if (d_cbuf.size() < d_fftsize)
+    while (n > 0)
     {
-        // not enough samples in the buffer
-        fftSize = 0;
+        m = std::min(n, d_hop - d_since);
+        ring_write(in, m);
+        in += m;
+        n -= m;
+        d_since += m;
 
-        return;
+        if (d_since < d_hop)
+            break;
+
+        d_since = 0;
+
+        if (d_ring_fill < d_fftsize)
+            continue;
+
+        if (d_credit <= 0.0)
+        {
+            d_dropped++;
+            continue;
+        }
+
+        t0 = gr::high_res_timer_now();
+
+        window_fft();
+        volk_32fc_magnitude_squared_32f(&d_tmp[0], d_fft->get_outbuf(), d_fftsize);
+        volk_32f_x2_add_32f(&d_psd[0], &d_psd[0], &d_tmp[0], d_fftsize);
+        d_psd_frames++;
+        if (d_lines)
+            d_post.add_line(&d_tmp[0], d_fftsize, 1.f / ((float)d_fftsize * (float)d_fftsize));
+
+        d_credit -= (double)(gr::high_res_timer_now() - t0);
     }
 
-    /* perform FFT */
-    do_fft(d_cbuf.linearize(), d_cbuf.size());  // FIXME: array_one() and two() may be faster
-    //d_cbuf.clear();
+    if ((d_psd_frames > 0) && d_request.exchange(false))
+        publish_psd();
+    else if (line_due(false))
+        publish_line();
+}
+
+/*! \brief Apply FFT size, window type and mode requested by the GUI.
+ *
+ * Called from the work thread, which is the only thread touching the FFT
+ * object, the window and the ring buffer.
+ */
+void rx_fft_c::apply_settings(void)
+{
+    unsigned int fftsize = d_new_fftsize.load();
+    bool continuous = d_new_continuous.load();
+    float overlap = d_new_overlap.load();
+    gr::fft::fft_complex *fft;
 
-    /* get FFT data */
-    memcpy(fftPoints, d_fft->get_outbuf(), sizeof(gr_complex)*d_fftsize);
-    fftSize = d_fftsize;
+    /* use new FFT object once the planner thread is done */
+    if (d_planning && (fft = d_planned.exchange(0)))
+    {
+        d_planner.join();
+        d_planning = false;
+        set_fft(fft, d_plan_size);
+    }
+
+    if ((fftsize != d_fftsize) && !d_planning)
+    {
+        if (!d_fft)
+        {
+            set_fft(create_fft(fftsize), fftsize);
+        }
+        else
+        {
+            /* Planning large FFTs can take seconds, so it is done in a
+             * separate thread while we keep using the current FFT. */
+            d_planning = true;
+            d_plan_size = fftsize;
+            d_planner = boost::thread(&rx_fft_c::plan_fft, this, fftsize);
+        }
+    }
+
+    apply_window_type();
+    apply_zoom();
+    if (d_lines)
+        d_post.set_line_mode(d_line_mode.load());
+
+    if ((continuous != d_continuous) || (overlap != d_overlap) || (d_hop == 0))
+    {
+        if (continuous && !d_continuous)
+        {
+            /* start with a full budget */
+            d_last_work = 0;
+            d_credit = 0.1 * gr::high_res_timer_tps();
+        }
+
+        d_continuous = continuous;
+        d_overlap = overlap;
+        d_hop = d_fftsize - (unsigned int)(d_overlap * d_fftsize);
+        d_since = 0;
+        d_psd.assign(d_fftsize, 0.0);
+        d_tmp.resize(d_fftsize);
+        d_psd_frames = 0;
+    }
 }
 
-/*! \brief Compute FFT on the available input data.
- *  \param data_in The data to compute FFT on.
- *  \param size The size of data_in.
+/*! \brief Apply zoom settings requested by the GUI.
  *
- * Note that this function does not lock the mutex since the caller, get_fft_data()
- * has alrady locked it.
+ * set_zoom() starts a new line generation for each change, so the lock is
+ * only taken when there is one. A decimator made by set_zoom() for a new
+ * rate replaces the current one and the old samples are discarded. Moving
+ * the zoomed span just retunes the current decimator, so the display keeps
+ * running while the span is dragged.
+ *
+ * Frames collected for the current waterfall line were made with the old
+ * settings, so the line is started over.
  */
-void rx_fft_f::do_fft(const float *data_in, unsigned int size)
+void rx_fft_c::apply_zoom(void)
 {
-    gr_complex *dst = d_fft->get_inbuf();
-    unsigned int i;
+    if (d_new_line_gen.load() == d_line_gen)
+        return;
 
-    /* apply window, and convert to complex */
-    if (d_window.size())
+    boost::mutex::scoped_lock lock(d_zoom_mutex);
+
+    if (d_zoom_pending)
     {
-        for (i = 0; i < size; i++)
-            dst[i] = data_in[i] * d_window[i];
+        d_zoom_pending = false;
+        d_zoom.swap(d_new_zoom);
+        d_new_zoom.reset();
+        d_zoom_in.clear();
+        d_ring_fill = 0;
+        d_hop = 0;
     }
-    else
+
+    if (d_zoom && (d_new_zoom_center != d_zoom->offset()))
+        d_zoom->set_offset(d_new_zoom_center);
+
+    d_line_gen = d_new_line_gen.load();
+    d_post.reset_line();
+}
+
+/*! \brief Translate and decimate input samples in zoom mode.
+ *  \param in The input samples.
+ *  \param n The number of input samples.
+ *  \returns The number of decimated samples in d_zoom_out.
+ *
+ * The decimator needs a multiple of its decimation at a time. Samples
+ * left over from the previous call are topped up to one decimation from
+ * the new input, the rest of the input is decimated directly and the new
+ * remainder is kept in d_zoom_in until the next call.
+ */
+unsigned int rx_fft_c::zoom(const gr_complex *in, unsigned int n)
+{
+    unsigned int decim = d_zoom->decimation();
+    unsigned int nout = 0;
+    unsigned int m;
+
+    if (d_zoom_out.size() < (d_zoom_in.size() + n) / decim)
+        d_zoom_out.resize((d_zoom_in.size() + n) / decim);
+
+    if (!d_zoom_in.empty())
     {
-        for (i = 0; i < size; i++)
-            dst[i] = data_in[i];
+        m = std::min(n, decim - (unsigned int) d_zoom_in.size());
+        d_zoom_in.insert(d_zoom_in.end(), in, in + m);
+        in += m;
+        n -= m;
+
+        if (d_zoom_in.size() < decim)
+            return 0;
+
+        decimate(&d_zoom_in[0], 1, &d_zoom_out[0]);
+        d_zoom_in.clear();
+        nout = 1;
     }
 
-    /* compute FFT */
+    m = n / decim;
+    if (m > 0)
+        decimate(in, m, &d_zoom_out[nout]);
+    nout += m;
+
+    d_zoom_in.assign(in + m * decim, in + n);
+
+    return nout;
+}
+
+/*! \brief Run the zoom decimator.
+ *  \param in Input samples, nout times the decimation.
+ *  \param nout The number of output samples.
+ *  \param out Output buffer.
+ */
+void rx_fft_c::decimate(const gr_complex *in, unsigned int nout, gr_complex *out)
+{
+    gr_vector_const_void_star zin(1, in);
+    gr_vector_void_star zout(1, out);
+
+    d_zoom->work(nout, zin, zout);
+}
+
+/*! \brief Create FFT object.
+ *  \param fftsize The FFT size.
+ *
+ * Large FFTs use multi-threaded FFTW plans. FFTW wisdom is loaded and
+ * saved by gr::fft so a size is only measured once.
+ */
+gr::fft::fft_complex *rx_fft_c::create_fft(unsigned int fftsize)
+{
+    int nthreads = 1;
+
+    if (fftsize >= FFT_THREADS_SIZE)
+        nthreads = std::max(1, std::min((int)boost::thread::hardware_concurrency(), FFT_MAX_THREADS));
+
+    return new gr::fft::fft_complex(fftsize, true, nthreads);
+}
+
+/*! \brief Planner thread function. */
+void rx_fft_c::plan_fft(unsigned int fftsize)
+{
+    d_planned = create_fft(fftsize);
+}
+
+/*! \brief Start using a new FFT object.
+ *  \param fft The new FFT object.
+ *  \param fftsize The size of the new FFT.
+ */
+void rx_fft_c::set_fft(gr::fft::fft_complex *fft, unsigned int fftsize)
+{
+    delete d_fft;
+    d_fft = fft;
+
+    /* clear ring buffer, force new window and reset accumulated power */
+    reset_ring(fftsize);
+    d_hop = 0;
+}
+
+/*! \brief Compute FFT on the ring buffer.
+ *
+ * The ring is windowed directly into the FFT input buffer.
+ */
+void rx_fft_c::window_fft(void)
+{
+    window_ring(d_fft->get_inbuf());
     d_fft->execute();
 }
 
+/*! \brief Compute FFT on the ring buffer and publish the result. */
+void rx_fft_c::do_fft(void)
+{
+    float *buf = d_result.back(2 * d_fftsize);
+
+    window_fft();
+
+    /* power spectrum and averaging */
+    apply_avg_settings();
+    d_post.process(d_fft->get_outbuf(), d_fftsize, buf, buf + d_fftsize);
+    d_result.publish(2 * d_fftsize);
+
+    if (d_lines)
+        add_frame_to_line();
+    if (line_due(true))
+        publish_line();
+}
 
-/*! \brief Set new FFT size. */
-void rx_fft_f::set_fft_size(unsigned int fftsize)
+/*! \brief Add the power of the current FFT output to the waterfall line. */
+void rx_fft_c::add_frame_to_line(void)
 {
-    if (fftsize != d_fftsize)
+    volk_32fc_magnitude_squared_32f(&d_tmp[0], d_fft->get_outbuf(), d_fftsize);
+    d_post.add_line(&d_tmp[0], d_fftsize, 1.f / ((float)d_fftsize * (float)d_fftsize));
+}
+
+/*! \brief Make a waterfall line between FFT updates in snapshot mode.
+ *
+ * If the GUI has not asked for FFT data since the previous line, a frame
+ * is computed for the line here, so the line rate does not depend on the
+ * GUI update rate.
+ */
+void rx_fft_c::make_line(void)
+{
+    if ((d_post.line_size() == 0) && (d_ring_fill == d_fftsize))
     {
-        boost::mutex::scoped_lock lock(d_mutex);
+        window_fft();
+        add_frame_to_line();
+    }
 
-        d_fftsize = fftsize;
+    publish_line();
+}
 
-        /* clear and resize circular buffer */
-        d_cbuf.clear();
-        d_cbuf.set_capacity(d_fftsize);
+/*! \brief Publish the mean of the accumulated power spectra. */
+void rx_fft_c::publish_psd(void)
+{
+    float scale = 1.f / ((float)d_fftsize * (float)d_fftsize * (float)d_psd_frames);
+    float *buf = d_result.back(2 * d_fftsize);
 
-        /* reset window */
-        int wintype = d_wintype; // FIXME: would be nicer with a window_reset()
-        d_wintype = -1;
-        set_window_type(wintype);
+    apply_avg_settings();
+    d_post.process_pwr(&d_psd[0], d_fftsize, scale, buf, buf + d_fftsize);
+    d_result.publish(2 * d_fftsize);
+    if (line_due(true))
+        publish_line();
 
-        /* reset FFT object (also reset FFTW plan) */
-        delete d_fft;
-        d_fft = new gr::fft::fft_complex(d_fftsize, true);
-    }
+    std::fill(d_psd.begin(), d_psd.end(), 0.f);
+    d_psd_frames = 0;
 }
 
-/*! \brief Get currently used FFT size. */
-unsigned int rx_fft_f::get_fft_size()
+/*! \brief Enable or disable continuous (Welch) mode.
+ *
+ * In continuous mode FFTs are computed on all input samples with the
+ * overlap set by set_overlap() and get_fft_data() returns the mean power
+ * spectrum since the previous call.
+ */
+void rx_fft_c::set_continuous(bool enable)
 {
-    return d_fftsize;
+    d_new_continuous = enable;
 }
 
-/*! \brief Set new window type. */
-void rx_fft_f::set_window_type(int wintype)
+/*! \brief Set overlap between FFT frames in continuous mode.
+ *  \param overlap The overlap between 0 and MAX_FFT_OVERLAP.
+ */
+void rx_fft_c::set_overlap(float overlap)
 {
-    if (wintype == d_wintype)
-    {
-        /* nothing to do */
+    d_new_overlap = std::max(0.f, std::min(overlap, (float)MAX_FFT_OVERLAP));
+}
+
+/*! \brief Set zoom FFT parameters.
+ *  \param sample_rate The input sample rate.
+ *  \param center The center of the zoomed span relative to the input.
+ *  \param span The zoomed span.
+ *
+ * Zoom mode is used when the span is small enough for at least one
+ * decimation stage, see zoom_rate(). Use span = 0 to disable it.
+ *
+ * A new input rate or zoom rate needs a new decimator, which is made here
+ * and handed over to the work thread. A new center is applied by the work
+ * thread to the decimator in use.
+ *
+ * Every change that alters the FFT data starts a new line generation, so
+ * that waterfall lines made before the change are dropped instead of being
+ * plotted with the new zoom, see get_line_data(). The GUI should therefore
+ * take the queued lines before it calls this.
+ */
+void rx_fft_c::set_zoom(double sample_rate, double center, double span)
+{
+    boost::mutex::scoped_lock lock(d_zoom_mutex);
+    double old_rate = zoom_rate(d_zoom_rate, d_zoom_span);
+    double out_rate = zoom_rate(sample_rate, span);
+    bool new_zoom = (sample_rate != d_zoom_rate) || (out_rate != old_rate);
+
+    d_zoom_rate = sample_rate;
+    d_zoom_span = span;
+
+    /* without zoom the FFT data does not depend on the center */
+    if (!new_zoom && ((out_rate == 0.0) || (center == d_new_zoom_center)))
         return;
+
+    d_new_zoom_center = center;
+    if (new_zoom)
+    {
+        /* the decimator is made here so that work() does not have to */
+        if (out_rate > 0.0)
+            d_new_zoom = make_rx_hb_decim_cc(sample_rate,
+                                             rx_hb_decim_cc::calc_stages(sample_rate, out_rate),
+                                             0.4 * out_rate, center);
+        else
+            d_new_zoom.reset();
+
+        d_zoom_pending = true;
     }
 
-    d_wintype = wintype;
+    d_new_line_gen++;
+}
+
+/*! \brief Get the sample rate of the zoom FFT.
+ *  \param sample_rate The input sample rate.
+ *  \param span The zoomed span.
+ *  \returns The rate the input is decimated to, or 0 if zoom mode is not
+ *           used for this span.
+ *
+ * The FFT data covers this rate around the zoom center, which is at least
+ * FFT_ZOOM_MARGIN times the span so that the decimators keep the whole span
+ * free from aliases.
+ */
+double rx_fft_c::zoom_rate(double sample_rate, double span)
+{
+    unsigned int stages;
+
+    if ((sample_rate <= 0.0) || (span <= 0.0))
+        return 0.0;
+
+    stages = rx_hb_decim_cc::calc_stages(sample_rate, FFT_ZOOM_MARGIN * span);
+    if (stages == 0)
+        return 0.0;
+
+    return sample_rate / (double)(1 << stages);
+}
+
+/*! \brief Set time budget for continuous mode.
+ *  \param budget The fraction of wall clock time that may be spent on FFTs.
+ *
+ * Frames that do not fit in the budget are dropped.
+ */
+void rx_fft_c::set_time_budget(float budget)
+{
+    d_budget = std::max(0.01f, std::min(budget, 1.f));
+}
+
+/*! \brief Get the number of frames dropped in continuous mode. */
+unsigned long rx_fft_c::get_dropped_frames(void)
+{
+    return d_dropped;
+}
+
+/**   rx_fft_f     **/
+
+rx_fft_f_sptr make_rx_fft_f (unsigned int fftsize, int wintype)
+{
+    return gnuradio::get_initial_sptr(new rx_fft_f (fftsize, wintype));
+}
+
+/*! \brief Create receiver FFT object.
+ *  \param fftsize The FFT size.
+ *  \param wintype The window type (see gr::filter::firdes::win_type).
+ *
+ */
+rx_fft_f::rx_fft_f(unsigned int fftsize, int wintype)
+    : rx_fft_base<float>("rx_fft_f", fftsize, wintype, false),
+      d_fft(0)
+{
+    /* create FFT object, window and ring buffer */
+    apply_settings();
+}
 
-    if ((d_wintype < gr::filter::firdes::WIN_HAMMING) || (d_wintype > gr::filter::firdes::WIN_BLACKMAN_hARRIS))
+rx_fft_f::~rx_fft_f()
+{
+    delete d_fft;
+}
+
+/*! \brief Audio FFT work method.
+ *  \param noutput_items
+ *  \param input_items
+ *  \param output_items
+ *
+ * This method copies the incoming samples into the ring buffer and, if the
+ * GUI has asked for new data since the last FFT, computes the FFT on the
+ * latest fftsize samples.
+ */
+int rx_fft_f::work(int noutput_items,
+                   gr_vector_const_void_star &input_items,
+                   gr_vector_void_star &output_items)
+{
+    const float *in = (const float*)input_items[0];
+    (void) output_items;
+
+    apply_settings();
+
+    if (snapshot(in, noutput_items))
+        do_fft();
+
+    return noutput_items;
+
+}
+
+/*! \brief Apply FFT size and window type requested by the GUI.
+ *
+ * Called from the work thread, which is the only thread touching the FFT
+ * object, the window and the ring buffer.
+ */
+void rx_fft_f::apply_settings(void)
+{
+    unsigned int fftsize = d_new_fftsize.load();
+
+    if (fftsize != d_fftsize)
     {
-        d_wintype = gr::filter::firdes::WIN_HAMMING;
+        reset_ring(fftsize);
+
+        /* reset FFT object (also reset FFTW plan) */
+        delete d_fft;
+        d_fft = new gr::fft::fft_real_fwd(d_fftsize);
     }
 
-    d_window.clear();
-    d_window = gr::filter::firdes::window((gr::filter::firdes::win_type)d_wintype, d_fftsize, 6.76);
+    apply_window_type();
 }
 
-/*! \brief Get currently used window type. */
-int rx_fft_f::get_window_type()
+/*! \brief Compute FFT on the ring buffer and publish the result.
+ *
+ * The ring is windowed directly into the input buffer of the real FFT,
+ * which only computes the non-negative frequencies.
+ */
+void rx_fft_f::do_fft(void)
 {
-    return d_wintype;
+    unsigned int half = d_fftsize / 2;
+    float *buf = d_result.back(2 * half);
+
+    window_ring(d_fft->get_inbuf());
+    d_fft->execute();
+
+    /* power spectrum and averaging */
+    apply_avg_settings();
+    d_post.process_half(d_fft->get_outbuf(), d_fftsize, buf, buf + half);
+    d_result.publish(2 * half);
 }
@@ -23,15 +23,181 @@
 #ifndef RX_FFT_H
 #define RX_FFT_H
 
+#include <deque>
 #include <gnuradio/sync_block.h>
 #include <gnuradio/fft/fft.h>
 #include <gnuradio/filter/firdes.h>       /* contains enum win_type */
 #include <gnuradio/gr_complex.h>
+#include <gnuradio/high_res_timer.h>
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
-#include <boost/circular_buffer.hpp>
+#include "dsp/triple_buffer.h"
+#include "dsp/rx_hb_decim.h"
+
+
+#define MAX_FFT_SIZE 1048576
+#define MAX_FFT_AVG_FRAMES 64       /*! Max number of frames in linear averaging. */
+#define MAX_FFT_AVG_DATA   4194304  /*! Max number of bins kept for linear averaging. */
+#define FFT_THREADS_SIZE   65536    /*! Use threaded FFTW plans from this size. */
+#define FFT_MAX_THREADS    4        /*! Max number of FFTW threads. */
+#define MAX_FFT_OVERLAP    0.75   /*! Max overlap in continuous mode. */
+#define FFT_ZOOM_MARGIN    1.25   /*! Min zoom FFT rate relative to the span. */
+#define MAX_WF_LINES       64       /*! Max number of queued waterfall lines. */
+#define MAX_WF_LINE_DATA   4194304  /*! Max number of points in queued waterfall lines. */
+
+/*! \brief FFT averaging modes. */
+enum fft_avg_mode {
+    FFT_AVG_IIR = 0,      /*!< Exponential averaging (video filter). */
+    FFT_AVG_LINEAR = 1,   /*!< Moving average over N frames. */
+    FFT_AVG_MAX_HOLD = 2, /*!< Max hold. */
+    FFT_AVG_MIN_HOLD = 3  /*!< Min hold. */
+};
+
+/*! \brief Waterfall line modes. */
+enum wf_line_mode {
+    WF_LINE_AVG = 0,      /*!< Mean power of the frames since the last line. */
+    WF_LINE_PEAK = 1      /*!< Peak power of the frames since the last line. */
+};
+
+
+/*! \brief FFT post processing.
+ *  \ingroup DSP
+ *
+ * Converts raw FFT output to a shifted and normalized power spectrum in
+ * dBFS and applies averaging. The heavy lifting is done by VOLK kernels
+ * and plain loops that the compiler can vectorize.
+ *
+ * It also collects the power of the frames passed to add_line() since the
+ * last waterfall line, either as mean or as peak, until the line is taken
+ * with get_line().
+ *
+ * Not thread safe; it is owned by the work thread of the FFT blocks.
+ */
+class rx_fft_post
+{
+public:
+    rx_fft_post();
+
+    void process(const gr_complex *fft, unsigned int fftsize, float *avg, float *pwr);
+    void process_half(const gr_complex *fft, unsigned int fftsize, float *avg, float *pwr);
+    void process_pwr(const float *psd, unsigned int fftsize, float scale, float *avg, float *pwr);
+
+    void set_mode(int mode);
+    void set_gain(float gain);
+    void set_frames(unsigned int frames);
+    void reset(void);
+
+    void set_line_mode(int mode);
+    void add_line(const float *pwr, unsigned int fftsize, float scale);
+    void reset_line(void);
+    unsigned int line_size(void) const;
+    void get_line(float *line);
+
+private:
+    int          d_mode;      /*! Averaging mode, see fft_avg_mode. */
+    float        d_gain;      /*! IIR averaging gain. */
+    unsigned int d_frames;    /*! Number of frames in linear averaging. */
+    bool         d_reset;     /*! Restart averaging on next frame. */
+
+    std::vector<float> d_avg;   /*! Averaged spectrum. */
+    std::vector<float> d_sum;   /*! Sum of frames in d_hist (linear mode). */
+    std::vector<float> d_hist;  /*! Last d_frames frames (linear mode). */
+    unsigned int d_hist_len;   /*! Number of frames in d_hist. */
+    unsigned int d_hist_pos;
+    unsigned int d_hist_fill;
+
+    int          d_line_mode;   /*! Waterfall line mode, see wf_line_mode. */
+    std::vector<float> d_line;  /*! Power collected for the next waterfall line. */
+    unsigned int d_line_frames; /*! Number of frames in d_line. */
+
+    void finish(unsigned int fftsize, float scale, float *avg, float *pwr);
+};
+
+
+/*! \brief Common part of the FFT blocks.
+ *  \ingroup DSP
+ *
+ * Holds the settings requested by the GUI, the ring buffer with the latest
+ * fftsize input samples of type T, the window, the post processing and the
+ * triple buffer that passes the results to the GUI. Blocks made with lines
+ * enabled also queue waterfall lines for the GUI. The FFT itself and the
+ * work() method are left to the derived blocks.
+ *
+ * The member functions are defined in rx_fft.cpp and instantiated for
+ * gr_complex and float.
+ */
+template <class T>
+class rx_fft_base : public gr::sync_block
+{
+protected:
+    rx_fft_base(const std::string &name, unsigned int fftsize, int wintype, bool lines);
+
+public:
+    void get_fft_data(float *fftPoints, float *rawPoints, unsigned int &fftSize);
+
+    void set_window_type(int wintype);
+    int  get_window_type();
+
+    void set_fft_size(unsigned int fftsize);
+    unsigned int get_fft_size();
+
+    void set_fft_avg(int mode, float gain, unsigned int frames);
+    void reset_fft_avg(void);
 
+    void get_line_data(float *linePoints, unsigned int &lineSize);
+    void set_line_rate(float rate, int mode);
+
+protected:
+    unsigned int d_fftsize;   /*! Current FFT size. */
+    int          d_wintype;   /*! Current window type. */
+
+    boost::atomic<unsigned int> d_new_fftsize;  /*! FFT size requested by GUI. */
+    boost::atomic<int>          d_new_wintype;  /*! Window type requested by GUI. */
+    boost::atomic<bool>         d_request;      /*! GUI is waiting for new FFT data. */
+    boost::atomic<int>          d_avg_mode;     /*! Averaging mode requested by GUI. */
+    boost::atomic<float>        d_avg_gain;     /*! IIR averaging gain requested by GUI. */
+    boost::atomic<unsigned int> d_avg_frames;   /*! Linear averaging length requested by GUI. */
+    boost::atomic<bool>         d_avg_reset;    /*! GUI wants to restart averaging. */
+    boost::atomic<float>        d_line_rate;    /*! Waterfall lines per second requested by GUI. */
+    boost::atomic<int>          d_line_mode;    /*! Waterfall line mode requested by GUI. */
+
+    std::vector<float> d_window;      /*! FFT window taps. */
+
+    std::vector<T> d_ring;            /*! Latest d_fftsize input samples. */
+    unsigned int d_ring_pos;          /*! Oldest sample / next write position. */
+    unsigned int d_ring_fill;         /*! Number of valid samples in d_ring. */
+
+    rx_fft_post         d_post;     /*! Power spectrum and averaging. */
+    triple_buffer<float> d_result;  /*! Averaged and raw spectrum passed to the GUI. */
+
+    /*! \brief Waterfall line waiting for the GUI. */
+    struct wf_line
+    {
+        unsigned int        gen;    /*!< Generation of the frames in the line. */
+        std::vector<float>  data;   /*!< The line in dBFS. */
+    };
+
+    bool                d_lines;       /*! Block makes waterfall lines. */
+    boost::atomic<unsigned int> d_new_line_gen; /*! Bumped by the GUI when queued lines get invalid. */
+    unsigned int        d_line_gen;    /*! Generation of the frames in the current line. */
+    boost::mutex        d_line_mutex;  /*! Protects d_line_queue and d_line_spare. */
+    std::deque<wf_line> d_line_queue;  /*! Lines waiting for the GUI. */
+    std::vector<float>  d_line_spare;  /*! Buffer left by the GUI for reuse. */
+    std::vector<float>  d_line_back;   /*! Next line, owned by the work thread. */
+    std::vector<float>  d_line_front;  /*! Last line taken, owned by the GUI. */
+    gr::high_res_timer_type d_line_time; /*! Time when the next line is due. */
+
+    void reset_ring(unsigned int fftsize);
+    void apply_window_type(void);
+    void apply_avg_settings(void);
+    void ring_write(const T *in, unsigned int n);
+    bool snapshot(const T *in, unsigned int n);
+    void window_ring(T *dst);
+    bool line_due(bool update);
+    void publish_line(void);
+};
 
-#define MAX_FFT_SIZE 32768
 
 class rx_fft_c;
 class rx_fft_f;
@@ -43,12 +209,14 @@ typedef boost::shared_ptr<rx_fft_f> rx_fft_f_sptr;
 /*! \brief Return a shared_ptr to a new instance of rx_fft_c.
  *  \param fftsize The FFT size
  *  \param winttype The window type (see gnuradio/filter/firdes.h)
+ *  \param lines Make waterfall lines (see set_line_rate()).
  *
  * This is effectively the public constructor. To avoid accidental use
  * of raw pointers, the rx_fft_c constructor is private.
  * make_rx_fft_c is the public interface for creating new instances.
  */
-rx_fft_c_sptr make_rx_fft_c(unsigned int fftsize=4096, int wintype=gr::filter::firdes::WIN_HAMMING);
+rx_fft_c_sptr make_rx_fft_c(unsigned int fftsize=4096, int wintype=gr::filter::firdes::WIN_HAMMING,
+                            bool lines=false);
 
 
 /*! \brief Block for computing complex FFT.
@@ -56,19 +224,48 @@ rx_fft_c_sptr make_rx_fft_c(unsigned int fftsize=4096, int wintype=gr::filter::f
  *
  * This block is used to compute the FFT of the received spectrum.
  *
- * The samples are collected in a cicular buffer with size FFT_SIZE.
- * When the GUI asks for a new set of FFT data via get_fft_data() an FFT
- * will be performed on the data stored in the circular buffer - assuming
- * of course that the buffer contains at least fftsize samples.
+ * The work thread copies the latest fftsize samples into a ring buffer.
+ * When the GUI asks for a new set of FFT data via get_fft_data() it only
+ * raises a request flag; the next call to work() then performs the FFT,
+ * converts it to a power spectrum in dBFS, applies averaging and publishes
+ * the result through a triple buffer, which the GUI picks up on its next
+ * call. Neither thread ever waits for the other.
+ *
+ * In continuous mode (Welch's method) work() computes an FFT every hop
+ * samples, where the hop is given by the overlap, and accumulates |X|^2.
+ * The GUI then gets the mean power spectrum of all frames since its
+ * previous request, covering every input sample. The FFTs are limited to
+ * a fraction of the wall clock time given by the time budget; frames that
+ * do not fit are dropped and counted.
+ *
+ * In zoom mode the input is translated and decimated by a halfband
+ * cascade to the lowest power of two fraction of the sample rate that
+ * still covers the zoomed span, see set_zoom(). The FFT then runs on the
+ * decimated samples, so the zoomed span is resolved by the full FFT size
+ * at the cost of a small FFT and a decimator.
+ *
+ * FFT size and window changes are passed to the work thread the same way
+ * and take effect at the beginning of the next work() call. New FFT sizes
+ * are planned in a background thread and used once the plan is ready.
+ *
+ * When made with lines enabled the block also makes waterfall lines in the
+ * work thread, independently of the FFT updates. Every frame is added to
+ * the next line, which is queued at the rate set with set_line_rate(). In
+ * snapshot mode a frame is computed when a line is due and the GUI has not
+ * asked for one since the previous line. The GUI takes all queued lines
+ * with get_line_data(). Each zoom change that alters the FFT data starts a
+ * new line generation, and lines of older generations are never returned,
+ * so a line is always plotted with the zoom it was made with.
  *
  * \note Uses code from qtgui_sink_c
  */
-class rx_fft_c : public gr::sync_block
+class rx_fft_c : public rx_fft_base<gr_complex>
 {
-    friend rx_fft_c_sptr make_rx_fft_c(unsigned int fftsize, int wintype);
+    friend rx_fft_c_sptr make_rx_fft_c(unsigned int fftsize, int wintype, bool lines);
 
 protected:
-    rx_fft_c(unsigned int fftsize=4096, int wintype=gr::filter::firdes::WIN_HAMMING);
+    rx_fft_c(unsigned int fftsize=4096, int wintype=gr::filter::firdes::WIN_HAMMING,
+             bool lines=false);
 
 public:
     ~rx_fft_c();
@@ -77,26 +274,60 @@ public:
              gr_vector_const_void_star &input_items,
              gr_vector_void_star &output_items);
 
-    void get_fft_data(std::complex<float>* fftPoints, unsigned int &fftSize);
-
-    void set_window_type(int wintype);
-    int  get_window_type();
+    void set_continuous(bool enable);
+    void set_overlap(float overlap);
+    void set_time_budget(float budget);
+    unsigned long get_dropped_frames(void);
 
-    void set_fft_size(unsigned int fftsize);
-    unsigned int get_fft_size();
+    void set_zoom(double sample_rate, double center, double span);
+    static double zoom_rate(double sample_rate, double span);
 
 private:
-    unsigned int d_fftsize;   /*! Current FFT size. */
-    int          d_wintype;   /*! Current window type. */
-
-    boost::mutex d_mutex;  /*! Used to lock FFT output buffer. */
+    boost::atomic<bool>         d_new_continuous; /*! Continuous mode requested by GUI. */
+    boost::atomic<float>        d_new_overlap;  /*! Overlap requested by GUI. */
+    boost::atomic<float>        d_budget;       /*! Fraction of time available for FFTs. */
+    boost::atomic<unsigned long> d_dropped;     /*! Number of dropped frames. */
+    boost::mutex                d_zoom_mutex;      /*! Protects the zoom settings below. */
+    double                      d_new_zoom_center; /*! Zoom center requested by GUI. */
+    bool                        d_zoom_pending;    /*! d_new_zoom is waiting for the work thread. */
+    rx_hb_decim_cc_sptr         d_new_zoom;        /*! Decimator made by set_zoom(). */
+    double                      d_zoom_rate;       /*! Input rate of the last set_zoom(). */
+    double                      d_zoom_span;       /*! Span of the last set_zoom(). */
+
+    boost::thread d_planner;           /*! Creates FFT plans in the background. */
+    boost::atomic<gr::fft::fft_complex *> d_planned;  /*! New FFT object from d_planner. */
+    bool         d_planning;           /*! d_planner is running. */
+    unsigned int d_plan_size;          /*! FFT size being planned. */
 
     gr::fft::fft_complex    *d_fft;    /*! FFT object. */
-    std::vector<float>  d_window; /*! FFT window taps. */
-
-    boost::circular_buffer<gr_complex> d_cbuf; /*! buffer to accumulate samples. */
 
-    void do_fft(const gr_complex *data_in, unsigned int size);
+    bool         d_continuous;        /*! Current mode. */
+    float        d_overlap;           /*! Current overlap. */
+    unsigned int d_hop;               /*! Samples between FFTs in continuous mode. */
+    unsigned int d_since;             /*! Samples since the last FFT. */
+    std::vector<float> d_psd;         /*! Accumulated |X|^2. */
+    std::vector<float> d_tmp;         /*! |X|^2 of the current frame. */
+    unsigned int d_psd_frames;        /*! Number of frames in d_psd. */
+    gr::high_res_timer_type d_last_work;  /*! Time of the previous work() call. */
+    double       d_credit;            /*! Time left for FFTs in timer ticks. */
+
+    rx_hb_decim_cc_sptr     d_zoom;     /*! Zoom decimator, NULL when not zoomed. */
+    std::vector<gr_complex> d_zoom_in;  /*! Input samples waiting for decimation. */
+    std::vector<gr_complex> d_zoom_out; /*! Decimated samples. */
+
+    static gr::fft::fft_complex *create_fft(unsigned int fftsize);
+    void plan_fft(unsigned int fftsize);
+    void set_fft(gr::fft::fft_complex *fft, unsigned int fftsize);
+    void apply_settings(void);
+    void apply_zoom(void);
+    unsigned int zoom(const gr_complex *in, unsigned int n);
+    void decimate(const gr_complex *in, unsigned int nout, gr_complex *out);
+    void window_fft(void);
+    void do_fft(void);
+    void add_frame_to_line(void);
+    void make_line(void);
+    void work_continuous(const gr_complex *in, unsigned int n);
+    void publish_psd(void);
 
 };
 
@@ -118,14 +349,14 @@ rx_fft_f_sptr make_rx_fft_f(unsigned int fftsize=1024, int wintype=gr::filter::f
  * This block is used to compute the FFT of the audio spectrum or anything
  * else where real FFT is useful.
  *
- * The samples are collected in a cicular buffer with size FFT_SIZE.
- * When the GUI asks for a new set of FFT data using get_fft_data() an FFT
- * will be performed on the data stored in the circular buffer - assuming
- * that the buffer contains at least fftsize samples.
+ * Works like rx_fft_c in snapshot mode, but uses a real to complex FFT.
+ * The spectrum of a real signal is symmetric so only the fftsize/2 bins
+ * from 0 Hz up to, but not including, half the sample rate are returned by
+ * get_fft_data().
  *
  * \note Uses code from qtgui_sink_f
  */
-class rx_fft_f : public gr::sync_block
+class rx_fft_f : public rx_fft_base<float>
 {
     friend rx_fft_f_sptr make_rx_fft_f(unsigned int fftsize, int wintype);
 
@@ -139,26 +370,11 @@ public:
              gr_vector_const_void_star &input_items,
              gr_vector_void_star &output_items);
 
-    void get_fft_data(std::complex<float>* fftPoints, unsigned int &fftSize);
-
-    void set_window_type(int wintype);
-    int  get_window_type();
-
-    void set_fft_size(unsigned int fftsize);
-    unsigned int  get_fft_size();
-
 private:
-    unsigned int d_fftsize;   /*! Current FFT size. */
-    int          d_wintype;   /*! Current window type. */
-
-    boost::mutex d_mutex;  /*! Used to lock FFT output buffer. */
-
-    gr::fft::fft_complex    *d_fft;    /*! FFT object. */
-    std::vector<float>  d_window; /*! FFT window taps. */
-
-    boost::circular_buffer<float> d_cbuf; /*! buffer to accumulate samples. */
+    gr::fft::fft_real_fwd   *d_fft;    /*! FFT object. */
 
-    void do_fft(const float *data_in, unsigned int size);
+    void apply_settings(void);
+    void do_fft(void);
 
 };
 
@@ -21,9 +21,12 @@
  * Boston, MA 02110-1301, USA.
  */
 #include <cmath>
+#include <list>
+#include <map>
 #include <gnuradio/io_signature.h>
 #include <gnuradio/filter/firdes.h>
 #include <iostream>
+#include "dsp/filter_crossover.h"
 #include "dsp/rx_filter.h"
 
 static const int MIN_IN = 1;  /* Mininum number of input streams. */
@@ -31,6 +34,75 @@ static const int MAX_IN = 1;  /* Maximum number of input streams. */
 static const int MIN_OUT = 1; /* Minimum number of output streams. */
 static const int MAX_OUT = 1; /* Maximum number of output streams. */
 
+#define TAPS_CACHE_SIZE 64   /* Max number of tap sets in the cache. */
+
+/* Band pass filter parameters used as key in the tap cache. */
+struct bpf_key
+{
+    double rate, low, high, tw;
+
+    bool operator<(const bpf_key &k) const
+    {
+        if (rate != k.rate)
+            return rate < k.rate;
+        if (low != k.low)
+            return low < k.low;
+        if (high != k.high)
+            return high < k.high;
+        return tw < k.tw;
+    }
+};
+
+typedef std::list<std::pair<bpf_key, std::vector<gr_complex> > > bpf_list;
+
+static boost::mutex                        taps_mutex;
+static bpf_list                            taps_lru;   /* Most recent first. */
+static std::map<bpf_key, bpf_list::iterator> taps_map;
+
+/*! \brief Get complex band pass filter taps.
+ *
+ * Tap sets are kept in a cache shared by all filters, from which the least
+ * recently used set is evicted when the cache is full. Dragging a filter
+ * edge back and forth, or switching between modes, therefore reuses taps
+ * designed earlier. The cache lock is not held while designing, so two
+ * threads may occasionally design the same filter.
+ */
+static std::vector<gr_complex> band_pass_taps(double rate, double low,
+                                              double high, double tw)
+{
+    std::map<bpf_key, bpf_list::iterator>::iterator it;
+    std::vector<gr_complex> taps;
+    bpf_key key = { rate, low, high, tw };
+
+    {
+        boost::mutex::scoped_lock lock(taps_mutex);
+
+        it = taps_map.find(key);
+        if (it != taps_map.end())
+        {
+            taps_lru.splice(taps_lru.begin(), taps_lru, it->second);
+            return it->second->second;
+        }
+    }
+
+    taps = gr::filter::firdes::complex_band_pass(1.0, rate, low, high, tw);
+
+    boost::mutex::scoped_lock lock(taps_mutex);
+
+    if (taps_map.find(key) == taps_map.end())
+    {
+        if (taps_lru.size() >= TAPS_CACHE_SIZE)
+        {
+            taps_map.erase(taps_lru.back().first);
+            taps_lru.pop_back();
+        }
+        taps_lru.push_front(std::make_pair(key, taps));
+        taps_map[key] = taps_lru.begin();
+    }
+
+    return taps;
+}
+
 
 /*
  * Create a new instance of rx_filter and return
@@ -45,10 +117,13 @@ rx_filter::rx_filter(double sample_rate, double low, double high, double trans_w
     : gr::hier_block2 ("rx_filter",
                       gr::io_signature::make (MIN_IN, MAX_IN, sizeof (gr_complex)),
                       gr::io_signature::make (MIN_OUT, MAX_OUT, sizeof (gr_complex))),
+      d_use_fft(false),
       d_sample_rate(sample_rate),
       d_low(low),
       d_high(high),
-      d_trans_width(trans_width)
+      d_trans_width(trans_width),
+      d_pending(false),
+      d_quit(false)
 {
     if (low < -0.95*sample_rate/2.0)
         d_low = -0.95*sample_rate/2.0;
@@ -56,23 +131,67 @@ rx_filter::rx_filter(double sample_rate, double low, double high, double trans_w
         d_high = 0.95*sample_rate/2.0;
 
     /* generate taps */
-    d_taps = gr::filter::firdes::complex_band_pass(1.0, d_sample_rate, d_low, d_high, d_trans_width);
+    d_taps = band_pass_taps(d_sample_rate, d_low, d_high, d_trans_width);
 
     /* create band pass filter */
-    d_bpf = gr::filter::fir_filter_ccc::make(1, d_taps);
-
-    /* connect filter */
-    connect(self(), 0, d_bpf, 0);
-    connect(d_bpf, 0, self(), 0);
+    if (d_taps.size() >= fft_crossover_ccc())
+    {
+        d_use_fft = true;
+        d_fft_bpf = gr::filter::fft_filter_ccc::make(1, d_taps);
+
+        connect(self(), 0, d_fft_bpf, 0);
+        connect(d_fft_bpf, 0, self(), 0);
+    }
+    else
+    {
+        d_bpf = gr::filter::fir_filter_ccc::make(1, d_taps);
+
+        connect(self(), 0, d_bpf, 0);
+        connect(d_bpf, 0, self(), 0);
+    }
 }
 
 rx_filter::~rx_filter ()
 {
+    {
+        boost::mutex::scoped_lock lock(d_mutex);
+        d_quit = true;
+    }
+    d_cond.notify_one();
+    if (d_designer.joinable())
+        d_designer.join();
+}
+
+/*! \brief Estimate the number of taps of a band pass filter.
+ *
+ * This is the estimate firdes uses for the default Hamming window, which
+ * only depends on the sample rate and the transition width.
+ */
+static unsigned int band_pass_ntaps(double rate, double tw)
+{
+    unsigned int ntaps = (unsigned int) (53.0 * rate / (22.0 * tw));
 
+    return ntaps | 1;
 }
 
+/*! \brief Set new filter parameters.
+ *  \param low The lower limit of the band pass filter.
+ *  \param high The upper limit of the band pass filter.
+ *  \param trans_width The width of the transition bands.
+ *
+ * The new taps are designed and loaded by a worker thread and this
+ * function returns immediately. If it is called again before the worker
+ * got to the previous request, only the latest parameters are used.
+ *
+ * If the new filter needs the other filter kind, the flow graph is
+ * reconfigured here, on the thread that owns the receiver, and the new
+ * filter block keeps the old taps until the worker has designed new ones.
+ */
 void rx_filter::set_param(double low, double high, double trans_width)
 {
+    boost::mutex::scoped_lock lock(d_mutex);
+    bool use_fft;
+
     d_trans_width = trans_width;
     d_low         = low;
     d_high        = high;
@@ -82,16 +201,105 @@ void rx_filter::set_param(double low, double high, double trans_width)
     if (d_high > 0.95*d_sample_rate/2.0)
         d_high = 0.95*d_sample_rate/2.0;
 
-    /* generate new taps */
-    d_taps = gr::filter::firdes::complex_band_pass(1.0, d_sample_rate, d_low, d_high, d_trans_width);
+    use_fft = band_pass_ntaps(d_sample_rate, d_trans_width) >= fft_crossover_ccc();
+    if (use_fft != d_use_fft)
+        switch_filter(use_fft);
+
+    d_pending = true;
+
+    /* the worker is started on first use */
+    if (!d_designer.joinable())
+        d_designer = boost::thread(&rx_filter::designer, this);
+
+    d_cond.notify_one();
+}
+
+/*! \brief Worker thread function.
+ *
+ * Waits for a request, designs the taps for the latest parameters and
+ * loads them into the filter block that is in use. The filter blocks take
+ * new taps into use at the start of their next work() call. The worker
+ * never changes the flow graph.
+ */
+void rx_filter::designer(void)
+{
+    std::vector<gr_complex> taps;
+    double low, high, trans_width;
+
+    for (;;)
+    {
+        {
+            boost::mutex::scoped_lock lock(d_mutex);
+
+            while (!d_pending && !d_quit)
+                d_cond.wait(lock);
+
+            if (d_quit)
+                return;
+
+            low = d_low;
+            high = d_high;
+            trans_width = d_trans_width;
+            d_pending = false;
+        }
+
+        taps = band_pass_taps(d_sample_rate, low, high, trans_width);
 
 #ifndef QT_NO_DEBUG_OUTPUT
-    std::cout << "Genrating taps for new filter LO:" << d_low <<
-                 " HI:" << d_high << " TW:" << d_trans_width << std::endl;
-    std::cout << "Required number of taps: " << d_taps.size() << std::endl;
+        std::cout << "Generating taps for new filter LO:" << low <<
+                     " HI:" << high << " TW:" << trans_width << std::endl;
+        std::cout << "Required number of taps: " << taps.size() << std::endl;
 #endif
 
-    d_bpf->set_taps(d_taps);
+        boost::mutex::scoped_lock lock(d_mutex);
+
+        d_taps = taps;
+        if (d_use_fft)
+            d_fft_bpf->set_taps(d_taps);
+        else
+            d_bpf->set_taps(d_taps);
+    }
+}
+
+/*! \brief Switch between the direct form and the FFT filter.
+ *  \param use_fft Whether to use the FFT filter.
+ *
+ * Must be called with d_mutex held from the thread that owns the flow
+ * graph. The filter that is not in use is kept so that it can be reused,
+ * and the filter that is taken into use is loaded with the current taps.
+ */
+void rx_filter::switch_filter(bool use_fft)
+{
+    if (use_fft)
+    {
+        if (d_fft_bpf)
+            d_fft_bpf->set_taps(d_taps);
+        else
+            d_fft_bpf = gr::filter::fft_filter_ccc::make(1, d_taps);
+
+        lock();
+        disconnect(self(), 0, d_bpf, 0);
+        disconnect(d_bpf, 0, self(), 0);
+        connect(self(), 0, d_fft_bpf, 0);
+        connect(d_fft_bpf, 0, self(), 0);
+        unlock();
+    }
+    else
+    {
+        if (d_bpf)
+            d_bpf->set_taps(d_taps);
+        else
+            d_bpf = gr::filter::fir_filter_ccc::make(1, d_taps);
+
+        lock();
+        disconnect(self(), 0, d_fft_bpf, 0);
+        disconnect(d_fft_bpf, 0, self(), 0);
+        connect(self(), 0, d_bpf, 0);
+        connect(d_bpf, 0, self(), 0);
+        unlock();
+    }
+
+    d_use_fft = use_fft;
 }
 
 
@@ -101,12 +309,12 @@ void rx_filter::set_param(double low, double high, double trans_width)
  * Create a new instance of rx_xlating_filter and return
  * a boost shared_ptr. This is effectively the public constructor.
  */
-rx_xlating_filter_sptr make_rx_xlating_filter(double sample_rate, double center, double low, double high, double trans_width)
+rx_xlating_filter_sptr make_rx_xlating_filter(double sample_rate, double center, double low, double high, double trans_width, unsigned int decim)
 {
-    return gnuradio::get_initial_sptr(new rx_xlating_filter(sample_rate, center, low, high, trans_width));
+    return gnuradio::get_initial_sptr(new rx_xlating_filter(sample_rate, center, low, high, trans_width, decim));
 }
 
-rx_xlating_filter::rx_xlating_filter(double sample_rate, double center, double low, double high, double trans_width)
+rx_xlating_filter::rx_xlating_filter(double sample_rate, double center, double low, double high, double trans_width, unsigned int decim)
     : gr::hier_block2 ("rx_xlating_filter",
                       gr::io_signature::make (MIN_IN, MAX_IN, sizeof (gr_complex)),
                       gr::io_signature::make (MIN_OUT, MAX_OUT, sizeof (gr_complex))),
@@ -114,13 +322,14 @@ rx_xlating_filter::rx_xlating_filter(double sample_rate, double center, double l
       d_center(center),
       d_low(low),
       d_high(high),
-      d_trans_width(trans_width)
+      d_trans_width(trans_width),
+      d_decim(decim)
 {
     /* generate taps */
-    d_taps = gr::filter::firdes::complex_band_pass(1.0, d_sample_rate, -d_high, -d_low, d_trans_width);
+    d_taps = gr::filter::firdes::complex_band_pass(1.0, d_sample_rate, d_low, d_high, d_trans_width);
 
     /* create band pass filter */
-    d_bpf = gr::filter::freq_xlating_fir_filter_ccc::make(1, d_taps, d_center, d_sample_rate);
+    d_bpf = gr::filter::freq_xlating_fir_filter_ccc::make(d_decim, d_taps, d_center, d_sample_rate);
 
     /* connect filter */
     connect(self(), 0, d_bpf, 0);
@@ -136,11 +345,10 @@ rx_xlating_filter::~rx_xlating_filter()
 
 void rx_xlating_filter::set_offset(double center)
 {
-    /* we have to change sign because the set_center_freq() actually
-       shifts the passband with the specified amount, which has
-       opposite sign of selecting a center frequency.
+    /* set_center_freq() moves the passband to the specified offset and
+       translates it down to 0 Hz, so the taps are specified around 0 Hz.
     */
-    d_center = -center;
+    d_center = center;
     d_bpf->set_center_freq(d_center);
 }
 
@@ -152,7 +360,7 @@ void rx_xlating_filter::set_param(double low, double high, double trans_width)
     d_high        = high;
 
     /* generate new taps */
-    d_taps = gr::filter::firdes::complex_band_pass(1.0, d_sample_rate, -d_high, -d_low, d_trans_width);
+    d_taps = gr::filter::firdes::complex_band_pass(1.0, d_sample_rate, d_low, d_high, d_trans_width);
 
     d_bpf->set_taps(d_taps);
 }
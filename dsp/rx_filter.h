@@ -23,8 +23,12 @@
 #ifndef RX_FILTER_H
 #define RX_FILTER_H
 
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <gnuradio/hier_block2.h>
 #include <gnuradio/filter/fir_filter_ccc.h>
+#include <gnuradio/filter/fft_filter_ccc.h>
 #include <gnuradio/filter/freq_xlating_fir_filter_ccc.h>
 
 
@@ -59,6 +63,19 @@ rx_filter_sptr make_rx_filter(double sample_rate,
  * required to generate complex band pass filter taps. It provides a simple
  * interface to set the filter parameters.
  *
+ * Sharp filters can have thousands of taps, so when the number of taps
+ * reaches fft_crossover_ccc() the direct form FIR filter is replaced by
+ * an overlap-save FFT filter, whose cost per sample only grows with the
+ * logarithm of the filter length.
+ *
+ * Designing the taps for a sharp filter takes too long to be done on the
+ * GUI thread while the user is dragging the filter edges. set_param()
+ * therefore only records the request and returns; the taps are designed
+ * and loaded by a worker thread, which skips requests that have been
+ * superseded while it was busy. Recently used tap sets are cached. The
+ * worker never reconfigures the flow graph, a switch between the direct
+ * form and the FFT filter is done by set_param() on the calling thread.
+ *
  * The user of this class is expected to provide valid parameters and no checks are
  * performed by the accessors (though the taps generator from gr::filter::firdes does perform
  * some sanity checks and throws std::out_of_range in case of bad parameter).
@@ -75,23 +92,36 @@ public:
     void set_param(double low, double high, double trans_width);
 
 private:
-    std::vector<gr_complex> d_taps;
+    void switch_filter(bool use_fft);
+    void designer(void);
+
+private:
+    std::vector<gr_complex> d_taps;     /*! Current taps, protected by d_mutex. */
     gr::filter::fir_filter_ccc::sptr  d_bpf;
+    gr::filter::fft_filter_ccc::sptr  d_fft_bpf;
+    bool   d_use_fft;              /*! Protected by d_mutex. */
 
     double d_sample_rate;
     double d_low;
     double d_high;
     double d_trans_width;
+
+    boost::thread              d_designer;  /*! Designs and loads new taps. */
+    boost::mutex               d_mutex;     /*! Protects the taps, filter kind and request. */
+    boost::condition_variable  d_cond;      /*! Signals a new request. */
+    bool   d_pending;          /*! There is a request for d_designer. */
+    bool   d_quit;             /*! d_designer should exit. */
 };
 
 
 
 /*! \brief Return a shared_ptr to a new instance of rx_xlating_filter.
- *  \param sample_rate The sample rate.
- *  \param offset The filter offset.
+ *  \param sample_rate The input sample rate.
+ *  \param center The filter offset.
  *  \param low The lower limit of the bandpass filter.
  *  \param high The upper limit of the filter.
  *  \param trans_width The width of the transition band from
+ *  \param decim The decimation factor.
  *
  * This is effectively the public constructor. To avoid accidental use
  * of raw pointers, rx_filter's constructor is private.
@@ -101,7 +131,8 @@ rx_xlating_filter_sptr make_rx_xlating_filter(double sample_rate,
                                               double center=0.0,
                                               double low=-5000.0,
                                               double high=5000.0,
-                                              double trans_width=1000.0);
+                                              double trans_width=1000.0,
+                                              unsigned int decim=1);
 
 
 /*! \brief Frequency translating band-pass filter with complex taps.
@@ -115,17 +146,19 @@ rx_xlating_filter_sptr make_rx_xlating_filter(double sample_rate,
  * The filter limits are relative to the filter offset and thanks to the complex taps
  * they can be both positive and negative.
  *
+ * The output can be decimated, in which case translation, filtering and
+ * decimation are done in one pass and the filter is only evaluated at the
+ * output rate.
+ *
  * The user of this class is expected to provide valid parameters and no checks are
  * performed by the accessors (though the taps generator from gr::filter::firdes does perform
  * some sanity checks and throws std::out_of_range in case of bad parameter).
- *
- * \note In order to have proper LSB/USB, we must exchange low and high and reverse their sign?
  */
 class rx_xlating_filter : public gr::hier_block2
 {
 
 public:
-    rx_xlating_filter(double sample_rate=96000.0, double center=0.0, double low=-5000.0, double high=5000.0, double trans_width=1000.0); // FIXME: should be private
+    rx_xlating_filter(double sample_rate=96000.0, double center=0.0, double low=-5000.0, double high=5000.0, double trans_width=1000.0, unsigned int decim=1); // FIXME: should be private
     ~rx_xlating_filter();
 
     void set_offset(double center);
@@ -141,6 +174,7 @@ private:
     double d_low;
     double d_high;
     double d_trans_width;
+    unsigned int d_decim;
 };
 
 
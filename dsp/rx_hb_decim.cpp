@@ -0,0 +1,445 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           http://gqrx.dk/
+ *
+ * Copyright 2011-2014 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include <string.h>
+#include <volk/volk.h>
+#include <gnuradio/io_signature.h>
+#include "dsp/rx_hb_decim.h"
+
+#define HB_ATTEN    70.0    /* Stop band attenuation of each stage in dB. */
+#define HB_MAX_TAPS 255     /* Upper limit for the number of taps. */
+#define HB_BLOCK    1024    /* Output samples per block in filter_stage(). */
+#define HB_FIRST    4       /* Max number of stages done by the first FIR. */
+
+
+/*! \brief Get the number of taps of a Kaiser windowed filter.
+ *  \param tw The transition width relative to the sample rate.
+ *  \param atten The stop band attenuation in dB.
+ *  \return The number of taps needed, or HB_MAX_TAPS + 1 if it is more
+ *          than HB_MAX_TAPS.
+ */
+static unsigned int kaiser_ntaps(double tw, double atten)
+{
+    double ntaps;
+
+    if (tw <= 0.0)
+        return HB_MAX_TAPS + 1;
+
+    ntaps = ceil((atten - 7.95) / (14.36 * tw)) + 1.0;
+
+    return ntaps > HB_MAX_TAPS ? HB_MAX_TAPS + 1 : (unsigned int) ntaps;
+}
+
+/*! \brief Limit the number of taps to HB_MAX_TAPS.
+ *  \param ntaps The number of taps needed.
+ *  \param name The filter name used in the message.
+ *
+ * The attenuation of a filter that is cut short falls below HB_ATTEN, so
+ * this is logged. The constructor avoids it for the first stage.
+ */
+static unsigned int limit_ntaps(unsigned int ntaps, const char *name)
+{
+    if (ntaps <= HB_MAX_TAPS)
+        return ntaps;
+
+#ifndef QT_NO_DEBUG_OUTPUT
+    std::cout << "HB " << name << " filter limited to " << HB_MAX_TAPS
+              << " taps, stop band attenuation is reduced" << std::endl;
+#endif
+
+    return HB_MAX_TAPS;
+}
+
+
+rx_hb_decim_cc_sptr make_rx_hb_decim_cc(double sample_rate, unsigned int stages,
+                                        double bandwidth, double offset)
+{
+    return gnuradio::get_initial_sptr(new rx_hb_decim_cc(sample_rate, stages,
+                                                         bandwidth, offset));
+}
+
+/*! \brief Create a halfband decimator cascade.
+ *  \param sample_rate The input sample rate.
+ *  \param stages The number of halfband stages.
+ *  \param bandwidth The one sided bandwidth that must be free from aliases.
+ *  \param offset The frequency that is translated to 0 Hz.
+ */
+rx_hb_decim_cc::rx_hb_decim_cc(double sample_rate, unsigned int stages,
+                               double bandwidth, double offset)
+    : gr::sync_decimator ("rx_hb_decim_cc",
+          gr::io_signature::make(1, 1, sizeof(gr_complex)),
+          gr::io_signature::make(1, 1, sizeof(gr_complex)),
+          1u << stages),
+      d_xtaps_inc(0.0),
+      d_num_stages(stages),
+      d_sample_rate(sample_rate),
+      d_phase(1.0, 0.0),
+      d_tmp(2 * HB_BLOCK)
+{
+    unsigned int i;
+    unsigned int first = std::min(stages, (unsigned int) HB_FIRST);
+    double       rate = sample_rate;
+
+    // the first stages are merged into one translating FIR, as many as
+    // fit in HB_MAX_TAPS; the others are left to the halfband stages
+    while (first > 1 &&
+           kaiser_ntaps(1.0 / (1u << first) - 2.0 * bandwidth / rate, HB_ATTEN) > HB_MAX_TAPS)
+        first--;
+
+    d_decim1 = 1u << first;
+    if (first > 0)
+    {
+        d_lp = decim_taps(bandwidth / rate, d_decim1, HB_ATTEN);
+        d_hist.assign(d_lp.size() - 1, gr_complex(0.0, 0.0));
+        rate /= d_decim1;
+
+#ifndef QT_NO_DEBUG_OUTPUT
+        std::cout << "HB first stage: " << d_lp.size() << " taps, decimation "
+                  << d_decim1 << ", output rate " << rate << std::endl;
+#endif
+    }
+
+    d_stages.resize(stages - first);
+    for (i = 0; i < d_stages.size(); i++)
+    {
+        design_stage(d_stages[i], bandwidth / rate);
+        rate /= 2.0;
+
+#ifndef QT_NO_DEBUG_OUTPUT
+        std::cout << "HB stage " << i << ": " << 2 * d_stages[i].taps.size() - 1
+                  << " taps, output rate " << rate << std::endl;
+#endif
+    }
+
+    set_offset(offset);
+}
+
+rx_hb_decim_cc::~rx_hb_decim_cc()
+{
+
+}
+
+/*! \brief Get the number of stages needed for a given output rate.
+ *  \param sample_rate The input sample rate.
+ *  \param out_rate The lowest acceptable output rate.
+ *  \return The largest number of stages for which the output rate is at
+ *          least \p out_rate.
+ */
+unsigned int rx_hb_decim_cc::calc_stages(double sample_rate, double out_rate)
+{
+    unsigned int stages = 0;
+
+    while (sample_rate >= 2.0 * out_rate && stages < 16)
+    {
+        sample_rate /= 2.0;
+        stages++;
+    }
+
+    return stages;
+}
+
+/*! \brief Set the frequency that is translated to 0 Hz.
+ *
+ * This function can be called while the flow graph is running. The taps
+ * of the first stage are updated by the next call to work().
+ */
+void rx_hb_decim_cc::set_offset(double offset)
+{
+    d_offset = offset;
+    d_phase_inc = -2.0 * M_PI * offset / d_sample_rate;
+}
+
+/*! \brief Zeroth order modified Bessel function of the first kind. */
+static double bessel_i0(double x)
+{
+    double       sum = 1.0;
+    double       t = 1.0;
+    unsigned int k;
+
+    for (k = 1; k < 50; k++)
+    {
+        t *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += t;
+    }
+
+    return sum;
+}
+
+/*! \brief Design a Kaiser windowed halfband filter.
+ *  \param rel_bw The bandwidth relative to the input rate.
+ *  \param atten The stop band attenuation in dB.
+ *  \return The non-zero taps except the center tap, which is 0.5.
+ *
+ * The pass band extends to rel_bw and the stop band starts at 0.5-rel_bw,
+ * which is the lowest frequency that aliases into the pass band after
+ * decimation. The number of taps is of the form 4k+3, so that the
+ * outermost taps are not zero. The returned taps are at offsets -m, -m+2,
+ * ..., -1, 1, ..., m from the center, where m is the size minus one.
+ */
+std::vector<float> rx_hb_decim_cc::halfband_taps(double rel_bw, double atten)
+{
+    std::vector<float> taps;
+    double       tw = 0.5 - 2.0 * rel_bw;
+    double       beta = 0.1102 * (atten - 8.7);
+    double       sum = 0.0;
+    double       x, t, i0beta;
+    unsigned int ntaps, m, i;
+
+    ntaps = limit_ntaps(kaiser_ntaps(tw, atten), "halfband");
+    ntaps = 4 * (ntaps / 4) + 3;
+    m = (ntaps - 1) / 2;
+
+    i0beta = bessel_i0(beta);
+
+    taps.resize(m + 1);
+    for (i = 0; i < (m + 1) / 2; i++)
+    {
+        // offset from the center is 2i+1
+        x = (double) (2 * i + 1) / (double) m;
+        t = sin(M_PI * (2 * i + 1) / 2.0) / (M_PI * (2 * i + 1)) *
+            bessel_i0(beta * sqrt(1.0 - x * x)) / i0beta;
+        taps[(m - 1) / 2 - i] = t;
+        taps[(m + 1) / 2 + i] = t;
+        sum += 2.0 * t;
+    }
+
+    // unity gain at DC: center tap is 0.5, the others must add up to 0.5
+    for (i = 0; i < taps.size(); i++)
+        taps[i] *= 0.5 / sum;
+
+    return taps;
+}
+
+/*! \brief Design a Kaiser windowed low pass filter for decimation.
+ *  \param rel_bw The bandwidth relative to the input rate.
+ *  \param decim The decimation.
+ *  \param atten The stop band attenuation in dB.
+ *  \return The taps, an odd number with unity gain at DC.
+ *
+ * Like halfband_taps() the filter only has to keep aliases out of rel_bw,
+ * so the transition band reaches from rel_bw to 1/decim-rel_bw.
+ */
+std::vector<float> rx_hb_decim_cc::decim_taps(double rel_bw, unsigned int decim,
+                                              double atten)
+{
+    std::vector<float> taps;
+    double       tw = 1.0 / decim - 2.0 * rel_bw;
+    double       fc = 0.5 / decim;
+    double       beta = 0.1102 * (atten - 8.7);
+    double       sum = 0.0;
+    double       x, t, i0beta;
+    unsigned int ntaps, m, i;
+    int          k;
+
+    ntaps = limit_ntaps(kaiser_ntaps(tw, atten), "decimation");
+    ntaps |= 1;
+    m = (ntaps - 1) / 2;
+
+    i0beta = bessel_i0(beta);
+
+    taps.resize(ntaps);
+    for (i = 0; i < ntaps; i++)
+    {
+        k = (int) i - (int) m;
+        x = (double) k / (double) m;
+        t = (k == 0) ? 2.0 * fc : sin(2.0 * M_PI * fc * k) / (M_PI * k);
+        t *= bessel_i0(beta * sqrt(1.0 - x * x)) / i0beta;
+        taps[i] = t;
+        sum += t;
+    }
+
+    for (i = 0; i < ntaps; i++)
+        taps[i] /= sum;
+
+    return taps;
+}
+
+/*! \brief Set up a stage.
+ *  \param stage The stage.
+ *  \param rel_bw The bandwidth relative to the input rate of the stage.
+ */
+void rx_hb_decim_cc::design_stage(hb_stage &stage, double rel_bw)
+{
+    stage.taps = halfband_taps(rel_bw, HB_ATTEN);
+    stage.hist = stage.taps.size() - 1;
+    stage.even.assign(stage.hist, gr_complex(0.0, 0.0));
+    stage.odd.assign(stage.hist, gr_complex(0.0, 0.0));
+}
+
+/*! \brief Shift the first stage filter to the current offset.
+ *  \param inc The phase increment per input sample.
+ */
+void rx_hb_decim_cc::update_xtaps(float inc)
+{
+    unsigned int i;
+
+    d_xtaps.resize(d_lp.size());
+    for (i = 0; i < d_lp.size(); i++)
+        d_xtaps[i] = d_lp[i] * gr_complex(cos(inc * i), sin(inc * i));
+    d_xtaps_inc = inc;
+}
+
+/*! \brief Run the first stage.
+ *  \param in The input samples.
+ *  \param nin The number of input samples (a multiple of d_decim1).
+ *  \param out Output buffer for nin/d_decim1 samples.
+ *
+ * The first stage is a translating FIR filter that reads the input
+ * directly: the taps are shifted to the offset so the input does not have
+ * to be rotated, and the output is rotated to 0 Hz at the lower rate. Only
+ * the outputs that overlap the previous call are computed from the
+ * history buffer.
+ */
+void rx_hb_decim_cc::filter_first(const gr_complex *in, unsigned int nin,
+                                  gr_complex *out)
+{
+    unsigned int ntaps = d_xtaps.size();
+    unsigned int hist = ntaps - 1;
+    unsigned int nout = nin / d_decim1;
+    unsigned int nedge = std::min(nout, (hist + d_decim1 - 1) / d_decim1);
+    unsigned int j;
+
+    d_hist.insert(d_hist.end(), in, in + nedge * d_decim1);
+    for (j = 0; j < nedge; j++)
+        volk_32fc_x2_dot_prod_32fc(&out[j], &d_hist[j * d_decim1], &d_xtaps[0], ntaps);
+    for (; j < nout; j++)
+        volk_32fc_x2_dot_prod_32fc(&out[j], in + j * d_decim1 - hist, &d_xtaps[0], ntaps);
+
+    if (nin > nedge * d_decim1)
+        d_hist.assign(in + nin - hist, in + nin);
+    else
+        d_hist.erase(d_hist.begin(), d_hist.end() - hist);
+}
+
+/*! \brief Append new input to a stage.
+ *  \param stage The stage.
+ *  \param in The new input samples.
+ *  \param nin The number of new samples (even).
+ */
+void rx_hb_decim_cc::load_stage(hb_stage &stage, const gr_complex *in,
+                                unsigned int nin)
+{
+    unsigned int i;
+    gr_complex  *ev, *od;
+
+    stage.even.resize(stage.hist + nin / 2);
+    stage.odd.resize(stage.hist + nin / 2);
+    ev = &stage.even[stage.hist];
+    od = &stage.odd[stage.hist];
+
+    for (i = 0; i < nin / 2; i++)
+    {
+        ev[i] = in[2 * i];
+        od[i] = in[2 * i + 1];
+    }
+}
+
+/*! \brief Run one halfband stage.
+ *  \param stage The stage with nout new samples in each phase.
+ *  \param nout The number of output samples.
+ *  \param out Output buffer for nout samples.
+ *
+ * The sample at the center of output j is odd[j + (m-1)/2] and the
+ * non-zero taps fall on even[j] ... even[j + m]. The taps are symmetric,
+ * so the samples sharing a tap are added before the multiplication.
+ *
+ * The filter is computed one tap pair at a time over blocks of samples,
+ * treating I and Q as independent float streams. This keeps the work in
+ * the volk kernels, which matters because the first stages have very few
+ * taps and run at the full input rate.
+ */
+void rx_hb_decim_cc::filter_stage(hb_stage &stage, unsigned int nout,
+                                  gr_complex *out)
+{
+    const float  *h = &stage.taps[0];
+    unsigned int  m = stage.taps.size() - 1;
+    const float  *ev, *od;
+    float        *y, *tmp = &d_tmp[0];
+    unsigned int  j0, n, k;
+
+    for (j0 = 0; j0 < nout; j0 += HB_BLOCK)
+    {
+        n = 2 * std::min(nout - j0, (unsigned int) HB_BLOCK);
+        ev = (const float *) &stage.even[j0];
+        od = (const float *) &stage.odd[j0 + (m - 1) / 2];
+        y = (float *) &out[j0];
+
+        volk_32f_s32f_multiply_32f(y, od, 0.5f, n);
+        for (k = 0; k < (m + 1) / 2; k++)
+        {
+            volk_32f_x2_add_32f(tmp, ev + 2 * k, ev + 2 * (m - k), n);
+            volk_32f_s32f_multiply_32f(tmp, tmp, h[k], n);
+            volk_32f_x2_add_32f(y, y, tmp, n);
+        }
+    }
+
+    // keep the history for the next call
+    memmove(&stage.even[0], &stage.even[nout], stage.hist * sizeof(gr_complex));
+    memmove(&stage.odd[0], &stage.odd[nout], stage.hist * sizeof(gr_complex));
+}
+
+int rx_hb_decim_cc::work(int noutput_items,
+                         gr_vector_const_void_star &input_items,
+                         gr_vector_void_star &output_items)
+{
+    const gr_complex *in = (const gr_complex *) input_items[0];
+    gr_complex       *out = (gr_complex *) output_items[0];
+    float             inc = d_phase_inc;
+    lv_32fc_t         phase_inc = lv_32fc_t(cos(inc * d_decim1), sin(inc * d_decim1));
+    unsigned int      nin = noutput_items * decimation();
+    unsigned int      s, n;
+
+    if (d_lp.empty())
+    {
+        volk_32fc_s32fc_x2_rotator_32fc(out, in, phase_inc, &d_phase, nin);
+        return noutput_items;
+    }
+
+    if (inc != d_xtaps_inc || d_xtaps.empty())
+        update_xtaps(inc);
+
+    // first stage, then the halfband stages using d_buf for the intermediate data
+    n = nin / d_decim1;
+    if (d_stages.empty())
+    {
+        filter_first(in, nin, out);
+        volk_32fc_s32fc_x2_rotator_32fc(out, out, phase_inc, &d_phase, n);
+        return noutput_items;
+    }
+
+    if (d_buf.size() < n)
+        d_buf.resize(n);
+    filter_first(in, nin, &d_buf[0]);
+    volk_32fc_s32fc_x2_rotator_32fc(&d_buf[0], &d_buf[0], phase_inc, &d_phase, n);
+
+    for (s = 0; s < d_stages.size(); s++)
+    {
+        load_stage(d_stages[s], &d_buf[0], n);
+        n /= 2;
+        filter_stage(d_stages[s], n, s + 1 < d_stages.size() ? &d_buf[0] : out);
+    }
+
+    return noutput_items;
+}
@@ -0,0 +1,132 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           http://gqrx.dk/
+ *
+ * Copyright 2011-2014 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef RX_HB_DECIM_H
+#define RX_HB_DECIM_H
+
+#include <vector>
+#include <gnuradio/sync_decimator.h>
+#include <gnuradio/gr_complex.h>
+#include <boost/atomic.hpp>
+
+
+class rx_hb_decim_cc;
+
+typedef boost::shared_ptr<rx_hb_decim_cc> rx_hb_decim_cc_sptr;
+
+
+/*! \brief Return a shared_ptr to a new instance of rx_hb_decim_cc.
+ *  \param sample_rate The input sample rate.
+ *  \param stages The number of halfband stages.
+ *  \param bandwidth The one sided bandwidth that must be free from aliases.
+ *  \param offset The frequency that is translated to 0 Hz.
+ */
+rx_hb_decim_cc_sptr make_rx_hb_decim_cc(double sample_rate, unsigned int stages,
+                                        double bandwidth, double offset=0.0);
+
+
+/*! \brief Frequency translating halfband decimator cascade.
+ *  \ingroup DSP
+ *
+ * This block translates the channel at the given offset to 0 Hz and
+ * decimates by 2^stages. Each stage only has to keep aliases out of the
+ * final bandwidth, so the filters at the high rates get by with a few taps
+ * while they become longer as the rate goes down.
+ *
+ * The first stages, up to a decimation of 16, are merged into a single
+ * translating FIR filter as long as it fits in 255 taps. Its taps are shifted to the offset, so that the
+ * full rate input is read only once by the dot products and the rotation
+ * to 0 Hz happens at the decimated rate. The remaining stages are
+ * halfband filters. Every other tap of a halfband filter is zero, so an
+ * output sample of a stage with N taps costs (N+1)/2 multiplications with
+ * a real coefficient, and since the taps are symmetric this is halved
+ * again by adding the samples sharing a tap first.
+ *
+ * The block is intended to be followed by a fractional resampler that takes
+ * the rate from somewhere between out_rate and 2*out_rate down to out_rate.
+ * Use calc_stages() to find the number of stages for a given rate.
+ */
+class rx_hb_decim_cc : public gr::sync_decimator
+{
+    friend rx_hb_decim_cc_sptr make_rx_hb_decim_cc(double sample_rate,
+                                                   unsigned int stages,
+                                                   double bandwidth,
+                                                   double offset);
+
+protected:
+    rx_hb_decim_cc(double sample_rate, unsigned int stages, double bandwidth,
+                   double offset);
+
+public:
+    ~rx_hb_decim_cc();
+
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items);
+
+    static unsigned int calc_stages(double sample_rate, double out_rate);
+    static std::vector<float> halfband_taps(double rel_bw, double atten);
+    static std::vector<float> decim_taps(double rel_bw, unsigned int decim,
+                                         double atten);
+
+    void   set_offset(double offset);
+    double offset(void) const { return d_offset; }
+    unsigned int stages(void) const { return d_num_stages; }
+
+private:
+    /*! \brief One halfband stage.
+     *
+     * The input is split into even and odd samples. The odd samples are
+     * multiplied by the center tap and the even ones by the non-zero taps,
+     * which makes the zero taps disappear from the computation.
+     */
+    struct hb_stage
+    {
+        std::vector<float>      taps;  /*!< The non-zero taps except the center. */
+        std::vector<gr_complex> even;  /*!< History followed by new even samples. */
+        std::vector<gr_complex> odd;   /*!< History followed by new odd samples. */
+        unsigned int            hist;  /*!< Number of history samples in each phase. */
+    };
+
+    void design_stage(hb_stage &stage, double rel_bw);
+    void update_xtaps(float inc);
+    void filter_first(const gr_complex *in, unsigned int nin, gr_complex *out);
+    void load_stage(hb_stage &stage, const gr_complex *in, unsigned int nin);
+    void filter_stage(hb_stage &stage, unsigned int nout, gr_complex *out);
+
+    std::vector<float>     d_lp;          /*!< First stage low pass taps. */
+    std::vector<gr_complex> d_xtaps;      /*!< First stage taps shifted to the offset. */
+    std::vector<gr_complex> d_hist;       /*!< First stage input history. */
+    unsigned int           d_decim1;      /*!< First stage decimation. */
+    float                  d_xtaps_inc;   /*!< Phase increment d_xtaps are made for. */
+    std::vector<hb_stage>  d_stages;      /*!< The halfband stages. */
+    unsigned int           d_num_stages;  /*!< Total number of stages. */
+    double                 d_sample_rate; /*!< Input sample rate. */
+    double                 d_offset;      /*!< Current frequency offset. */
+    boost::atomic<float>   d_phase_inc;   /*!< Input phase increment per sample. */
+    gr_complex             d_phase;       /*!< Oscillator phase at the first stage output. */
+    std::vector<gr_complex> d_buf;        /*!< Output of the oscillator and the stages. */
+    std::vector<float>     d_tmp;         /*!< Scratch buffer for filter_stage(). */
+};
+
+
+#endif /* RX_HB_DECIM_H */
@@ -0,0 +1,242 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           http://gqrx.dk/
+ *
+ * Copyright 2011-2014 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include <string.h>
+#include <gnuradio/io_signature.h>
+#include "dsp/rx_hb_decim.h"
+#include "dsp/rx_raw_decim.h"
+
+#define RAW_BW        0.2     /* Protected bandwidth relative to the input rate. */
+#define RAW_ATTEN     60.0    /* Stop band attenuation in dB. */
+#define RAW_TAP_BITS  13      /* Fractional bits of the quantized taps. */
+#define RAW_BLOCK     2048    /* Output samples per block. */
+
+
+rx_raw_decim_cc_sptr make_rx_raw_decim_cc(raw_format format)
+{
+    return gnuradio::get_initial_sptr(new rx_raw_decim_cc(format));
+}
+
+/*! \brief Create a raw sample decimator.
+ *  \param format The sample format of the input.
+ *
+ * The samples are stored as 16 bit integers and the taps are 16 bit
+ * integers with RAW_TAP_BITS fractional bits, so the filter only needs
+ * 16x16 bit multiplications with 32 bit accumulators. The sum of the two
+ * samples sharing a tap must fit in 16 bits, so 16 bit samples lose their
+ * least significant bit, which is below the resolution of the ADCs in
+ * practice. 8 bit samples are scaled so that the offset of the unsigned
+ * format can be removed exactly.
+ */
+rx_raw_decim_cc::rx_raw_decim_cc(raw_format format)
+    : gr::sync_decimator ("rx_raw_decim_cc",
+          gr::io_signature::make(1, 1, raw_item_size(format)),
+          gr::io_signature::make(1, 1, sizeof(gr_complex)),
+          2),
+      d_format(format)
+{
+    std::vector<float> taps = rx_hb_decim_cc::halfband_taps(RAW_BW, RAW_ATTEN);
+    unsigned int i;
+
+    d_taps.resize(taps.size());
+    for (i = 0; i < taps.size(); i++)
+        d_taps[i] = (int16_t) floor(taps[i] * (1 << RAW_TAP_BITS) + 0.5);
+
+    d_hist = taps.size() - 1;
+    d_even.assign(2 * d_hist, 0);
+    d_odd.assign(2 * d_hist, 0);
+
+    switch (d_format)
+    {
+    case RAW_FORMAT_CU8:
+        // stored as 2*x-255
+        d_scale = 1.0 / (255.0 * (1 << RAW_TAP_BITS));
+        break;
+
+    case RAW_FORMAT_CS8:
+        d_scale = 1.0 / (128.0 * (1 << RAW_TAP_BITS));
+        break;
+
+    case RAW_FORMAT_CS16:
+    default:
+        // stored as x/2
+        d_scale = 1.0 / (16384.0 * (1 << RAW_TAP_BITS));
+        break;
+    }
+
+#ifndef QT_NO_DEBUG_OUTPUT
+    std::cout << "Raw decimator: format " << d_format << ", "
+              << 2 * d_taps.size() - 1 << " taps" << std::endl;
+#endif
+}
+
+rx_raw_decim_cc::~rx_raw_decim_cc()
+{
+
+}
+
+/*! \brief Get the size of one I/Q pair in a raw format. */
+size_t rx_raw_decim_cc::raw_item_size(raw_format format)
+{
+    return format == RAW_FORMAT_CS16 ? 2 * sizeof(int16_t) : 2 * sizeof(int8_t);
+}
+
+/*! \brief Convert raw samples and append them to the even and odd phases.
+ *  \param in The raw samples.
+ *  \param nin The number of I/Q pairs (even).
+ */
+void rx_raw_decim_cc::load(const void *in, unsigned int nin)
+{
+    int16_t      *ev, *od;
+    unsigned int  i;
+
+    d_even.resize(2 * d_hist + nin);
+    d_odd.resize(2 * d_hist + nin);
+    ev = &d_even[2 * d_hist];
+    od = &d_odd[2 * d_hist];
+
+    switch (d_format)
+    {
+    case RAW_FORMAT_CU8:
+    {
+        const uint8_t *x = (const uint8_t *) in;
+        for (i = 0; i < nin; i += 2)
+        {
+            ev[i]     = 2 * x[2 * i] - 255;
+            ev[i + 1] = 2 * x[2 * i + 1] - 255;
+            od[i]     = 2 * x[2 * i + 2] - 255;
+            od[i + 1] = 2 * x[2 * i + 3] - 255;
+        }
+        break;
+    }
+
+    case RAW_FORMAT_CS8:
+    {
+        const int8_t *x = (const int8_t *) in;
+        for (i = 0; i < nin; i += 2)
+        {
+            ev[i]     = x[2 * i];
+            ev[i + 1] = x[2 * i + 1];
+            od[i]     = x[2 * i + 2];
+            od[i + 1] = x[2 * i + 3];
+        }
+        break;
+    }
+
+    case RAW_FORMAT_CS16:
+    default:
+    {
+        const int16_t *x = (const int16_t *) in;
+        for (i = 0; i < nin; i += 2)
+        {
+            ev[i]     = x[2 * i] >> 1;
+            ev[i + 1] = x[2 * i + 1] >> 1;
+            od[i]     = x[2 * i + 2] >> 1;
+            od[i + 1] = x[2 * i + 3] >> 1;
+        }
+        break;
+    }
+    }
+}
+
+/*! \brief Integer halfband filter kernel.
+ *  \param acc Accumulators for n values.
+ *  \param ev Even samples.
+ *  \param od Odd samples starting at the center of the first output.
+ *  \param h The non-zero taps except the center.
+ *  \param m Number of taps in h minus one.
+ *  \param n Number of values to compute, i.e. 2 per output sample.
+ */
+static inline void hb_filter_int(int32_t *acc, const int16_t *ev,
+                                 const int16_t *od, const int16_t *h,
+                                 unsigned int m, unsigned int n)
+{
+    const int16_t *a, *b;
+    int16_t        g;
+    unsigned int   j, k;
+
+    for (j = 0; j < n; j++)
+        acc[j] = od[j] << (RAW_TAP_BITS - 1);
+
+    for (k = 0; k < (m + 1) / 2; k++)
+    {
+        a = ev + 2 * k;
+        b = ev + 2 * (m - k);
+        g = h[k];
+        for (j = 0; j < n; j++)
+            acc[j] += g * (int16_t) (a[j] + b[j]);
+    }
+}
+
+/*! \brief Run the halfband filter on the loaded samples.
+ *  \param nout The number of output samples, at most RAW_BLOCK.
+ *  \param out Output buffer.
+ *
+ * Same structure as rx_hb_decim_cc::filter_stage(): output j has the
+ * center tap on odd[j + (m-1)/2] and the other taps on even[j] ... even[j+m],
+ * with I and Q handled as two interleaved integer streams.
+ *
+ * The accumulators are on the stack and full blocks are computed with a
+ * constant length, which lets the compiler vectorize the kernel.
+ */
+void rx_raw_decim_cc::filter(unsigned int nout, gr_complex *out)
+{
+    unsigned int   m = d_taps.size() - 1;
+    int32_t        acc[2 * RAW_BLOCK];
+    float         *y = (float *) out;
+    unsigned int   n = 2 * nout;
+    unsigned int   j;
+
+    if (nout == RAW_BLOCK)
+        hb_filter_int(acc, &d_even[0], &d_odd[m - 1], &d_taps[0], m, 2 * RAW_BLOCK);
+    else
+        hb_filter_int(acc, &d_even[0], &d_odd[m - 1], &d_taps[0], m, n);
+
+    for (j = 0; j < n; j++)
+        y[j] = d_scale * acc[j];
+
+    // keep the history for the next block
+    memmove(&d_even[0], &d_even[n], 2 * d_hist * sizeof(int16_t));
+    memmove(&d_odd[0], &d_odd[n], 2 * d_hist * sizeof(int16_t));
+}
+
+int rx_raw_decim_cc::work(int noutput_items,
+                          gr_vector_const_void_star &input_items,
+                          gr_vector_void_star &output_items)
+{
+    const uint8_t *in = (const uint8_t *) input_items[0];
+    gr_complex    *out = (gr_complex *) output_items[0];
+    size_t         isize = raw_item_size(d_format);
+    unsigned int   j0, n;
+
+    for (j0 = 0; j0 < (unsigned int) noutput_items; j0 += RAW_BLOCK)
+    {
+        n = std::min((unsigned int) noutput_items - j0, (unsigned int) RAW_BLOCK);
+        load(in + 2 * j0 * isize, 2 * n);
+        filter(n, out + j0);
+    }
+
+    return noutput_items;
+}
@@ -0,0 +1,95 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           http://gqrx.dk/
+ *
+ * Copyright 2011-2014 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef RX_RAW_DECIM_H
+#define RX_RAW_DECIM_H
+
+#include <vector>
+#include <stdint.h>
+#include <gnuradio/sync_decimator.h>
+#include <gnuradio/gr_complex.h>
+
+
+class rx_raw_decim_cc;
+
+typedef boost::shared_ptr<rx_raw_decim_cc> rx_raw_decim_cc_sptr;
+
+/*! \brief Native sample formats of SDR hardware. */
+enum raw_format {
+    RAW_FORMAT_CU8  = 0,  /*!< Unsigned 8 bit I/Q, e.g. RTL-SDR. */
+    RAW_FORMAT_CS8  = 1,  /*!< Signed 8 bit I/Q, e.g. HackRF. */
+    RAW_FORMAT_CS16 = 2   /*!< Signed 16 bit I/Q, e.g. Airspy or USRP. */
+};
+
+
+/*! \brief Return a shared_ptr to a new instance of rx_raw_decim_cc.
+ *  \param format The sample format of the input.
+ */
+rx_raw_decim_cc_sptr make_rx_raw_decim_cc(raw_format format);
+
+
+/*! \brief Halfband decimator for raw integer I/Q samples.
+ *  \ingroup DSP
+ *
+ * This block takes the interleaved integer samples as they come from the
+ * hardware and decimates them by 2 using integer arithmetic. The result is
+ * converted to gr_complex scaled to +/-1.0 full scale, so the float samples,
+ * which take 4 or 2 times the space of the raw ones, are only created at
+ * half the input rate.
+ *
+ * The filter is a halfband filter with quantized taps that keeps aliases
+ * 60 dB down in the inner 80% of the output bandwidth.
+ *
+ * Use raw_item_size() to get the size of an input item, which is one I/Q
+ * pair.
+ */
+class rx_raw_decim_cc : public gr::sync_decimator
+{
+    friend rx_raw_decim_cc_sptr make_rx_raw_decim_cc(raw_format format);
+
+protected:
+    rx_raw_decim_cc(raw_format format);
+
+public:
+    ~rx_raw_decim_cc();
+
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items);
+
+    static size_t raw_item_size(raw_format format);
+
+private:
+    void load(const void *in, unsigned int nin);
+    void filter(unsigned int nout, gr_complex *out);
+
+private:
+    raw_format            d_format;  /*!< Input sample format. */
+    float                 d_scale;   /*!< Converts the filter output to float. */
+    std::vector<int16_t>  d_taps;    /*!< The non-zero taps except the center. */
+    unsigned int          d_hist;    /*!< History samples in each phase. */
+    std::vector<int16_t>  d_even;    /*!< History and new even samples, I and Q interleaved. */
+    std::vector<int16_t>  d_odd;     /*!< History and new odd samples, I and Q interleaved. */
+};
+
+
+#endif /* RX_RAW_DECIM_H */
@@ -26,24 +26,26 @@
 
 
 /* Return a shared_ptr to a new instance of sniffer_f */
-sniffer_f_sptr make_sniffer_f(int buffsize)
+sniffer_f_sptr make_sniffer_f(int buffsize, bool enabled)
 {
-    return gnuradio::get_initial_sptr(new sniffer_f(buffsize));
+    return gnuradio::get_initial_sptr(new sniffer_f(buffsize, enabled));
 }
 
 
 /*! \brief Create a sniffe_fr object.
  *  \param buffsize The internal buffer size.
+ *  \param enabled Whether samples should be collected.
  *
  * When choosing buffer size, the user of this class should take into account:
  *  - The input sample rate.
  *  - How ofter the data will be popped.
  */
-sniffer_f::sniffer_f(int buffsize)
+sniffer_f::sniffer_f(int buffsize, bool enabled)
     : gr::sync_block ("rx_fft_c",
           gr::io_signature::make(1, 1, sizeof(float)),
           gr::io_signature::make(0, 0, 0)),
-      d_minsamp(1000)
+      d_minsamp(1000),
+      d_enabled(enabled)
 {
 
     /* allocate circular buffer */
@@ -63,7 +65,7 @@ sniffer_f::~sniffer_f()
  *  \param output_items
  *
  * This method does nothing except dumping the incoming samples into the
- * circular buffer.
+ * circular buffer. The samples are discarded when the sniffer is disabled.
  */
 int sniffer_f::work(int noutput_items,
                     gr_vector_const_void_star &input_items,
@@ -74,6 +76,9 @@ int sniffer_f::work(int noutput_items,
 
     (void) output_items;
 
+    if (!d_enabled)
+        return noutput_items;
+
     boost::mutex::scoped_lock lock(d_mutex);
 
     /* dump new samples into the buffer */
@@ -145,3 +150,21 @@ int  sniffer_f::buffer_size()
 
     return d_buffer.capacity();
 }
+
+
+/*! \brief Enable or disable the sniffer.
+ *  \param enabled Whether incoming samples should be collected.
+ *
+ * The buffer is cleared when the sniffer is enabled so that the first
+ * samples returned by get_samples() are the ones that arrived after this
+ * call. This function can be called while the flow graph is running.
+ */
+void sniffer_f::set_enabled(bool enabled)
+{
+    if (enabled && !d_enabled)
+    {
+        boost::mutex::scoped_lock lock(d_mutex);
+        d_buffer.clear();
+    }
+    d_enabled = enabled;
+}
@@ -26,6 +26,7 @@
 #include <gnuradio/sync_block.h>
 #include <boost/thread/mutex.hpp>
 #include <boost/circular_buffer.hpp>
+#include <boost/atomic.hpp>
 
 
 class sniffer_f;
@@ -41,7 +42,7 @@ typedef boost::shared_ptr<sniffer_f> sniffer_f_sptr;
  * interface for creating new instances.
  *
  */
-sniffer_f_sptr make_sniffer_f(int buffsize=48000);
+sniffer_f_sptr make_sniffer_f(int buffsize=48000, bool enabled=true);
 
 
 /*! \brief Simple sink to allow accessing data in the flow graph.
@@ -54,13 +55,16 @@ sniffer_f_sptr make_sniffer_f(int buffsize=48000);
  * The class uses a circular buffer for internal storage and if the received samples
  * exceed the buffer size, old samples will be overwritten. The collected samples
  * can be accessed via the get_samples() method.
+ *
+ * The sniffer can stay connected while it is not used. Incoming samples are
+ * discarded until it is enabled with set_enabled().
  */
 class sniffer_f : public gr::sync_block
 {
-    friend sniffer_f_sptr make_sniffer_f(int buffsize);
+    friend sniffer_f_sptr make_sniffer_f(int buffsize, bool enabled);
 
 protected:
-    sniffer_f(int buffsize);
+    sniffer_f(int buffsize, bool enabled);
 
 public:
     ~sniffer_f();
@@ -78,11 +82,15 @@ public:
     void set_min_samples(unsigned int num) {d_minsamp = num;}
     int min_samples() {return d_minsamp;}
 
+    void set_enabled(bool enabled);
+    bool enabled() const {return d_enabled;}
+
 private:
 
     boost::mutex d_mutex;                   /*! Used to prevent concurrent access to buffer. */
     boost::circular_buffer<float> d_buffer; /*! buffer to accumulate samples. */
     unsigned int d_minsamp;                 /*! smallest number of samples we want to return. */
+    boost::atomic<bool> d_enabled;          /*! Whether samples are collected. */
 
 };
 
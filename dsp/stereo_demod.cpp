@@ -22,17 +22,20 @@
  * Boston, MA 02110-1301, USA.
  */
 #include <gnuradio/io_signature.h>
+#include <gnuradio/filter/firdes.h>
+#include <volk/volk.h>
 #include <math.h>
-#include <iostream>
+#include <string.h>
 #include <dsp/stereo_demod.h>
 
 
 /* Create a new instance of stereo_demod and return a boost shared_ptr. */
 stereo_demod_sptr make_stereo_demod(float quad_rate, float audio_rate,
-                                    bool stereo)
+                                    bool stereo, double tau)
 {
     return gnuradio::get_initial_sptr(new stereo_demod(quad_rate,
-                                                       audio_rate, stereo));
+                                                       audio_rate, stereo,
+                                                       tau));
 }
 
 
@@ -41,102 +44,89 @@ static const int MAX_IN  = 1; /* Maximum number of input streams. */
 static const int MIN_OUT = 2; /* Minimum number of output streams. */
 static const int MAX_OUT = 2; /* Maximum number of output streams. */
 
-#define STEREO_DEMOD_PARANOIC
+#define PILOT_FREQ      19000.0  /* Pilot tone frequency. */
+#define PILOT_RANGE     200.0    /* Max pilot frequency error in Hz. */
+#define PILOT_LPF_FREQ  300.0    /* Corner of the phase detector filters. */
+#define PILOT_LOOP_BW   15.0     /* PLL natural frequency in Hz. */
+#define AUDIO_CUTOFF    16.5e3   /* Audio filter cutoff. */
+#define AUDIO_TW        3.0e3    /* Audio filter transition width. */
+
+
+static unsigned int gcd(unsigned int a, unsigned int b)
+{
+    unsigned int t;
+
+    while (b)
+    {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
 
 /*! \brief Create stereo demodulator object.
  *
  * Use make_stereo_demod() instead.
+ *
+ * The audio rate must not be higher than the input rate.
  */
-stereo_demod::stereo_demod(float input_rate, float audio_rate, bool stereo)
-    : gr::hier_block2("stereo_demod",
-                     gr::io_signature::make (MIN_IN,  MAX_IN,  sizeof (float)),
-                     gr::io_signature::make (MIN_OUT, MAX_OUT, sizeof (float))),
+stereo_demod::stereo_demod(float input_rate, float audio_rate, bool stereo,
+                           double tau)
+    : gr::block("stereo_demod",
+                gr::io_signature::make (MIN_IN,  MAX_IN,  sizeof (float)),
+                gr::io_signature::make (MIN_OUT, MAX_OUT, sizeof (float))),
     d_input_rate(input_rate),
     d_audio_rate(audio_rate),
-    d_stereo(stereo)
+    d_stereo(stereo),
+    d_t(0),
+    d_freq(0.0),
+    d_lpf1(0.0, 0.0),
+    d_lpf2(0.0, 0.0),
+    d_tau(tau)
 {
-  lpf0 = make_lpf_ff(d_input_rate, 17e3, 2e3); // FIXME
-  audio_rr0 = make_resampler_ff(d_audio_rate/d_input_rate);
-
-  if (d_stereo)
-  {
-    lpf1 = make_lpf_ff(d_input_rate, 17e3, 2e3); // FIXME
-    audio_rr1 = make_resampler_ff(d_audio_rate/d_input_rate);
-
-    d_tone_taps = gr::filter::firdes::complex_band_pass(
-                                       1.0,          // gain,
-		                                   d_input_rate, // sampling_freq
-                                       18800.,       // low_cutoff_freq
-                                       19200.,       // high_cutoff_freq
-                                       300.);        // transition_width
-    tone = gr::filter::fir_filter_fcc::make(1, d_tone_taps);
-
-    pll = gr::analog::pll_refout_cc::make(0.001,                        // loop_bw FIXME
-                                2*M_PI * 19200 / input_rate,  // max_freq
-                                2*M_PI * 18800 / input_rate); // min_freq
-
-    subtone = gr::blocks::multiply_cc::make();
-
-    lo = gr::blocks::complex_to_imag::make();
-
-#ifdef STEREO_DEMOD_PARANOIC
-    d_pll_taps = gr::filter::firdes::band_pass(
-                                       1.0,          // gain,
-		                                   d_input_rate, // sampling_freq
-                                       37600.,       // low_cutoff_freq
-                                       38400.,       // high_cutoff_freq
-                                       400.);        // transition_width
-    lo2 = gr::filter::fir_filter_fff::make(1, d_pll_taps);
-#endif
-
-    mixer = gr::blocks::multiply_ff::make();
-
-    cdp = gr::blocks::multiply_const_ff::make( 2.); // FIXME
-    cdm = gr::blocks::multiply_const_ff::make(-2.); // FIXME
-
-    add0 = gr::blocks::add_ff::make();
-    add1 = gr::blocks::add_ff::make();
-
-    /* connect block */
-    connect(self(), 0, tone, 0);
-    connect(tone, 0, pll, 0);
-    connect(pll, 0, subtone, 0);
-    connect(pll, 0, subtone, 1);
-    connect(subtone, 0, lo, 0);
-
-#ifdef STEREO_DEMOD_PARANOIC
-    connect(lo,  0, lo2, 0);
-    connect(lo2, 0, mixer, 0);
-#else
-    connect(lo, 0, mixer, 0);
-#endif
-    connect(self(), 0, mixer, 1);
-
-    connect(self(), 0, lpf0, 0);
-    connect(mixer,  0, lpf1, 0);
-
-    connect(lpf0, 0, audio_rr0, 0); // sum
-    connect(lpf1, 0, audio_rr1, 0);
-
-    connect(audio_rr1, 0, cdp,  0); // +delta
-    connect(audio_rr1, 0, cdm,  0); // -delta
-
-    connect(audio_rr0, 0, add0,   0);
-    connect(cdp,       0, add0,   1);
-    connect(add0,      0, self(), 0); // left = sum + delta
-
-    connect(audio_rr0, 0, add1,   0);
-    connect(cdm,       0, add1,   1);
-    connect(add1,      0, self(), 1); // right = sum + delta
-  }
-  else // if (!d_stereo)
-  {
-    /* connect block */
-    connect(self(), 0, lpf0, 0);
-    connect(lpf0,   0, audio_rr0, 0);
-    connect(audio_rr0, 0, self(), 0);
-    connect(audio_rr0, 0, self(), 1);
-  }
+    std::vector<float> taps;
+    unsigned int in_rate = (unsigned int) floor(input_rate + 0.5);
+    unsigned int out_rate = (unsigned int) floor(audio_rate + 0.5);
+    unsigned int g = gcd(in_rate, out_rate);
+    unsigned int p, j, k;
+    double wn;
+
+    /* polyphase filter bank */
+    d_interp = out_rate / g;
+    d_decim = in_rate / g;
+    taps = gr::filter::firdes::low_pass(d_interp, d_interp * d_input_rate,
+                                        AUDIO_CUTOFF, AUDIO_TW);
+    d_ntaps = (taps.size() + d_interp - 1) / d_interp;
+    d_taps.assign(d_interp * d_ntaps, 0.0);
+    for (p = 0; p < d_interp; p++)
+    {
+        for (j = 0; j < d_ntaps; j++)
+        {
+            k = p + j * d_interp;
+            if (k < taps.size())
+                d_taps[p * d_ntaps + d_ntaps - 1 - j] = taps[k];
+        }
+    }
+    d_sum.assign(d_ntaps - 1, 0.0);
+    d_delta.assign(d_ntaps - 1, 0.0);
+    set_relative_rate((double) d_interp / (double) d_decim);
+
+    /* pilot PLL, critically damped second order loop */
+    d_nco = gr_complex(1.0, 0.0);
+    d_nco_inc = std::polar(1.0f, (float)(2.0 * M_PI * PILOT_FREQ / d_input_rate));
+    d_max_freq = 2.0 * M_PI * PILOT_RANGE / d_input_rate;
+    d_lpf_gain = 1.0 - exp(-2.0 * M_PI * PILOT_LPF_FREQ / d_input_rate);
+    wn = 2.0 * M_PI * PILOT_LOOP_BW / d_input_rate;
+    d_alpha = 2.0 * 0.707 * wn;
+    d_beta = wn * wn;
+
+    /* de-emphasis */
+    d_x1[0] = d_x1[1] = 0.0;
+    d_y1[0] = d_y1[1] = 0.0;
+    calculate_iir_taps(tau);
 }
 
 
@@ -145,3 +135,180 @@ stereo_demod::~stereo_demod()
 
 }
 
+
+void stereo_demod::forecast(int noutput_items, gr_vector_int &ninput_items_required)
+{
+    ninput_items_required[0] = (d_t + (noutput_items - 1) * d_decim) / d_interp + 1;
+}
+
+
+/*! \brief Decode the stereo multiplex signal.
+ *
+ * d_t is the position of the next output sample relative to the first new
+ * input sample in units of 1/interp input samples. Only the input samples
+ * up to the last one used by an output sample are consumed, so that the
+ * PLL never runs twice over the same samples.
+ */
+int stereo_demod::general_work(int noutput_items,
+                               gr_vector_int &ninput_items,
+                               gr_vector_const_void_star &input_items,
+                               gr_vector_void_star &output_items)
+{
+    const float *in = (const float *) input_items[0];
+    float *out0 = (float *) output_items[0];
+    float *out1 = (float *) output_items[1];
+    unsigned int nin = ninput_items[0];
+    unsigned int hist = d_ntaps - 1;
+    unsigned int nout, nused, k, t, ch;
+    float sum, delta = 0.0;
+    float x, y;
+    double tau = d_tau;
+
+    if (tau != d_cur_tau)
+        calculate_iir_taps(tau);
+
+    if (d_t >= nin * d_interp)
+    {
+        nout = 0;
+        nused = nin;
+    }
+    else
+    {
+        nout = (nin * d_interp - 1 - d_t) / d_decim + 1;
+        if (nout > (unsigned int) noutput_items)
+            nout = noutput_items;
+        nused = (d_t + (nout - 1) * d_decim) / d_interp + 1;
+    }
+
+    d_sum.resize(hist + nused);
+    memcpy(&d_sum[hist], in, nused * sizeof(float));
+    if (d_stereo)
+    {
+        d_delta.resize(hist + nused);
+        pll(in, &d_delta[hist], nused);
+    }
+
+    for (k = 0; k < nout; k++)
+    {
+        t = d_t + k * d_decim;
+        volk_32f_x2_dot_prod_32f(&sum, &d_sum[t / d_interp],
+                                 &d_taps[(t % d_interp) * d_ntaps], d_ntaps);
+        if (d_stereo)
+            volk_32f_x2_dot_prod_32f(&delta, &d_delta[t / d_interp],
+                                     &d_taps[(t % d_interp) * d_ntaps], d_ntaps);
+        out0[k] = sum + delta;  // left = sum + delta
+        out1[k] = sum - delta;  // right = sum - delta
+    }
+
+    /* de-emphasis */
+    if (d_cur_tau > 1.0e-9)
+    {
+        for (ch = 0; ch < 2; ch++)
+        {
+            float *out = ch ? out1 : out0;
+
+            for (k = 0; k < nout; k++)
+            {
+                x = out[k];
+                y = d_b * (x + d_x1[ch]) + d_p * d_y1[ch];
+                d_x1[ch] = x;
+                d_y1[ch] = y;
+                out[k] = y;
+            }
+        }
+    }
+
+    memmove(&d_sum[0], &d_sum[nused], hist * sizeof(float));
+    if (d_stereo)
+        memmove(&d_delta[0], &d_delta[nused], hist * sizeof(float));
+
+    d_t = d_t + nout * d_decim - nused * d_interp;
+
+    consume_each(nused);
+    return nout;
+}
+
+
+/*! \brief Set de-emphasis time constant.
+ *  \param tau The new time constant (0.0 disables de-emphasis).
+ *
+ * The filter taps are recalculated by the next call to general_work().
+ */
+void stereo_demod::set_tau(double tau)
+{
+    d_tau = tau > 1.0e-9 ? tau : 0.0;
+}
+
+
+/*! \brief Run the pilot PLL and demodulate the L-R signal.
+ *  \param in The multiplex signal.
+ *  \param delta Output buffer for L-R.
+ *  \param n The number of samples.
+ *
+ * The oscillator is advanced by the nominal pilot frequency plus a small
+ * correction. The correction is at most a few hundred Hz, so its phasor is
+ * approximated by 1 + j*phi - phi^2/2 and the oscillator amplitude is
+ * normalized every 256 samples.
+ */
+void stereo_demod::pll(const float *in, float *delta, unsigned int n)
+{
+    gr_complex nco = d_nco;
+    gr_complex lpf1 = d_lpf1;
+    gr_complex lpf2 = d_lpf2;
+    float freq = d_freq;
+    float err, phi, mag;
+    unsigned int i;
+
+    for (i = 0; i < n; i++)
+    {
+        /* The oscillator locks to cos(phi) = sin(w*t) of the pilot, so the
+         * sin(2*w*t) subcarrier is -sin(2*phi) = -2*cos(phi)*sin(phi). The
+         * extra factor 2 gives L-R at the same level as L+R.
+         */
+        delta[i] = -4.0 * in[i] * nco.real() * nco.imag();
+
+        /* phase detector */
+        lpf1 += d_lpf_gain * (in[i] * conj(nco) - lpf1);
+        lpf2 += d_lpf_gain * (lpf1 - lpf2);
+        mag = abs(lpf2);
+        err = mag > 1.0e-9 ? lpf2.imag() / mag : 0.0;
+
+        /* loop filter */
+        freq += d_beta * err;
+        if (freq > d_max_freq)
+            freq = d_max_freq;
+        else if (freq < -d_max_freq)
+            freq = -d_max_freq;
+        phi = freq + d_alpha * err;
+
+        nco *= d_nco_inc * gr_complex(1.0 - 0.5 * phi * phi, phi);
+        if ((i & 255) == 255)
+            nco /= abs(nco);
+    }
+
+    d_nco = nco / abs(nco);
+    d_lpf1 = lpf1;
+    d_lpf2 = lpf2;
+    d_freq = freq;
+}
+
+
+/*! \brief Calculate taps for the de-emphasis IIR filters at the audio rate. */
+void stereo_demod::calculate_iir_taps(double tau)
+{
+    double w_p, w_pp;
+
+    d_cur_tau = tau > 1.0e-9 ? tau : 0.0;
+    if (d_cur_tau == 0.0)
+    {
+        d_x1[0] = d_x1[1] = 0.0;
+        d_y1[0] = d_y1[1] = 0.0;
+        return;
+    }
+
+    w_p = 1.0/tau;
+    w_pp = tan(w_p / (d_audio_rate * 2.0)); /* prewarped analog freq */
+
+    d_b = w_pp/(1 + w_pp);
+    d_p = (1 - w_pp)/(1 + w_pp);
+}
@@ -24,19 +24,10 @@
 #ifndef STEREO_DEMOD_H
 #define STEREO_DEMOD_H
 
-#include <gnuradio/hier_block2.h>
-#include <gnuradio/filter/firdes.h>
-#include <gnuradio/filter/fir_filter_fcc.h>
-#include <gnuradio/filter/fir_filter_fff.h>
-#include <gnuradio/analog/pll_refout_cc.h>
-#include <gnuradio/blocks/multiply_cc.h>
-#include <gnuradio/blocks/multiply_ff.h>
-#include <gnuradio/blocks/multiply_const_ff.h>
-#include <gnuradio/blocks/complex_to_imag.h>
-#include <gnuradio/blocks/add_ff.h>
+#include <gnuradio/block.h>
+#include <gnuradio/gr_complex.h>
+#include <boost/atomic.hpp>
 #include <vector>
-#include "dsp/lpf.h"
-#include "dsp/resampler_xx.h"
 
  
 class stereo_demod;
@@ -48,6 +39,7 @@ typedef boost::shared_ptr<stereo_demod> stereo_demod_sptr;
  *  \param quad_rate The input sample rate.
  *  \param audio_rate The audio rate.
  *  \param stereo On/off stereo mode.
+ *  \param tau De-emphasis time constant in seconds (0.0 disables).
  *
  * This is effectively the public constructor. To avoid accidental use
  * of raw pointers, stereo_demod's constructor is private.
@@ -55,50 +47,86 @@ typedef boost::shared_ptr<stereo_demod> stereo_demod_sptr;
  */
 stereo_demod_sptr make_stereo_demod(float quad_rate=120e3,
                                     float audio_rate=48e3,
-                                    bool stereo=true);
+                                    bool stereo=true,
+                                    double tau=50.0e-6);
 
 
 /*! \brief FM stereo demodulator.
  *  \ingroup DSP
  *
  * This class implements the stereo demodulator for 87.5...108 MHz band.
+ * The input is the FM multiplex signal, the outputs are the left and right
+ * audio channels at the audio rate. Everything is done in one pass:
  *
+ *  - A PLL locks to the 19 kHz pilot. The phase detector mixes the input
+ *    to 0 Hz and low pass filters it with two one pole filters, so no band
+ *    pass filter is needed to extract the pilot.
+ *  - The 38 kHz subcarrier is the square of the locked oscillator, which
+ *    gives the L-R signal when multiplied with the input.
+ *  - L+R and L-R are filtered and resampled directly to the audio rate
+ *    with one polyphase filter bank, evaluated only at the output samples.
+ *  - The channels are matrixed and de-emphasized at the audio rate.
+ *
+ * In mono mode only L+R is computed and sent to both outputs.
  */
-class stereo_demod : public gr::hier_block2
+class stereo_demod : public gr::block
 {
     friend stereo_demod_sptr make_stereo_demod(float input_rate,
                                                float audio_rate,
-                                               bool stereo);
+                                               bool stereo,
+                                               double tau);
 
 protected:
-    stereo_demod(float input_rate, float audio_rate, bool stereo);
+    stereo_demod(float input_rate, float audio_rate, bool stereo, double tau);
 
 public:
     ~stereo_demod();
 
+    void forecast(int noutput_items, gr_vector_int &ninput_items_required);
+
+    int general_work(int noutput_items,
+                     gr_vector_int &ninput_items,
+                     gr_vector_const_void_star &input_items,
+                     gr_vector_void_star &output_items);
+
+    void set_tau(double tau);
+
 private:
-    /* GR blocks */
-    gr::filter::fir_filter_fcc::sptr  tone;  /*!< Pilot tone BPF. */
-    gr::analog::pll_refout_cc::sptr   pll;   /*!< Pilot tone PLL. */
-    gr::blocks::multiply_cc::sptr subtone;   /*!< Stereo subtone. */
-    gr::blocks::complex_to_imag::sptr lo;    /*!< Complex tone imag. */
-    gr::filter::fir_filter_fff::sptr  lo2;   /*!< Subtone BPF. */
-    gr::blocks::multiply_ff::sptr mixer;     /*!< Balance mixer. */
-    lpf_ff_sptr lpf0;              /*!< Low-pass filter #0. */
-    lpf_ff_sptr lpf1;              /*!< Low-pass filter #1. */
-    resampler_ff_sptr audio_rr0;   /*!< Audio resampler #0. */
-    resampler_ff_sptr audio_rr1;   /*!< Audio resampler #1. */
-    gr::blocks::multiply_const_ff::sptr cdp; /*!< Channel delta (plus). */
-    gr::blocks::multiply_const_ff::sptr cdm; /*!< Channel delta (minus). */
-    gr::blocks::add_ff::sptr add0;           /*!< Left stereo channel. */
-    gr::blocks::add_ff::sptr add1;           /*!< Right stereo channel. */
+    void pll(const float *in, float *delta, unsigned int n);
+    void calculate_iir_taps(double tau);
 
     /* other parameters */
     float d_input_rate;                  /*! Input rate. */
     float d_audio_rate;                  /*! Audio rate. */
     bool  d_stereo;                      /*! On/off stereo mode. */
-    std::vector<gr_complex> d_tone_taps; /*! Tone BPF taps. */
-    std::vector<float> d_pll_taps;       /*! Subtone BPF taps. */
+
+    /* polyphase resampler */
+    unsigned int d_interp;               /*! Interpolation factor. */
+    unsigned int d_decim;                /*! Decimation factor. */
+    unsigned int d_ntaps;                /*! Taps per phase. */
+    std::vector<float> d_taps;           /*! Taps of each phase in reverse order. */
+    unsigned int d_t;                    /*! Position of next output, in units of 1/interp input samples. */
+    std::vector<float> d_sum;            /*! History followed by new L+R samples. */
+    std::vector<float> d_delta;          /*! History followed by new L-R samples. */
+
+    /* pilot PLL */
+    gr_complex d_nco;                    /*! Oscillator locked to the pilot. */
+    gr_complex d_nco_inc;                /*! Nominal 19 kHz phase increment. */
+    float d_freq;                        /*! Frequency offset in rad/sample. */
+    float d_max_freq;                    /*! Frequency offset limit in rad/sample. */
+    float d_alpha;                       /*! Loop filter proportional gain. */
+    float d_beta;                        /*! Loop filter integral gain. */
+    float d_lpf_gain;                    /*! Phase detector low pass filter gain. */
+    gr_complex d_lpf1;                   /*! Phase detector filter state #1. */
+    gr_complex d_lpf2;                   /*! Phase detector filter state #2. */
+
+    /* de-emphasis */
+    boost::atomic<double> d_tau;         /*! Time constant requested by the user. */
+    double d_cur_tau;                    /*! Time constant currently in use. */
+    float  d_b;                          /*! De-emphasis feed forward tap. */
+    float  d_p;                          /*! De-emphasis pole. */
+    float  d_x1[2];                      /*! Previous input of each channel. */
+    float  d_y1[2];                      /*! Previous output of each channel. */
 };
 
 
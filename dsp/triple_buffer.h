@@ -0,0 +1,114 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           http://gqrx.dk/
+ *
+ * Copyright 2011-2014 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <vector>
+#include <boost/atomic.hpp>
+
+
+/*! \brief Lock-free triple buffer.
+ *  \ingroup DSP
+ *
+ * Passes blocks of data from one writer thread to one reader thread
+ * without either side ever waiting for the other. The writer fills the
+ * back buffer and publishes it; the reader picks up the most recently
+ * published buffer. Buffers published while the reader is busy replace
+ * each other, so the reader always sees the latest data.
+ *
+ * The writer asks for a back buffer of a given size and tells how many
+ * items are valid when publishing. Buffers are only ever resized by the
+ * writer while it owns them, so the reader can rely on the front buffer
+ * until its next fetch().
+ */
+template <class T>
+class triple_buffer
+{
+public:
+    triple_buffer(unsigned int capacity = 0)
+        : d_state(0),
+          d_back(1),
+          d_front(2)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            d_buf[i].resize(capacity);
+            d_size[i] = 0;
+        }
+    }
+
+    /*! \brief Get the buffer owned by the writer.
+     *  \param size The minimum number of items the buffer must hold.
+     */
+    T *back(unsigned int size)
+    {
+        if (d_buf[d_back].size() < size)
+            d_buf[d_back].resize(size);
+
+        return &d_buf[d_back][0];
+    }
+
+    /*! \brief Publish the back buffer and get a new one.
+     *  \param size The number of valid items in the back buffer.
+     */
+    void publish(unsigned int size)
+    {
+        d_size[d_back] = size;
+        unsigned int state = d_state.exchange(d_back | FRESH, boost::memory_order_acq_rel);
+        d_back = state & INDEX;
+    }
+
+    /*! \brief Make the latest published buffer available to the reader.
+     *  \return True if there was a new buffer, false if the front buffer
+     *          is unchanged since the last call.
+     */
+    bool fetch(void)
+    {
+        if (!(d_state.load(boost::memory_order_acquire) & FRESH))
+            return false;
+
+        unsigned int state = d_state.exchange(d_front, boost::memory_order_acq_rel);
+        d_front = state & INDEX;
+
+        return true;
+    }
+
+    /*! \brief Get the buffer owned by the reader. */
+    const T *front(void) const { return &d_buf[d_front][0]; }
+
+    /*! \brief Get the number of valid items in the front buffer. */
+    unsigned int front_size(void) const { return d_size[d_front]; }
+
+private:
+    static const unsigned int INDEX = 0x3;  /*! Index of the middle buffer. */
+    static const unsigned int FRESH = 0x4;  /*! Middle buffer not yet fetched. */
+
+    std::vector<T>  d_buf[3];
+    unsigned int    d_size[3];
+
+    boost::atomic<unsigned int> d_state;  /*! Middle buffer index and fresh flag. */
+    unsigned int    d_back;               /*! Owned by the writer. */
+    unsigned int    d_front;              /*! Owned by the reader. */
+};
+
+#endif // TRIPLE_BUFFER_H
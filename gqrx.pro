@@ -86,17 +86,23 @@ SOURCES += \
     dsp/afsk1200/costabf.c \
     dsp/agc_impl.cpp \
     dsp/correct_iq_cc.cpp \
+    dsp/filter_crossover.cpp \
     dsp/lpf.cpp \
     dsp/resampler_xx.cpp \
     dsp/rx_demod_am.cpp \
     dsp/rx_demod_fm.cpp \
+    dsp/rx_demod_selector.cpp \
     dsp/rx_fft.cpp \
     dsp/rx_filter.cpp \
+    dsp/rx_hb_decim.cpp \
     dsp/rx_meter.cpp \
     dsp/rx_agc_xx.cpp \
+    dsp/rx_channelizer.cpp \
     dsp/rx_noise_blanker_cc.cpp \
+    dsp/rx_raw_decim.cpp \
     dsp/sniffer_f.cpp \
     dsp/stereo_demod.cpp \
+    interfaces/raw_source.cpp \
     interfaces/udp_sink_f.cpp \
     qtgui/afsk1200win.cpp \
     qtgui/agc_options.cpp \
@@ -117,6 +123,7 @@ SOURCES += \
     qtgui/nb_options.cpp \
     qtgui/plotter.cpp \
     qtgui/qtcolorpicker.cpp \
+    qtgui/waterfallhistory.cpp \
     receivers/nbrx.cpp \
     receivers/receiver_base.cpp \
     receivers/wfmrx.cpp
@@ -132,17 +139,24 @@ HEADERS += \
     dsp/afsk1200/filter-i386.h \
     dsp/agc_impl.h \
     dsp/correct_iq_cc.h \
+    dsp/filter_crossover.h \
     dsp/lpf.h \
     dsp/resampler_xx.h \
     dsp/rx_agc_xx.h \
+    dsp/rx_channelizer.h \
     dsp/rx_demod_am.h \
     dsp/rx_demod_fm.h \
+    dsp/rx_demod_selector.h \
     dsp/rx_fft.h \
     dsp/rx_filter.h \
+    dsp/rx_hb_decim.h \
     dsp/rx_meter.h \
     dsp/rx_noise_blanker_cc.h \
+    dsp/rx_raw_decim.h \
     dsp/sniffer_f.h \
     dsp/stereo_demod.h \
+    dsp/triple_buffer.h \
+    interfaces/raw_source.h \
     interfaces/udp_sink_f.h \
     qtgui/afsk1200win.h \
     qtgui/agc_options.h \
@@ -163,6 +177,7 @@ HEADERS += \
     qtgui/nb_options.h \
     qtgui/plotter.h \
     qtgui/qtcolorpicker.h \
+    qtgui/waterfallhistory.h \
     receivers/nbrx.h \
     receivers/receiver_base.h \
     receivers/wfmrx.h
@@ -211,15 +226,17 @@ PKGCONFIG += gnuradio-analog \
              gnuradio-blocks \
              gnuradio-filter \
              gnuradio-fft \
-             gnuradio-osmosdr
+             gnuradio-osmosdr \
+             volk
 
 unix:!macx {
     LIBS += -lboost_system$$BOOST_SUFFIX -lboost_program_options$$BOOST_SUFFIX
+    LIBS += -lboost_thread$$BOOST_SUFFIX
     LIBS += -lrt  # need to include on some distros
 }
 
 macx {
-    LIBS += -lboost_system-mt -lboost_program_options-mt
+    LIBS += -lboost_system-mt -lboost_program_options-mt -lboost_thread-mt
 }
 
 OTHER_FILES += \
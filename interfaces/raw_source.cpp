@@ -0,0 +1,205 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           http://gqrx.dk/
+ *
+ * Copyright 2011-2014 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <stdint.h>
+#include <gnuradio/io_signature.h>
+#include <gnuradio/sync_block.h>
+#include "interfaces/raw_source.h"
+
+
+/*! \brief Split an osmosdr style argument string into key/value pairs. */
+static std::map<std::string, std::string> parse_args(const std::string &args)
+{
+    std::map<std::string, std::string> res;
+    std::string::size_type start = 0, end, eq;
+    std::string item;
+
+    while (start <= args.size())
+    {
+        end = args.find(',', start);
+        if (end == std::string::npos)
+            end = args.size();
+
+        item = args.substr(start, end - start);
+        eq = item.find('=');
+        if (eq != std::string::npos)
+            res[item.substr(0, eq)] = item.substr(eq + 1);
+        else if (!item.empty())
+            res[item] = "";
+
+        start = end + 1;
+    }
+
+    return res;
+}
+
+
+/*! \brief Test signal in a raw sample format.
+ *
+ * Generates a strong carrier at rate/8, a weak one at -0.3*rate and
+ * noise, quantized like an ADC would do it. The weak carrier is in the
+ * band that is removed by the first decimation.
+ */
+class raw_test_source : public gr::sync_block
+{
+public:
+    raw_test_source(raw_format format)
+        : gr::sync_block ("raw_test_source",
+              gr::io_signature::make(0, 0, 0),
+              gr::io_signature::make(1, 1, rx_raw_decim_cc::raw_item_size(format))),
+          d_format(format),
+          d_phase0(0.0),
+          d_phase1(0.0),
+          d_seed(1)
+    {
+    }
+
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items)
+    {
+        double  x[2];
+        int     i, k;
+
+        (void) input_items;
+
+        for (i = 0; i < noutput_items; i++)
+        {
+            x[0] = 0.3 * cos(d_phase0) + 0.01 * cos(d_phase1) + noise();
+            x[1] = 0.3 * sin(d_phase0) + 0.01 * sin(d_phase1) + noise();
+            d_phase0 = fmod(d_phase0 + 2.0 * M_PI / 8.0, 2.0 * M_PI);
+            d_phase1 = fmod(d_phase1 - 2.0 * M_PI * 0.3, 2.0 * M_PI);
+
+            for (k = 0; k < 2; k++)
+            {
+                switch (d_format)
+                {
+                case RAW_FORMAT_CU8:
+                    ((uint8_t *) output_items[0])[2 * i + k] =
+                            (uint8_t) floor(127.5 + 127.0 * x[k] + 0.5);
+                    break;
+                case RAW_FORMAT_CS8:
+                    ((int8_t *) output_items[0])[2 * i + k] =
+                            (int8_t) floor(127.0 * x[k] + 0.5);
+                    break;
+                case RAW_FORMAT_CS16:
+                default:
+                    ((int16_t *) output_items[0])[2 * i + k] =
+                            (int16_t) floor(32767.0 * x[k] + 0.5);
+                    break;
+                }
+            }
+        }
+
+        return noutput_items;
+    }
+
+private:
+    /* Uniform noise from a linear congruential generator. */
+    double noise(void)
+    {
+        d_seed = d_seed * 1103515245u + 12345u;
+        return 0.02 * ((d_seed >> 16) / 32768.0 - 1.0);
+    }
+
+    raw_format  d_format;
+    double      d_phase0;
+    double      d_phase1;
+    uint32_t    d_seed;
+};
+
+
+raw_source_sptr make_raw_source(const std::string &args)
+{
+    return gnuradio::get_initial_sptr(new raw_source(args));
+}
+
+bool is_raw_source(const std::string &args)
+{
+    return args.compare(0, 4, "raw=") == 0;
+}
+
+raw_source::raw_source(const std::string &args)
+    : gr::hier_block2 ("raw_source",
+          gr::io_signature::make(0, 0, 0),
+          gr::io_signature::make(1, 1, sizeof(gr_complex))),
+      d_raw_rate(2.4e6),
+      d_format(RAW_FORMAT_CU8)
+{
+    std::map<std::string, std::string> kv = parse_args(args);
+    std::string dev = kv["raw"];
+    size_t isize;
+
+    if (kv["format"] == "cs8")
+        d_format = RAW_FORMAT_CS8;
+    else if (kv["format"] == "cs16")
+        d_format = RAW_FORMAT_CS16;
+
+    if (!kv["rate"].empty())
+        d_raw_rate = atof(kv["rate"].c_str());
+
+    isize = rx_raw_decim_cc::raw_item_size(d_format);
+    d_thr = gr::blocks::throttle::make(isize, d_raw_rate);
+    d_decim = make_rx_raw_decim_cc(d_format);
+
+    if (dev == "test")
+    {
+        d_test = gnuradio::get_initial_sptr(new raw_test_source(d_format));
+        connect(d_test, 0, d_thr, 0);
+    }
+    else
+    {
+        d_file = gr::blocks::file_source::make(isize, dev.c_str(),
+                                               kv["repeat"] == "true");
+        connect(d_file, 0, d_thr, 0);
+    }
+
+    connect(d_thr, 0, d_decim, 0);
+    connect(d_decim, 0, self(), 0);
+
+#ifndef QT_NO_DEBUG_OUTPUT
+    std::cout << "Raw source: " << dev << ", format " << d_format
+              << ", rate " << d_raw_rate << std::endl;
+#endif
+}
+
+raw_source::~raw_source()
+{
+
+}
+
+/*! \brief Seek in the input file.
+ *  \param pos The position in raw samples.
+ *  \param whence SEEK_SET, SEEK_CUR or SEEK_END.
+ *  \return true if successful, false if not reading from a file.
+ */
+bool raw_source::seek(long pos, int whence)
+{
+    if (!d_file)
+        return false;
+
+    return d_file->seek(pos, whence);
+}
@@ -0,0 +1,87 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           http://gqrx.dk/
+ *
+ * Copyright 2011-2014 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef RAW_SOURCE_H
+#define RAW_SOURCE_H
+
+#include <string>
+#include <gnuradio/hier_block2.h>
+#include <gnuradio/blocks/file_source.h>
+#include <gnuradio/blocks/throttle.h>
+#include "dsp/rx_raw_decim.h"
+
+
+class raw_source;
+
+typedef boost::shared_ptr<raw_source> raw_source_sptr;
+
+/*! \brief Return a shared_ptr to a new instance of raw_source.
+ *  \param args The device arguments, see raw_source.
+ */
+raw_source_sptr make_raw_source(const std::string &args);
+
+/*! \brief Check whether a device string refers to a raw_source. */
+bool is_raw_source(const std::string &args);
+
+
+/*! \brief I/Q source for samples in the native format of the hardware.
+ *  \ingroup IO
+ *
+ * This source reads cu8, cs8 or cs16 samples and decimates them by 2 with
+ * rx_raw_decim_cc before they are converted to gr_complex. The arguments
+ * use the same key=value syntax as the osmosdr device strings:
+ *
+ *   raw=<file name>,format=cu8|cs8|cs16,rate=<Hz>,repeat=true|false
+ *   raw=test,format=cu8|cs8|cs16,rate=<Hz>
+ *
+ * rate is the sample rate of the raw samples; the output rate is half of
+ * that. The "test" device is a stand-in for real hardware that generates a
+ * few carriers in noise quantized to the given format. Both are throttled
+ * to the given rate.
+ */
+class raw_source : public gr::hier_block2
+{
+    friend raw_source_sptr make_raw_source(const std::string &args);
+
+protected:
+    raw_source(const std::string &args);
+
+public:
+    ~raw_source();
+
+    double sample_rate(void) const { return d_raw_rate / 2.0; }
+    double raw_rate(void) const { return d_raw_rate; }
+    raw_format format(void) const { return d_format; }
+
+    bool seek(long pos, int whence);
+
+private:
+    double      d_raw_rate;  /*!< Sample rate of the raw samples. */
+    raw_format  d_format;    /*!< Sample format. */
+
+    gr::blocks::file_source::sptr  d_file;    /*!< File source, if reading from a file. */
+    gr::block_sptr                 d_test;    /*!< Test signal, if not reading from a file. */
+    gr::blocks::throttle::sptr     d_thr;     /*!< Keeps the rate in real time. */
+    rx_raw_decim_cc_sptr           d_decim;   /*!< First decimation and conversion. */
+};
+
+#endif // RAW_SOURCE_H
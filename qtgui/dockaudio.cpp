@@ -51,6 +51,7 @@ DockAudio::DockAudio(QWidget *parent) :
     ui->audioSpectrum->setPercent2DScreen(100);
     ui->audioSpectrum->setFreqUnits(1000);
     ui->audioSpectrum->setSampleRate(48000);  // Full bandwidth
+    ui->audioSpectrum->setFftDataRange(0, 24000);  // Audio FFT is a half spectrum
     ui->audioSpectrum->setSpanFreq(12000);
     ui->audioSpectrum->setCenterFreq(0);
     ui->audioSpectrum->setFftCenterFreq(6000);
@@ -82,7 +83,7 @@ void DockAudio::setFftRange(quint64 minf, quint64 maxf)
     }
 }
 
-void DockAudio::setNewFttData(double *fftData, int size)
+void DockAudio::setNewFttData(float *fftData, int size)
 {
     ui->audioSpectrum->setNewFttData(fftData, size);
 }
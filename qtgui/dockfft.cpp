@@ -31,6 +31,11 @@
 #define DEFAULT_FFT_SIZE  2048
 #define DEFAULT_FFT_SPLIT 50
 #define DEFAULT_FFT_AVG   50
+#define DEFAULT_FFT_AVG_MODE 0
+#define DEFAULT_FFT_OVERLAP  0    /* index, i.e. off */
+#define DEFAULT_WF_RATE      0    /* index, i.e. FFT rate */
+#define DEFAULT_WF_MODE      0    /* index, i.e. average */
+#define DEFAULT_WF_HISTORY   2    /* index, i.e. 40 MB */
 
 
 DockFft::DockFft(QWidget *parent) :
@@ -63,6 +68,36 @@ DockFft::~DockFft()
 }
 
 
+/*! \brief Get current FFT overlap setting.
+ *  \return The overlap in percent or -1 if continuous FFT is off.
+ */
+int DockFft::fftOverlap()
+{
+    if (ui->fftOverlapComboBox->currentIndex() == 0)
+        return -1;
+
+    return ui->fftOverlapComboBox->currentText().remove('%').toInt();
+}
+
+/*! \brief Get current waterfall line rate setting.
+ *  \return The line rate in lines per second or 0 for one line per FFT update.
+ */
+float DockFft::wfRate()
+{
+    if (ui->wfRateComboBox->currentIndex() == 0)
+        return 0.f;
+
+    return ui->wfRateComboBox->currentText().remove(" lines/s").toFloat();
+}
+
+/*! \brief Get current waterfall history setting.
+ *  \return The memory budget of the waterfall history in MB.
+ */
+int DockFft::wfHistorySize()
+{
+    return ui->wfHistoryComboBox->currentText().remove(" MB").toInt();
+}
+
 /*! \brief Get current FFT rate setting.
  *  \return The current FFT rate in frames per second (always non-zero)
  */
@@ -172,6 +207,31 @@ void DockFft::saveSettings(QSettings *settings)
     else
         settings->remove("averaging");
 
+    if (ui->fftAvgModeComboBox->currentIndex() != DEFAULT_FFT_AVG_MODE)
+        settings->setValue("averaging_mode", ui->fftAvgModeComboBox->currentIndex());
+    else
+        settings->remove("averaging_mode");
+
+    if (ui->fftOverlapComboBox->currentIndex() != DEFAULT_FFT_OVERLAP)
+        settings->setValue("overlap", ui->fftOverlapComboBox->currentIndex());
+    else
+        settings->remove("overlap");
+
+    if (ui->wfRateComboBox->currentIndex() != DEFAULT_WF_RATE)
+        settings->setValue("waterfall_rate", ui->wfRateComboBox->currentIndex());
+    else
+        settings->remove("waterfall_rate");
+
+    if (ui->wfModeComboBox->currentIndex() != DEFAULT_WF_MODE)
+        settings->setValue("waterfall_mode", ui->wfModeComboBox->currentIndex());
+    else
+        settings->remove("waterfall_mode");
+
+    if (ui->wfHistoryComboBox->currentIndex() != DEFAULT_WF_HISTORY)
+        settings->setValue("waterfall_history", ui->wfHistoryComboBox->currentIndex());
+    else
+        settings->remove("waterfall_history");
+
     if (ui->fftSplitSlider->value() != DEFAULT_FFT_SPLIT)
         settings->setValue("split", ui->fftSplitSlider->value());
     else
@@ -216,6 +276,29 @@ void DockFft::readSettings(QSettings *settings)
     if (conv_ok)
         ui->fftAvgSlider->setValue(intval);
 
+    intval = settings->value("averaging_mode", DEFAULT_FFT_AVG_MODE).toInt(&conv_ok);
+    if (conv_ok && intval >= 0 && intval < ui->fftAvgModeComboBox->count())
+    {
+        ui->fftAvgModeComboBox->setCurrentIndex(intval);
+        emit fftAvgModeChanged(intval);
+    }
+
+    intval = settings->value("overlap", DEFAULT_FFT_OVERLAP).toInt(&conv_ok);
+    if (conv_ok && intval >= 0 && intval < ui->fftOverlapComboBox->count())
+        ui->fftOverlapComboBox->setCurrentIndex(intval);
+
+    intval = settings->value("waterfall_rate", DEFAULT_WF_RATE).toInt(&conv_ok);
+    if (conv_ok && intval >= 0 && intval < ui->wfRateComboBox->count())
+        ui->wfRateComboBox->setCurrentIndex(intval);
+
+    intval = settings->value("waterfall_mode", DEFAULT_WF_MODE).toInt(&conv_ok);
+    if (conv_ok && intval >= 0 && intval < ui->wfModeComboBox->count())
+        ui->wfModeComboBox->setCurrentIndex(intval);
+
+    intval = settings->value("waterfall_history", DEFAULT_WF_HISTORY).toInt(&conv_ok);
+    if (conv_ok && intval >= 0 && intval < ui->wfHistoryComboBox->count())
+        ui->wfHistoryComboBox->setCurrentIndex(intval);
+
     intval = settings->value("split", DEFAULT_FFT_SPLIT).toInt(&conv_ok);
     if (conv_ok)
         ui->fftSplitSlider->setValue(intval);
@@ -261,6 +344,46 @@ void DockFft::on_fftAvgSlider_valueChanged(int value)
     emit fftAvgChanged(avg);
 }
 
+/*! \brief FFT averaging mode selected.
+ *
+ * Also emitted when the current mode is selected again, which restarts
+ * max and min hold.
+ */
+void DockFft::on_fftAvgModeComboBox_activated(int index)
+{
+    emit fftAvgModeChanged(index);
+}
+
+/*! \brief FFT overlap changed. */
+void DockFft::on_fftOverlapComboBox_currentIndexChanged(int index)
+{
+    Q_UNUSED(index);
+
+    emit fftOverlapChanged(fftOverlap());
+}
+
+/*! \brief Waterfall line rate changed. */
+void DockFft::on_wfRateComboBox_currentIndexChanged(int index)
+{
+    Q_UNUSED(index);
+
+    emit wfLinesChanged(wfRate(), ui->wfModeComboBox->currentIndex());
+}
+
+/*! \brief Waterfall line mode changed. */
+void DockFft::on_wfModeComboBox_currentIndexChanged(int index)
+{
+    emit wfLinesChanged(wfRate(), index);
+}
+
+/*! \brief Waterfall history size changed. */
+void DockFft::on_wfHistoryComboBox_currentIndexChanged(int index)
+{
+    Q_UNUSED(index);
+
+    emit wfHistoryChanged(wfHistorySize());
+}
+
 void DockFft::on_resetButton_clicked(void)
 {
     emit resetFftZoom();
@@ -294,6 +417,12 @@ void DockFft::on_peakHoldButton_toggled(bool checked)
     emit fftPeakHoldToggled(checked);
 }
 
+/*! Persistence button toggled */
+void DockFft::on_persistButton_toggled(bool checked)
+{
+    emit fftPersistenceToggled(checked);
+}
+
 /*! peakDetection button toggled */
 void DockFft::on_peakDetectionButton_toggled(bool checked)
 {
@@ -45,6 +45,10 @@ public:
     int fftSize();
     int setFftSize(int fft_size);
 
+    int fftOverlap();
+    float wfRate();
+    int wfHistorySize();
+
     void saveSettings(QSettings *settings);
     void readSettings(QSettings *settings);
 
@@ -53,12 +57,17 @@ signals:
     void fftRateChanged(int fps);    /*! FFT rate changed. */
     void fftSplitChanged(int pct);   /*! Split between pandapter and waterfall changed. */
     void fftAvgChanged(double gain); /*! FFT video filter gain has changed. */
+    void fftAvgModeChanged(int mode); /*! FFT averaging mode selected. */
+    void fftOverlapChanged(int pct); /*! FFT overlap changed (-1 = off). */
+    void wfLinesChanged(float rate, int mode); /*! Waterfall line rate or mode changed (rate 0 = FFT rate). */
+    void wfHistoryChanged(int mbytes); /*! Memory budget of the waterfall history changed. */
     void resetFftZoom(void);         /*! FFT zoom reset. */
     void gotoFftCenter(void);        /*! Go to FFT center. */
     void gotoDemodFreq(void);        /*! Center FFT around demodulator frequency. */
     void fftColorChanged(const QColor &); /*! FFT color has changed. */
     void fftFillToggled(bool fill);  /*! Toggle filling area under FFT plot. */
     void fftPeakHoldToggled(bool enable); /*! Toggle peak hold in FFT area. */
+    void fftPersistenceToggled(bool enable); /*! Toggle persistence display in FFT area. */
     void peakDetectionToggled(bool enabled); /*! Enable peak detection in FFT plot */
 
 private slots:
@@ -66,12 +75,18 @@ private slots:
     void on_fftRateComboBox_currentIndexChanged(const QString & text);
     void on_fftSplitSlider_valueChanged(int value);
     void on_fftAvgSlider_valueChanged(int value);
+    void on_fftAvgModeComboBox_activated(int index);
+    void on_fftOverlapComboBox_currentIndexChanged(int index);
+    void on_wfRateComboBox_currentIndexChanged(int index);
+    void on_wfModeComboBox_currentIndexChanged(int index);
+    void on_wfHistoryComboBox_currentIndexChanged(int index);
     void on_resetButton_clicked(void);
     void on_centerButton_clicked(void);
     void on_demodButton_clicked(void);
     void on_colorPicker_colorChanged(const QColor &);
     void on_fillButton_toggled(bool checked);
     void on_peakHoldButton_toggled(bool checked);
+    void on_persistButton_toggled(bool checked);
     void on_peakDetectionButton_toggled(bool checked);
 
 private:
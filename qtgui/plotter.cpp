@@ -30,7 +30,9 @@
 #include "plotter.h"
 #include "bookmarks.h"
 #include <stdlib.h>
+#include <string.h>
 #include <cmath>
+#include <QDateTime>
 #include <QDebug>
 #include <QtGlobal>
 
@@ -61,26 +63,41 @@ CPlotter::CPlotter(QWidget *parent) :
     {
 		// level 0: black background
 		if (i < 20)
-			m_ColorTbl[i].setRgb(0, 0, 0);
+			m_ColorTbl[i] = qRgb(0, 0, 0);
 		// level 1: black -> blue
         else if ((i >= 20) && (i < 70))
-            m_ColorTbl[i].setRgb(0, 0, 140*(i-20)/50);
+            m_ColorTbl[i] = qRgb(0, 0, 140*(i-20)/50);
         // level 2: blue -> light-blue / greenish
         else if ((i >= 70) && (i < 100))
-			m_ColorTbl[i].setRgb(60*(i-70)/30, 125*(i-70)/30, 115*(i-70)/30 + 140);
+			m_ColorTbl[i] = qRgb(60*(i-70)/30, 125*(i-70)/30, 115*(i-70)/30 + 140);
         // level 3: light blue -> yellow
         else if ((i >= 100) && (i < 150))
-            m_ColorTbl[i].setRgb(195*(i-100)/50 + 60, 130*(i-100)/50 + 125, 255-(255*(i-100)/50));
+            m_ColorTbl[i] = qRgb(195*(i-100)/50 + 60, 130*(i-100)/50 + 125, 255-(255*(i-100)/50));
         // level 4: yellow -> red
         else if ((i >= 150) && (i < 250))
-            m_ColorTbl[i].setRgb(255, 255-255*(i-150)/100, 0);
+            m_ColorTbl[i] = qRgb(255, 255-255*(i-150)/100, 0);
         // level 5: red -> white
         else if (i >= 250)
-            m_ColorTbl[i].setRgb(255, 255*(i-250)/5, 255*(i-250)/5);
+            m_ColorTbl[i] = qRgb(255, 255*(i-250)/5, 255*(i-250)/5);
+    }
+
+    // persistence colors: square root of the histogram density mapped onto
+    // the waterfall palette, empty cells are transparent
+    m_PersistTbl[0] = qRgba(0, 0, 0, 0);
+    for (int i = 1; i < PERSIST_TBL_SIZE; i++)
+    {
+        int c = qBound(1, (int)(255.0 * sqrt((double)i / (PERSIST_TBL_SIZE - 1))), 255);
+        QRgb rgb = m_ColorTbl[c];
+
+        m_PersistTbl[i] = qPremultiply(qRgba(qRed(rgb), qGreen(rgb), qBlue(rgb),
+                                             128 + c / 2));
     }
 
     m_PeakHoldActive=false;
     m_PeakHoldValid=false;
+    m_PersistActive=false;
+    m_PersistValid=false;
+    setPersistenceFrames(25);
 
     m_FftCenter = 0;
     m_CenterFreq = 144500000;
@@ -116,9 +133,16 @@ CPlotter::CPlotter(QWidget *parent) :
     m_DrawOverlay = true;
     m_2DPixmap = QPixmap(0,0);
     m_OverlayPixmap = QPixmap(0,0);
-    m_WaterfallPixmap = QPixmap(0,0);
+    m_WaterfallImage = QImage();
+    m_WaterfallOffset = 0;
+    m_WfHistoryOffset = 0;
+    m_WfRedrawRow = 0;
     m_Size = QSize(0,0);
     m_GrabPosition = 0;
+    m_fftDataSize = 0;
+    m_DataStart = m_DataStop = 0;
+    m_MapWidth = -1;    // force new bin to pixel map
+    m_MapXmin = m_MapXmax = 0;
     m_Percent2DScreen = 50;	//percent of screen used for 2D display
 
 #ifdef Q_WS_MAC
@@ -258,6 +282,8 @@ void CPlotter::mouseMoveEvent(QMouseEvent* event)
                 drawOverlay();
 
             m_PeakHoldValid = false;
+            m_PersistValid = false;
+            m_WfRedrawRow = 0;
 
             m_Yzero = pt.y();
         }
@@ -286,6 +312,8 @@ void CPlotter::mouseMoveEvent(QMouseEvent* event)
                 drawOverlay();
 
             m_PeakHoldValid = false;
+            m_PersistValid = false;
+            m_WfRedrawRow = 0;
 
             m_Xzero = pt.x();
         }
@@ -369,6 +397,7 @@ void CPlotter::mouseMoveEvent(QMouseEvent* event)
                     drawOverlay();  // not running so update oiverlay now
 
                 m_PeakHoldValid = false;
+                m_PersistValid = false;
             }
             else
             {	//save initial grab postion from m_DemodFreqX
@@ -555,6 +584,8 @@ void CPlotter::wheelEvent(QWheelEvent * event)
         m_MindB = m_MaxdB - db_range;
 
         m_PeakHoldValid = false;
+        m_PersistValid = false;
+        m_WfRedrawRow = 0;
     }
     else if (m_CursorCaptured == XAXIS)
     {
@@ -580,6 +611,14 @@ void CPlotter::wheelEvent(QWheelEvent * event)
         qDebug() << QString("Spectrum zoom: %1x").arg(zoom_factor, 0, 'f', 1);
 
         m_PeakHoldValid = false;
+        m_PersistValid = false;
+    }
+    else if ((event->modifiers() & Qt::AltModifier) &&
+             (pt.y() >= m_OverlayPixmap.height()))
+    {
+        // browse the waterfall history, wheel up goes back in time
+        scrollWaterfall((event->delta() > 0 ? 1 : -1) *
+                        qMax(m_WaterfallImage.height() / 8, 1));
     }
     else if (event->modifiers() & Qt::ControlModifier)
     {
@@ -628,21 +667,47 @@ void CPlotter::resizeEvent(QResizeEvent* )
         m_2DPixmap = QPixmap(m_Size.width(), m_Percent2DScreen*m_Size.height()/100);
         m_2DPixmap.fill(Qt::black);
 
-        int height = (100-m_Percent2DScreen)*m_Size.height()/100;
-        if (m_WaterfallPixmap.isNull()) {
-            m_WaterfallPixmap = QPixmap(m_Size.width(), height);
-            m_WaterfallPixmap.fill(Qt::black);
-        } else {
-            m_WaterfallPixmap = m_WaterfallPixmap.scaled(m_Size.width(), height,
-                                                         Qt::IgnoreAspectRatio,
-                                                         Qt::SmoothTransformation);
-        }
+        resizeWaterfall(m_Size.width(), (100-m_Percent2DScreen)*m_Size.height()/100);
 
         m_PeakHoldValid=false;
+        m_PersistValid=false;
+        m_WfRedrawRow=0;
     }
     drawOverlay();
 }
 
+/*! \brief Resize the waterfall.
+ *  \param w The new width.
+ *  \param h The new height.
+ *
+ * The existing waterfall is unrolled from the ring buffer and scaled to the
+ * new size.
+ */
+void CPlotter::resizeWaterfall(int w, int h)
+{
+    QImage image(qMax(w, 0), qMax(h, 0), QImage::Format_RGB32);
+
+    image.fill(m_ColorTbl[0]);
+
+    if (!m_WaterfallImage.isNull() && !image.isNull())
+    {
+        int oldw = m_WaterfallImage.width();
+        int oldh = m_WaterfallImage.height();
+        QImage linear(oldw, oldh, QImage::Format_RGB32);
+
+        for (int y = 0; y < oldh; y++)
+            memcpy(linear.scanLine(y),
+                   m_WaterfallImage.constScanLine((y + m_WaterfallOffset) % oldh),
+                   oldw * sizeof(QRgb));
+
+        image = linear.scaled(image.size(), Qt::IgnoreAspectRatio,
+                              Qt::SmoothTransformation);
+    }
+
+    m_WaterfallImage = image;
+    m_WaterfallOffset = 0;
+}
+
 //////////////////////////////////////////////////////////////////////
 // Called by QT when screen needs to be redrawn
 //////////////////////////////////////////////////////////////////////
@@ -650,8 +715,33 @@ void CPlotter::paintEvent(QPaintEvent *)
 {
     QPainter painter(this);
 
+    int y = m_Percent2DScreen*m_Size.height()/100;
+    int w = m_WaterfallImage.width();
+    int h = m_WaterfallImage.height();
+
     painter.drawPixmap(0,0,m_2DPixmap);
-    painter.drawPixmap(0, m_Percent2DScreen*m_Size.height()/100,m_WaterfallPixmap);
+
+    // the waterfall ring buffer is drawn in two parts, newest line first
+    painter.drawImage(QPoint(0, y), m_WaterfallImage,
+                      QRect(0, m_WaterfallOffset, w, h - m_WaterfallOffset));
+    if (m_WaterfallOffset > 0)
+        painter.drawImage(QPoint(0, y + h - m_WaterfallOffset), m_WaterfallImage,
+                          QRect(0, 0, w, m_WaterfallOffset));
+
+    // show the age of the top line while browsing the history
+    if ((m_WfHistoryOffset > 0) && (m_WfHistoryOffset < m_WfHistory.count()))
+    {
+        qint64 age = QDateTime::currentMSecsSinceEpoch() -
+                     m_WfHistory.lineTime(m_WfHistoryOffset);
+        QFont Font("Arial");
+        Font.setPointSize(m_FontSize);
+        QFontMetrics metrics(Font);
+
+        painter.setFont(Font);
+        painter.setPen(Qt::white);
+        painter.drawText(5, y + metrics.ascent() + 2,
+                         QString("-%1 s").arg(age / 1000.0, 0, 'f', 1));
+    }
     //tell interface that its ok to signal a new line of fft data
     //m_pSdrInterface->ScreenUpdateDone();
     return;
@@ -679,36 +769,26 @@ void CPlotter::draw()
     if (!m_Running)
         return;
 
+    // reduce FFT data to screen resolution, once for both waterfall and pandapter
+    reduceFftData(qMin(m_Size.width(), MAX_SCREENSIZE),
+                  m_FftCenter - (qint64)m_Span/2,
+                  m_FftCenter + (qint64)m_Span/2);
+    xmin = m_MapXmin;
+    xmax = m_MapXmax;
+
     // get/draw the waterfall
-    w = m_WaterfallPixmap.width();
-    h = m_WaterfallPixmap.height();
+    w = m_WaterfallImage.width();
+    h = m_WaterfallImage.height();
 
-    // no need to draw if pixmap is invisible
-    if ((w != 0) || (h != 0))
+    // no need to draw if there is no new line
+    if (m_wfData)
+        drawWaterfallLine();
+
+    // re-render invalidated lines a few at a time to avoid stalls
+    if ((w != 0) && (h != 0) && (m_WfRedrawRow < h))
     {
-        // move current data down one line(must do before attaching a QPainter object)
-        m_WaterfallPixmap.scroll(0,1,0,0, w, h);
-
-        QPainter painter1(&m_WaterfallPixmap);
-        // get scaled FFT data
-        getScreenIntegerFFTData(255, qMin(w, MAX_SCREENSIZE),
-                                m_MaxdB, m_MindB,
-                                m_FftCenter - (qint64)m_Span/2,
-                                m_FftCenter + (qint64)m_Span/2,
-                                m_wfData, m_fftbuf,
-                                &xmin, &xmax);
-
-        // draw new line of fft data at top of waterfall bitmap
-        painter1.setPen(QColor(0, 0, 0));
-        for (i = 0; i < xmin; i++)
-            painter1.drawPoint(i,0);
-        for (i = xmax; i < w; i++)
-            painter1.drawPoint(i,0);
-        for (i = xmin; i < xmax; i++)
-        {
-            painter1.setPen(m_ColorTbl[ 255-m_fftbuf[i] ]);
-            painter1.drawPoint(i,0);
-        }
+        redrawWaterfall(m_WfRedrawRow, m_WfRedrawRow + WF_REDRAW_ROWS);
+        m_WfRedrawRow = qMin(m_WfRedrawRow + WF_REDRAW_ROWS, h);
     }
 
     // get/draw the 2D spectrum
@@ -722,20 +802,22 @@ void CPlotter::draw()
 
         QPainter painter2(&m_2DPixmap);
 
+        // get new scaled fft data
+        getScreenIntegerFFTData(h, m_MaxdB, m_MindB, m_fftMax, m_fftbuf);
+
+        // persistence heat map goes below the traces
+        if (m_PersistActive)
+        {
+            updatePersistence(w, h, xmin, xmax);
+            painter2.drawImage(0, 0, m_PersistImage);
+        }
+
 // workaround for "fixed" line drawing since Qt 5
 // see http://stackoverflow.com/questions/16990326 
 #if QT_VERSION >= 0x050000
         painter2.translate(0.5, 0.5);
 #endif
 
-        // get new scaled fft data
-        getScreenIntegerFFTData(h, qMin(w, MAX_SCREENSIZE),
-                                m_MaxdB, m_MindB,
-                                m_FftCenter - (qint64)m_Span/2,
-                                m_FftCenter + (qint64)m_Span/2,
-                                m_fftData, m_fftbuf,
-                                &xmin, &xmax);
-
         // draw the pandapter
         painter2.setPen(m_FftColor);
         n = xmax - xmin;
@@ -838,7 +920,7 @@ void CPlotter::draw()
  * When FFT data is set using this method, the same data will be used for bith the
  * pandapter and the waterfall.
  */
-void CPlotter::setNewFttData(double *fftData, int size)
+void CPlotter::setNewFttData(float *fftData, int size)
 {
 
     /** FIXME **/
@@ -854,14 +936,15 @@ void CPlotter::setNewFttData(double *fftData, int size)
 
 /*! \brief Set new FFT data.
  *  \param fftData Pointer to the new FFT data used on the pandapter.
- *  \param wfData Pointer to the FFT data used in the waterfall.
+ *  \param wfData Pointer to the FFT data used in the waterfall, or NULL.
  *  \param size The FFT size.
  *
  * This method can be used to set different FFT data set for the pandapter and the
- * waterfall.
+ * waterfall. If wfData is NULL only the pandapter is updated and the waterfall
+ * does not scroll, so that the waterfall can run at its own line rate.
  */
 
-void CPlotter::setNewFttData(double *fftData, double *wfData, int size)
+void CPlotter::setNewFttData(float *fftData, float *wfData, int size)
 {
 
     /** FIXME **/
@@ -875,106 +958,423 @@ void CPlotter::setNewFttData(double *fftData, double *wfData, int size)
     draw();
 }
 
-void CPlotter::getScreenIntegerFFTData(qint32 plotHeight, qint32 plotWidth,
-                                       double maxdB, double mindB,
-                                       qint64 startFreq, qint64 stopFreq,
-                                       double *inBuf, qint32 *outBuf,
-                                       int *xmin, int *xmax)
+/*! \brief Add a line to the waterfall.
+ *  \param wfData Pointer to the waterfall data.
+ *  \param size The FFT size.
+ *
+ * Only the waterfall is updated, so the waterfall can get any number of
+ * lines between pandapter updates. Lines that do not match the FFT size of
+ * the pandapter data are dropped.
+ */
+void CPlotter::addWaterfallLine(float *wfData, int size)
 {
-    qint32 i;
-    qint32 y;
-    qint32 x;
-    qint32 ymax = 10000;
-    qint32 xprev = -1;
-    qint32 minbin, maxbin;
-    qint32 m_BinMin, m_BinMax;
-    qint32 m_FFTSize = m_fftDataSize;
-    double *m_pFFTAveBuf = inBuf;
-    double  dBGainFactor = ((double)plotHeight)/abs(maxdB-mindB);
-    qint32* m_pTranslateTbl = new qint32[qMax(m_FFTSize, plotWidth)];
+    qint32 x, i, start, end;
+    float wmax;
 
-    /** FIXME: qint64 -> qint32 **/
-    m_BinMin = (qint32)((double)startFreq*(double)m_FFTSize/m_SampleFreq);
-    m_BinMin += (m_FFTSize/2);
-    m_BinMax = (qint32)((double)stopFreq*(double)m_FFTSize/m_SampleFreq);
-    m_BinMax += (m_FFTSize/2);
-
-    minbin = m_BinMin < 0 ? 0 : m_BinMin;
-    if (m_BinMin > m_FFTSize)
-        m_BinMin = m_FFTSize - 1;
-    if (m_BinMax <= m_BinMin)
-        m_BinMax = m_BinMin + 1;
-    maxbin = m_BinMax < m_FFTSize ? m_BinMax : m_FFTSize;
-    bool largeFft = (m_BinMax-m_BinMin) > plotWidth; // true if more fft point than plot points
-
-    if (largeFft)
+    if (!m_Running || (size != m_fftDataSize))
+        return;
+
+    updateScreenMap(qMin(m_Size.width(), MAX_SCREENSIZE),
+                    m_FftCenter - (qint64)m_Span/2,
+                    m_FftCenter + (qint64)m_Span/2);
+
+    // reduce to screen resolution like reduceFftData()
+    for (x = m_MapXmin; x < m_MapXmax; x++)
     {
-        // more FFT points than plot points
-        for (i = minbin; i < maxbin; i++)
-            m_pTranslateTbl[i] = ((i-m_BinMin)*plotWidth) / (m_BinMax - m_BinMin);
-        *xmin = m_pTranslateTbl[minbin];
-        *xmax = m_pTranslateTbl[maxbin - 1];
+        start = m_MapBinStart[x];
+        end = m_MapBinEnd[x];
+        wmax = wfData[start];
+        for (i = start + 1; i < end; i++)
+            wmax = qMax(wmax, wfData[i]);
+        m_wfMax[x] = wmax;
+    }
+
+    m_wfData = wfData;
+    drawWaterfallLine();
+    m_wfData = 0;
+
+    // trigger a new paintEvent
+    update();
+}
+
+/*! \brief Scroll the waterfall by one line and draw the new line.
+ *
+ * Uses m_wfData, which is also kept in the history, and the same data
+ * reduced to screen resolution in m_wfMax.
+ */
+void CPlotter::drawWaterfallLine()
+{
+    int i;
+    int w = m_WaterfallImage.width();
+    int h = m_WaterfallImage.height();
+    int xmin = m_MapXmin;
+    int xmax = m_MapXmax;
+    qint64 start, stop;
+
+    // no need to draw if waterfall is invisible
+    if ((w == 0) || (h == 0))
+        return;
+
+    // keep the line so that it can be re-rendered later
+    if (m_DataStop > m_DataStart)
+    {
+        start = m_DataStart;
+        stop = m_DataStop;
     }
     else
     {
-        // more plot points than FFT points
-        for (i = 0; i < plotWidth; i++)
-            m_pTranslateTbl[i] = m_BinMin + (i*(m_BinMax - m_BinMin)) / plotWidth;
-        *xmin = 0;
-        *xmax = plotWidth;
+        start = -(qint64)(m_SampleFreq / 2.0);
+        stop = start + (qint64)m_SampleFreq;
     }
+    m_WfHistory.addLine(m_wfData, m_fftDataSize, m_CenterFreq + start,
+                        m_CenterFreq + stop,
+                        QDateTime::currentMSecsSinceEpoch());
 
-    if (largeFft)
+    if ((m_WfHistoryOffset > 0) &&
+        (m_WfHistoryOffset + h < m_WfHistory.count()))
+    {
+        // browsing the history: visible lines stay where they are
+        m_WfHistoryOffset++;
+    }
+    else
     {
-        // more FFT points than plot points
-        for (i = minbin; i < maxbin; i++ )
+        // scroll by moving the top of the ring buffer one line up
+        m_WaterfallOffset = (m_WaterfallOffset + h - 1) % h;
+        if (m_WfRedrawRow < h)
+            m_WfRedrawRow++;
+
+        if (m_WfHistoryOffset > 0)
         {
-            y = (qint32)(dBGainFactor*(maxdB-m_pFFTAveBuf[i]));
+            // oldest end of a full history, the view has to move
+            redrawWaterfall(0, 1);
+        }
+        else
+        {
+            QRgb *line = (QRgb *)m_WaterfallImage.scanLine(m_WaterfallOffset);
+
+            // get scaled FFT data
+            getScreenIntegerFFTData(255, m_MaxdB, m_MindB, m_wfMax, m_fftbuf);
+
+            // write new line of fft data
+            for (i = 0; i < xmin; i++)
+                line[i] = m_ColorTbl[0];
+            for (i = xmin; i < xmax; i++)
+                line[i] = m_ColorTbl[255 - m_fftbuf[i]];
+            for (i = xmax; i < w; i++)
+                line[i] = m_ColorTbl[0];
+        }
+    }
+}
 
-            if (y > plotHeight)
-                y = plotHeight;
-            else if (y < 0)
-                y = 0;
+/*! \brief Update the mapping between FFT bins and screen pixels.
+ *  \param plotWidth The width of the plot in pixels.
+ *  \param startFreq The frequency at the left edge relative to the FFT center.
+ *  \param stopFreq The frequency at the right edge relative to the FFT center.
+ *
+ * The mapping is cached and only rebuilt when the span, the center, the FFT
+ * size, the sample rate, the data range or the width has changed.
+ */
+void CPlotter::updateScreenMap(qint32 plotWidth, qint64 startFreq, qint64 stopFreq)
+{
+    qint32 i;
+    qint32 x;
+    qint32 xprev;
+    qint32 minbin, maxbin;
+    qint32 binMin, binMax;
+    qint32 fftSize = m_fftDataSize;
+    double dataStart, dataSpan;
 
-            x = m_pTranslateTbl[i];	//get fft bin to plot x coordinate transform
+    if ((plotWidth == m_MapWidth) && (startFreq == m_MapStart) &&
+        (stopFreq == m_MapStop) && (fftSize == m_MapFftSize) &&
+        (m_SampleFreq == m_MapSampleFreq))
+    {
+        return;
+    }
 
-            if (x == xprev)   // still mappped to same fft bin coordinate
-            {
-                if (y < ymax) // store only the max value
-                {
-                    outBuf[x] = y;
-                    ymax = y;
-                }
+    m_MapWidth = plotWidth;
+    m_MapStart = startFreq;
+    m_MapStop = stopFreq;
+    m_MapFftSize = fftSize;
+    m_MapSampleFreq = m_SampleFreq;
+    m_MapXmin = m_MapXmax = 0;
 
-            }
-            else
+    if ((plotWidth <= 0) || (fftSize <= 0))
+        return;
+
+    if (m_DataStop > m_DataStart)
+    {
+        dataStart = m_DataStart;
+        dataSpan = m_DataStop - m_DataStart;
+    }
+    else
+    {
+        dataStart = -m_SampleFreq / 2.0;
+        dataSpan = m_SampleFreq;
+    }
+
+    /** FIXME: qint64 -> qint32 **/
+    binMin = (qint32)floor(((double)startFreq - dataStart)*(double)fftSize/dataSpan);
+    binMax = (qint32)floor(((double)stopFreq - dataStart)*(double)fftSize/dataSpan);
+
+    if (binMin > fftSize)
+        binMin = fftSize - 1;
+    if (binMax <= binMin)
+        binMax = binMin + 1;
+    minbin = binMin < 0 ? 0 : binMin;
+    maxbin = binMax < fftSize ? binMax : fftSize;
+
+    if ((binMax - binMin) > plotWidth)
+    {
+        // more FFT points than plot points: each pixel covers a range of bins
+        xprev = -1;
+        for (i = minbin; i < maxbin; i++)
+        {
+            x = (qint32)(((qint64)(i - binMin) * plotWidth) / (binMax - binMin));
+            if (x != xprev)
             {
-                outBuf[x] = y;
+                if (xprev < 0)
+                    m_MapXmin = x;
+                else
+                    m_MapBinEnd[xprev] = i;
+                m_MapBinStart[x] = i;
                 xprev = x;
-                ymax = y;
             }
         }
+        if (xprev >= 0)
+        {
+            m_MapBinEnd[xprev] = maxbin;
+            m_MapXmax = xprev + 1;
+        }
     }
     else
     {
-        // more plot points than FFT points
-        for (x = 0; x < plotWidth; x++ )
+        // more plot points than FFT points: each pixel shows one bin
+        m_MapXmin = plotWidth;
+        for (x = 0; x < plotWidth; x++)
         {
-            i = m_pTranslateTbl[x]; // get plot to fft bin coordinate transform
-            y = (qint32)(dBGainFactor*(maxdB-m_pFFTAveBuf[i]));
+            i = binMin + (x * (binMax - binMin)) / plotWidth;
+            m_MapBinStart[x] = i;
+            m_MapBinEnd[x] = i + 1;
+            if ((i >= 0) && (i < fftSize))
+            {
+                m_MapXmin = qMin(m_MapXmin, x);
+                m_MapXmax = x + 1;
+            }
+        }
+        if (m_MapXmax == 0)
+            m_MapXmin = 0;
+    }
+}
 
-            if (y > plotHeight)
-                y = plotHeight;
-            else if (y < 0)
-                y = 0;
+/*! \brief Reduce pandapter and waterfall FFT data to screen resolution.
+ *  \param plotWidth The width of the plot in pixels.
+ *  \param startFreq The frequency at the left edge relative to the FFT center.
+ *  \param stopFreq The frequency at the right edge relative to the FFT center.
+ *
+ * Each pixel gets the peak value of the FFT bins it covers. Both data sets
+ * are reduced in the same pass over the bins into m_fftMax and m_wfMax.
+ */
+void CPlotter::reduceFftData(qint32 plotWidth, qint64 startFreq, qint64 stopFreq)
+{
+    qint32 x, i, start, end;
+    const float *fft = m_fftData;
+    const float *wf = m_wfData;
 
-            outBuf[x] = y;
+    updateScreenMap(plotWidth, startFreq, stopFreq);
+
+    // no new waterfall line; reducing the pandapter data twice is cheaper
+    // than a second version of the loop
+    if (!wf)
+        wf = fft;
+
+    for (x = m_MapXmin; x < m_MapXmax; x++)
+    {
+        start = m_MapBinStart[x];
+        end = m_MapBinEnd[x];
+
+        // four independent lanes so that the compiler can use SIMD max
+        float f0 = fft[start], f1 = f0, f2 = f0, f3 = f0;
+        float w0 = wf[start], w1 = w0, w2 = w0, w3 = w0;
+        for (i = start; i + 4 <= end; i += 4)
+        {
+            f0 = qMax(f0, fft[i]);
+            f1 = qMax(f1, fft[i+1]);
+            f2 = qMax(f2, fft[i+2]);
+            f3 = qMax(f3, fft[i+3]);
+            w0 = qMax(w0, wf[i]);
+            w1 = qMax(w1, wf[i+1]);
+            w2 = qMax(w2, wf[i+2]);
+            w3 = qMax(w3, wf[i+3]);
         }
+        for (; i < end; i++)
+        {
+            f0 = qMax(f0, fft[i]);
+            w0 = qMax(w0, wf[i]);
+        }
+
+        m_fftMax[x] = qMax(qMax(f0, f1), qMax(f2, f3));
+        m_wfMax[x] = qMax(qMax(w0, w1), qMax(w2, w3));
+    }
+}
+
+/*! \brief Convert reduced FFT data to screen coordinates.
+ *  \param plotHeight The height of the plot in pixels.
+ *  \param maxdB The level at the top of the plot.
+ *  \param mindB The level at the bottom of the plot.
+ *  \param inBuf FFT data reduced to screen resolution by reduceFftData().
+ *  \param outBuf The y coordinate for each pixel between m_MapXmin and m_MapXmax.
+ */
+void CPlotter::getScreenIntegerFFTData(qint32 plotHeight, double maxdB, double mindB,
+                                       const float *inBuf, qint32 *outBuf)
+{
+    qint32 x;
+    qint32 y;
+    float  dBGainFactor = ((float)plotHeight)/fabs(maxdB-mindB);
+    float  top = maxdB;
+
+    for (x = m_MapXmin; x < m_MapXmax; x++)
+    {
+        y = (qint32)(dBGainFactor*(top-inBuf[x]));
+
+        if (y > plotHeight)
+            y = plotHeight;
+        else if (y < 0)
+            y = 0;
+
+        outBuf[x] = y;
+    }
+}
+
+
+/*! \brief Re-render waterfall rows from the history.
+ *  \param first The first row to render, 0 being the top.
+ *  \param last The last row to render + 1.
+ *
+ * Rows are rendered for the current frequency window and dB range. Rows
+ * older than the history are cleared.
+ */
+void CPlotter::redrawWaterfall(int first, int last)
+{
+    QRgb    lut[256];
+    QRgb   *line;
+    qint64  start, stop;
+    int     w = m_WaterfallImage.width();
+    int     h = m_WaterfallImage.height();
+    int     row, n, x;
+
+    CWaterfallHistory::makeColorLut(lut, m_ColorTbl, m_MindB, m_MaxdB);
+    start = m_CenterFreq + m_FftCenter - m_Span / 2;
+    stop = m_CenterFreq + m_FftCenter + m_Span / 2;
+
+    last = qMin(last, h);
+    for (row = first; row < last; row++)
+    {
+        line = (QRgb *)m_WaterfallImage.scanLine((m_WaterfallOffset + row) % h);
+        n = m_WfHistoryOffset + row;
+        if (n < m_WfHistory.count())
+            m_WfHistory.renderLine(n, start, stop, line, w, lut, m_ColorTbl[0]);
+        else
+            for (x = 0; x < w; x++)
+                line[x] = m_ColorTbl[0];
     }
+}
+
+/*! \brief Scroll the waterfall through the history.
+ *  \param lines Number of lines to go back in time, negative to go forward.
+ *
+ * The waterfall is live again once it is scrolled back to the newest line.
+ */
+void CPlotter::scrollWaterfall(int lines)
+{
+    int h = m_WaterfallImage.height();
+    int offset = qBound(0, m_WfHistoryOffset + lines,
+                        qMax(m_WfHistory.count() - h, 0));
+
+    if (offset == m_WfHistoryOffset)
+        return;
+
+    m_WfHistoryOffset = offset;
+    m_WfRedrawRow = 0;
 
-    delete [] m_pTranslateTbl;
+    if (!m_Running)
+    {
+        redrawWaterfall(0, h);
+        m_WfRedrawRow = h;
+        update();
+    }
 }
 
+/*! \brief Add the current pandapter trace to the persistence histogram.
+ *  \param w Width of the pandapter.
+ *  \param h Height of the pandapter.
+ *  \param xmin First pixel with FFT data.
+ *  \param xmax Last pixel with FFT data + 1.
+ *
+ * Uses the trace in m_fftbuf. The whole histogram is decayed first, then
+ * each column gets a hit for every level the trace crosses in that column
+ * (halfway to its neighbours, like the polyline). The result is rendered
+ * into m_PersistImage.
+ *
+ * The histogram is kept at screen resolution, so the cost does not depend
+ * on the FFT size. The decay and render loops are plain 16 bit integer
+ * loops that the compiler vectorizes.
+ */
+void CPlotter::updatePersistence(int w, int h, int xmin, int xmax)
+{
+    quint16 *hist;
+    QRgb    *line;
+    quint32  v;
+    quint32  decay = m_PersistDecay;
+    quint32  hit = m_PersistHit;
+    int      size = w * h;
+    int      i, x, y, y0, y1, yc;
+
+    if (!m_PersistValid || m_PersistImage.width() != w ||
+        m_PersistImage.height() != h)
+    {
+        m_PersistHist.assign(size, 0);
+        m_PersistImage = QImage(w, h, QImage::Format_ARGB32_Premultiplied);
+        m_PersistValid = true;
+    }
+
+    hist = &m_PersistHist[0];
+
+    // exponential decay, 16x16 bit multiply keeping the high half
+    for (i = 0; i < size; i++)
+        hist[i] = (quint16)((hist[i] * decay) >> 16);
+
+    for (x = xmin; x < xmax; x++)
+    {
+        yc = qMin(m_fftbuf[x], h - 1);
+        y0 = y1 = yc;
+        if (x > xmin)
+        {
+            y = (yc + qMin(m_fftbuf[x - 1], h - 1)) / 2;
+            y0 = qMin(y0, y);
+            y1 = qMax(y1, y);
+        }
+        if (x < xmax - 1)
+        {
+            y = (yc + qMin(m_fftbuf[x + 1], h - 1)) / 2;
+            y0 = qMin(y0, y);
+            y1 = qMax(y1, y);
+        }
+
+        for (y = y0; y <= y1; y++)
+        {
+            v = hist[y * w + x] + hit;
+            hist[y * w + x] = (quint16)qMin(v, 0xFFFFu);
+        }
+    }
+
+    for (y = 0; y < h; y++)
+    {
+        line = (QRgb *)m_PersistImage.scanLine(y);
+        hist = &m_PersistHist[y * w];
+        for (x = 0; x < w; x++)
+            line[x] = m_PersistTbl[hist[x] >> (16 - PERSIST_TBL_BITS)];
+    }
+}
 
 /*! \brief Set upper limit of dB scale. */
 void CPlotter::setMaxDB(double max)
@@ -989,6 +1389,8 @@ void CPlotter::setMaxDB(double max)
         drawOverlay();
 
     m_PeakHoldValid = false;
+    m_PersistValid = false;
+    m_WfRedrawRow = 0;
 
 }
 
@@ -1003,6 +1405,8 @@ void CPlotter::setMinDB(double min)
         drawOverlay();
 
     m_PeakHoldValid = false;
+    m_PersistValid = false;
+    m_WfRedrawRow = 0;
 }
 
 /*! \brief Set limits of dB scale. */
@@ -1017,6 +1421,8 @@ void CPlotter::setMinMaxDB(double min, double max)
         drawOverlay();
 
     m_PeakHoldValid = false;
+    m_PersistValid = false;
+    m_WfRedrawRow = 0;
 }
 
 
@@ -1340,6 +1746,8 @@ void CPlotter::setCenterFreq(quint64 f)
     updateOverlay();
 
     m_PeakHoldValid = false;
+    m_PersistValid = false;
+    m_WfRedrawRow = 0;
 }
 
 void CPlotter::updateOverlay()
@@ -1367,6 +1775,7 @@ void CPlotter::moveToCenterFreq(void)
         drawOverlay();
 
     m_PeakHoldValid = false;
+    m_PersistValid = false;
 }
 
 /*! \brief Center FFT plot around the demodulator frequency. */
@@ -1379,6 +1788,7 @@ void CPlotter::moveToDemodFreq(void)
         drawOverlay();
 
     m_PeakHoldValid = false;
+    m_PersistValid = false;
 }
 
 /*! Set FFT plot color. */
@@ -1408,6 +1818,34 @@ void CPlotter::setPeakHold(bool enabled)
     m_PeakHoldValid=false;
 }
 
+/*! \brief Set persistence display on or off.
+ *  \param enabled The new state of the persistence display.
+ */
+void CPlotter::setPersistence(bool enabled)
+{
+    m_PersistActive = enabled;
+    m_PersistValid = false;
+    if (!enabled)
+    {
+        m_PersistHist.clear();
+        m_PersistImage = QImage();
+    }
+}
+
+/*! \brief Set the persistence decay time.
+ *  \param frames Time constant of the decay in FFT frames.
+ *
+ * A level that is hit in every frame settles near the top of the color
+ * scale, a single hit starts at a density of about 1/frames.
+ */
+void CPlotter::setPersistenceFrames(float frames)
+{
+    double a = exp(-1.0 / qMax(frames, 1.0f));
+
+    m_PersistDecay = (quint16)qMin(a * 65536.0, 65535.0);
+    m_PersistHit = (quint16)qMax((1.0 - a) * 65535.0, 1.0);
+}
+
 /*! \brief Set peak detection on or off.
  *  \param enabled The new state of peak detection.
  *  \param c Minimum distance of peaks from mean, in multiples of standard deviation.
@@ -7,6 +7,7 @@
 #include <QImage>
 #include <vector>
 #include <QMap>
+#include "waterfallhistory.h"
 
 #define HORZ_DIVS_MAX 50 //12
 #define MAX_SCREENSIZE 16384
@@ -15,6 +16,11 @@
 #define PEAK_CLICK_MAX_V_DISTANCE 20 //Maximum vertical distance of clicked point from peak
 #define PEAK_H_TOLERANCE 2
 
+#define PERSIST_TBL_BITS 12     // Histogram bits used for the persistence color lookup
+#define PERSIST_TBL_SIZE (1 << PERSIST_TBL_BITS)
+
+#define WF_REDRAW_ROWS 128      // Max waterfall rows re-rendered from history per frame
+
 
 class CPlotter : public QFrame
 {
@@ -41,8 +47,9 @@ public:
         resizeEvent(NULL);
     }
 
-    void setNewFttData(double *fftData, int size);
-    void setNewFttData(double *fftData, double *wfData, int size);
+    void setNewFttData(float *fftData, int size);
+    void setNewFttData(float *fftData, float *wfData, int size);
+    void addWaterfallLine(float *wfData, int size);
 
     void setCenterFreq(quint64 f);
     void setFreqUnits(qint32 unit) { m_FreqUnits = unit; }
@@ -109,13 +116,42 @@ public:
         return m_SampleFreq;
     }
 
+    qint32 getSpanFreq(void) { return m_Span; }
+    qint64 getFftCenterFreq(void) { return m_FftCenter; }
+
+    /*! \brief Set the frequencies covered by the FFT data.
+     *
+     * The data covers [start, stop) relative to the center frequency, e.g.
+     * 0 to rate/2 for the half spectrum of a real signal. By default, or
+     * if stop <= start, it covers the full sample rate centered at 0 Hz.
+     */
+    void setFftDataRange(qint64 start, qint64 stop)
+    {
+        m_DataStart = start;
+        m_DataStop = stop;
+        m_MapWidth = -1;    // force new bin to pixel map
+    }
+
+    /*! \brief Set the memory budget of the waterfall history in bytes.
+     *
+     * The history is cleared and the waterfall goes back to live data.
+     */
+    void setWaterfallHistorySize(size_t bytes)
+    {
+        m_WfHistory.setMaxBytes(bytes);
+        m_WfHistoryOffset = 0;
+    }
+
     void setFftCenterFreq(qint64 f) {
         qint64 limit = ((qint64)m_SampleFreq + m_Span) / 2 - 1;
         m_FftCenter = qBound(-limit, f, limit);
+        m_WfRedrawRow = 0;
     }
 
     int getNearestPeak(QPoint pt);
 
+    void setPersistenceFrames(float frames);
+
 signals:
     void newCenterFreq(qint64 f);
     void newDemodFreq(qint64 freq, qint64 delta); /* delta is the offset from the center */
@@ -131,6 +167,7 @@ public slots:
     void setFftPlotColor(const QColor color);
     void setFftFill(bool enabled);
     void setPeakHold(bool enabled);
+    void setPersistence(bool enabled);
     void setPeakDetection(bool enabled, double c);
     void updateOverlay();
 
@@ -161,19 +198,48 @@ private:
     bool isPointCloseTo(int x, int xr, int delta){return ((x > (xr-delta) ) && ( x<(xr+delta)) );}
     void clampDemodParameters();
 
-    void getScreenIntegerFFTData(qint32 plotHeight, qint32 plotWidth,
-                                 double maxdB, double mindB,
-                                 qint64 startFreq, qint64 stopFreq,
-                                 double *inBuf, qint32 *outBuf,
-                                 qint32 *maxbin, qint32 *minbin);
+    void resizeWaterfall(int w, int h);
+    void updateScreenMap(qint32 plotWidth, qint64 startFreq, qint64 stopFreq);
+    void reduceFftData(qint32 plotWidth, qint64 startFreq, qint64 stopFreq);
+    void getScreenIntegerFFTData(qint32 plotHeight, double maxdB, double mindB,
+                                 const float *inBuf, qint32 *outBuf);
+    void updatePersistence(int w, int h, int xmin, int xmax);
+    void drawWaterfallLine();
+    void redrawWaterfall(int first, int last);
+    void scrollWaterfall(int lines);
 
     bool m_PeakHoldActive;
     bool m_PeakHoldValid;
     qint32 m_fftbuf[MAX_SCREENSIZE];
     qint32 m_fftPeakHoldBuf[MAX_SCREENSIZE];
-    double *m_fftData;     /*! pointer to incoming FFT data */
-    double *m_wfData;
+
+    /* Persistence display: a level x frequency histogram of the pandapter
+     * trace at screen resolution (h rows of w pixels) with exponential decay. */
+    bool    m_PersistActive;
+    bool    m_PersistValid;
+    quint16 m_PersistDecay;     /*! Decay factor per frame, 0.16 fixed point. */
+    quint16 m_PersistHit;       /*! Histogram increment per trace hit. */
+    std::vector<quint16> m_PersistHist;
+    QImage  m_PersistImage;
+    QRgb    m_PersistTbl[PERSIST_TBL_SIZE];
+    float  *m_fftData;     /*! pointer to incoming FFT data */
+    float  *m_wfData;
     int     m_fftDataSize;
+    qint64  m_DataStart;   /*! Frequency range covered by the FFT data. */
+    qint64  m_DataStop;
+
+    /* Cached mapping between FFT bins and screen pixels; pixel x shows the
+     * max of bins m_MapBinStart[x] to m_MapBinEnd[x]-1. */
+    qint32  m_MapBinStart[MAX_SCREENSIZE];
+    qint32  m_MapBinEnd[MAX_SCREENSIZE];
+    qint32  m_MapXmin, m_MapXmax;   /*! Pixels with FFT data. */
+    qint32  m_MapWidth;             /*! Parameters used for the mapping. */
+    qint64  m_MapStart, m_MapStop;
+    int     m_MapFftSize;
+    double  m_MapSampleFreq;
+
+    float   m_fftMax[MAX_SCREENSIZE]; /*! Pandapter data reduced to screen (dB). */
+    float   m_wfMax[MAX_SCREENSIZE];  /*! Waterfall data reduced to screen (dB). */
 
     int m_XAxisYCenter;
     int m_YAxisWidth;
@@ -181,8 +247,12 @@ private:
     eCapturetype m_CursorCaptured;
     QPixmap m_2DPixmap;
     QPixmap m_OverlayPixmap;
-    QPixmap m_WaterfallPixmap;
-    QColor m_ColorTbl[256];
+    QImage  m_WaterfallImage;   /*! Waterfall ring buffer, newest line at m_WaterfallOffset. */
+    int     m_WaterfallOffset;
+    CWaterfallHistory m_WfHistory;
+    int     m_WfHistoryOffset;  /*! Lines scrolled back in history, 0 = live. */
+    int     m_WfRedrawRow;      /*! Waterfall rows from here on need re-rendering. */
+    QRgb    m_ColorTbl[256];
     QSize m_Size;
     QString m_Str;
     QString m_HDivText[HORZ_DIVS_MAX+1];
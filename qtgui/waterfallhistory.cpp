@@ -0,0 +1,219 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           http://gqrx.dk/
+ *
+ * Copyright 2011-2014 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <cmath>
+#include "waterfallhistory.h"
+
+#define WF_HISTORY_BLOCK 256    /*!< Lines per allocation block. */
+
+/*! \brief Create a new waterfall history.
+ *  \param max_bytes Memory budget for the line data.
+ */
+CWaterfallHistory::CWaterfallHistory(size_t max_bytes)
+    : m_MaxBytes(max_bytes)
+{
+    clear();
+}
+
+/*! \brief Set the memory budget for the line data.
+ *  \param max_bytes The new budget in bytes.
+ *
+ * The history is cleared.
+ */
+void CWaterfallHistory::setMaxBytes(size_t max_bytes)
+{
+    m_MaxBytes = max_bytes;
+    clear();
+}
+
+/*! \brief Remove all lines and free the line data.
+ *
+ * The size of the lines is set again by the next addLine().
+ */
+void CWaterfallHistory::clear()
+{
+    m_Stride = 0;
+    m_Capacity = 0;
+    m_Count = 0;
+    m_Newest = 0;
+
+    std::vector<line_block>().swap(m_Blocks);
+}
+
+/*! \brief Start a new history with a given number of bytes per line.
+ *
+ * The capacity is the number of lines of this size that fit in the budget,
+ * rounded down to whole blocks. The blocks are allocated by addLine().
+ */
+void CWaterfallHistory::setStride(int stride)
+{
+    int blocks = qMax((int)(m_MaxBytes / ((size_t)stride * WF_HISTORY_BLOCK)), 1);
+
+    m_Stride = stride;
+    m_Capacity = blocks * WF_HISTORY_BLOCK;
+    m_Count = 0;
+    m_Newest = m_Capacity - 1;
+
+    std::vector<line_block>(blocks).swap(m_Blocks);
+}
+
+const CWaterfallHistory::line_info &CWaterfallHistory::lineInfo(int i) const
+{
+    return m_Blocks[i / WF_HISTORY_BLOCK].info[i % WF_HISTORY_BLOCK];
+}
+
+quint8 *CWaterfallHistory::lineData(int i)
+{
+    return &m_Blocks[i / WF_HISTORY_BLOCK].data[(i % WF_HISTORY_BLOCK) * m_Stride];
+}
+
+const quint8 *CWaterfallHistory::lineData(int i) const
+{
+    return &m_Blocks[i / WF_HISTORY_BLOCK].data[(i % WF_HISTORY_BLOCK) * m_Stride];
+}
+
+/*! \brief Add a new line, replacing the oldest one if the ring is full.
+ *  \param data FFT data in dB.
+ *  \param size Number of FFT bins.
+ *  \param start Frequency of the first bin in Hz.
+ *  \param stop Frequency after the last bin in Hz.
+ *  \param time Time stamp in ms.
+ *
+ * A line with more columns than the stored ones starts a new history, so
+ * that the resolution is not lost when the FFT size goes up.
+ */
+void CWaterfallHistory::addLine(const float *data, int size, qint64 start,
+                                qint64 stop, qint64 time)
+{
+    line_block *block;
+    line_info *info;
+    quint8    *line;
+    float      v;
+    int        cols;
+    int        c, b, b0, b1;
+
+    if ((size <= 0) || (stop <= start))
+        return;
+
+    cols = qMin(size, WF_HISTORY_COLS);
+    if ((m_Count == 0) || (cols > m_Stride))
+        setStride(cols);
+
+    m_Newest = (m_Newest + 1) % m_Capacity;
+    if (m_Count < m_Capacity)
+        m_Count++;
+
+    block = &m_Blocks[m_Newest / WF_HISTORY_BLOCK];
+    if (block->data.empty())
+    {
+        block->info.resize(WF_HISTORY_BLOCK);
+        block->data.resize(WF_HISTORY_BLOCK * m_Stride);
+    }
+
+    info = &block->info[m_Newest % WF_HISTORY_BLOCK];
+    info->time = time;
+    info->start = start;
+    info->stop = stop;
+    info->cols = cols;
+
+    line = lineData(m_Newest);
+    for (c = 0; c < cols; c++)
+    {
+        b0 = (int)((qint64)c * size / cols);
+        b1 = (int)((qint64)(c + 1) * size / cols);
+        v = data[b0];
+        for (b = b0 + 1; b < b1; b++)
+            if (data[b] > v)
+                v = data[b];
+
+        v = (v - WF_HISTORY_DB_MIN) / WF_HISTORY_DB_STEP + 0.5f;
+        line[c] = (quint8)qBound(0.0f, v, 255.0f);
+    }
+}
+
+/*! \brief Render a line for a frequency window.
+ *  \param n The line to render, 0 being the newest.
+ *  \param start Frequency at the left edge in Hz.
+ *  \param stop Frequency at the right edge in Hz.
+ *  \param out Output pixels.
+ *  \param width Number of output pixels.
+ *  \param lut Colors for the quantized values, see makeColorLut().
+ *  \param bg Color for pixels outside the line.
+ *
+ * Each pixel gets the peak value of the columns it covers.
+ */
+void CWaterfallHistory::renderLine(int n, qint64 start, qint64 stop,
+                                   QRgb *out, int width, const QRgb *lut,
+                                   QRgb bg) const
+{
+    const line_info &info = lineInfo(index(n));
+    const quint8 *line = lineData(index(n));
+    double  pos, step;
+    quint8  v;
+    int     x, c, c0, c1, lo, hi;
+
+    // column position of the left pixel edge and columns per pixel
+    pos = (double)(start - info.start) * info.cols / (info.stop - info.start);
+    step = (double)(stop - start) * info.cols / (info.stop - info.start) / width;
+
+    c0 = (int)floor(pos);
+    for (x = 0; x < width; x++)
+    {
+        c1 = (int)floor(pos + step * (x + 1));
+        if ((c1 <= 0 && c0 < 0) || (c0 >= info.cols))
+        {
+            out[x] = bg;
+        }
+        else
+        {
+            lo = qMax(c0, 0);
+            hi = qMin(qMax(c1, c0 + 1), info.cols);
+            v = line[lo];
+            for (c = lo + 1; c < hi; c++)
+                if (line[c] > v)
+                    v = line[c];
+            out[x] = lut[v];
+        }
+        c0 = c1;
+    }
+}
+
+/*! \brief Make a lookup table from quantized values to waterfall colors.
+ *  \param lut The 256 entry table to fill.
+ *  \param colors The 256 entry waterfall palette, weakest first.
+ *  \param mindB Level shown with colors[0].
+ *  \param maxdB Level shown with colors[255].
+ */
+void CWaterfallHistory::makeColorLut(QRgb *lut, const QRgb *colors,
+                                     double mindB, double maxdB)
+{
+    float   gain = 255.0f / fabs(maxdB - mindB);
+    float   db;
+    int     q, y;
+
+    for (q = 0; q < 256; q++)
+    {
+        db = WF_HISTORY_DB_MIN + q * WF_HISTORY_DB_STEP;
+        y = qBound(0, (int)(gain * ((float)maxdB - db)), 255);
+        lut[q] = colors[255 - y];
+    }
+}
@@ -0,0 +1,106 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           http://gqrx.dk/
+ *
+ * Copyright 2011-2014 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef WATERFALLHISTORY_H
+#define WATERFALLHISTORY_H
+
+#include <QtGlobal>
+#include <QRgb>
+#include <vector>
+
+#define WF_HISTORY_COLS   4096       /*!< Max columns stored per line. */
+#define WF_HISTORY_BYTES  (40 << 20) /*!< Default memory budget for the line data. */
+#define WF_HISTORY_DB_MIN (-150.0f)  /*!< dB level of quantized value 0. */
+#define WF_HISTORY_DB_STEP (0.625f)  /*!< dB per quantization step. */
+
+/*! \brief Ring buffer of past waterfall lines.
+ *
+ * Each line is stored as quantized dB values (8 bit, 0.625 dB steps from
+ * -150 to +9 dB) with its absolute frequency range and a time stamp, so
+ * that it can be re-rendered for any frequency window and dB scale. Lines
+ * with more than WF_HISTORY_COLS bins are peak-reduced to that width.
+ *
+ * A line takes as many bytes as the widest line since the last clear(), up
+ * to WF_HISTORY_COLS, so the number of lines that fit in the budget grows
+ * as the FFT size goes down. With the default budget and a 2048 point FFT
+ * the ring holds 20480 lines, which is over 11 minutes at 30 lines/s.
+ * Memory is allocated in blocks as lines arrive, a short history only
+ * takes what it needs.
+ */
+class CWaterfallHistory
+{
+public:
+    explicit CWaterfallHistory(size_t max_bytes = WF_HISTORY_BYTES);
+
+    void setMaxBytes(size_t max_bytes);
+
+    /*! \brief Memory budget for the line data. */
+    size_t maxBytes() const { return m_MaxBytes; }
+
+    void clear();
+    void addLine(const float *data, int size, qint64 start, qint64 stop,
+                 qint64 time);
+
+    /*! \brief Number of lines in the history. */
+    int count() const { return m_Count; }
+
+    /*! \brief Time stamp of line n, 0 being the newest. */
+    qint64 lineTime(int n) const { return lineInfo(index(n)).time; }
+
+    void renderLine(int n, qint64 start, qint64 stop, QRgb *out, int width,
+                    const QRgb *lut, QRgb bg) const;
+
+    static void makeColorLut(QRgb *lut, const QRgb *colors, double mindB,
+                             double maxdB);
+
+private:
+    struct line_info {
+        qint64  time;   /*!< Time stamp in ms. */
+        qint64  start;  /*!< Frequency of the first column in Hz. */
+        qint64  stop;   /*!< Frequency after the last column in Hz. */
+        int     cols;   /*!< Number of columns used. */
+    };
+
+    /*! \brief Lines allocated together. */
+    struct line_block {
+        std::vector<line_info>  info;   /*!< Line descriptions. */
+        std::vector<quint8>     data;   /*!< Quantized lines, m_Stride apart. */
+    };
+
+    /*! \brief Ring index of line n, 0 being the newest. */
+    int index(int n) const { return (m_Newest + m_Capacity - n) % m_Capacity; }
+
+    void setStride(int stride);
+    const line_info &lineInfo(int i) const;
+    quint8 *lineData(int i);
+    const quint8 *lineData(int i) const;
+
+    size_t  m_MaxBytes;     /*!< Memory budget for the line data. */
+    int     m_Stride;       /*!< Bytes per line. */
+    int     m_Capacity;     /*!< Max number of lines. */
+    int     m_Count;        /*!< Number of lines stored. */
+    int     m_Newest;       /*!< Ring index of the newest line. */
+
+    std::vector<line_block> m_Blocks;
+};
+
+#endif // WATERFALLHISTORY_H
@@ -20,12 +20,19 @@
  * the Free Software Foundation, Inc., 51 Franklin Street,
  * Boston, MA 02110-1301, USA.
  */
+#include <cmath>
 #include <iostream>
 #include "receivers/nbrx.h"
 
 #define PREF_QUAD_RATE  48000.0
 #define PREF_AUDIO_RATE 48000.0
 
+/* Inputs of the demodulator selector */
+#define SEL_SSB 0
+#define SEL_AM  1
+#define SEL_FM  2
+#define SEL_NUM 3
+
 nbrx_sptr make_nbrx(float quad_rate, float audio_rate)
 {
     return gnuradio::get_initial_sptr(new nbrx(quad_rate, audio_rate));
@@ -36,9 +43,12 @@ nbrx::nbrx(float quad_rate, float audio_rate)
       d_running(false),
       d_quad_rate(quad_rate),
       d_audio_rate(audio_rate),
+      d_offset(0.0),
+      d_decim(1),
+      d_use_resamp(false),
       d_demod(NBRX_DEMOD_FM)
 {
-    iq_resamp = make_resampler_cc(PREF_QUAD_RATE/d_quad_rate);
+    configure_input();
 
     nb = make_rx_nb_cc(PREF_QUAD_RATE, 3.3, 2.5);
     filter = make_rx_filter(PREF_QUAD_RATE, -5000.0, 5000.0, 1000.0);
@@ -48,16 +58,21 @@ nbrx::nbrx(float quad_rate, float audio_rate)
     demod_ssb = gr::blocks::complex_to_real::make(1);
     demod_fm = make_rx_demod_fm(PREF_QUAD_RATE, PREF_AUDIO_RATE, 5000.0, 75.0e-6);
     demod_am = make_rx_demod_am(PREF_QUAD_RATE, PREF_AUDIO_RATE, true);
+    demod_sel = make_rx_demod_selector_ff(SEL_NUM, 1, SEL_FM);
     audio_rr = make_resampler_ff(d_audio_rate/PREF_AUDIO_RATE);
 
-    connect(self(), 0, iq_resamp, 0);
-    connect(iq_resamp, 0, nb, 0);
+    connect_input();
     connect(nb, 0, filter, 0);
     connect(filter, 0, meter, 0);
     connect(filter, 0, sql, 0);
     connect(sql, 0, agc, 0);
+    connect(agc, 0, demod_ssb, 0);
+    connect(agc, 0, demod_am, 0);
     connect(agc, 0, demod_fm, 0);
-    connect(demod_fm, 0, audio_rr, 0);
+    connect(demod_ssb, 0, demod_sel, SEL_SSB);
+    connect(demod_am, 0, demod_sel, SEL_AM);
+    connect(demod_fm, 0, demod_sel, SEL_FM);
+    connect(demod_sel, 0, audio_rr, 0);
     connect(audio_rr, 0, self(), 0); // left  channel
     connect(audio_rr, 0, self(), 1); // right channel
     // FIXME: we only need audio_rr when audio_rate != PREF_AUDIO_RATE
@@ -90,13 +105,86 @@ void nbrx::set_quad_rate(float quad_rate)
 #ifndef QT_NO_DEBUG_OUTPUT
         std::cout << "Changing NB_RX quad rate: "  << d_quad_rate << " -> " << quad_rate << std::endl;
 #endif
-        d_quad_rate = quad_rate;
         lock();
-        iq_resamp->set_rate(PREF_QUAD_RATE/d_quad_rate);
+        disconnect_input();
+        d_quad_rate = quad_rate;
+        configure_input();
+        connect_input();
         unlock();
     }
 }
 
+/*! \brief Select the channel within the input.
+ *  \param offset_hz The channel offset from the center of the input.
+ */
+void nbrx::set_offset(double offset_hz)
+{
+    d_offset = offset_hz;
+    hb->set_offset(d_offset);
+}
+
+/*! \brief Create the input stage for the current quad rate.
+ *
+ * The channel is translated to 0 Hz and decimated by a power of two using
+ * a cascade of halfband filters that keeps the rate at or above
+ * PREF_QUAD_RATE. The halfband filters only need to protect the band that
+ * is passed by the resampler (0.4 * PREF_QUAD_RATE), which then takes the
+ * rate the rest of the way down to PREF_QUAD_RATE.
+ */
+void nbrx::configure_input(void)
+{
+    unsigned int stages;
+    double out_rate;
+
+    stages = rx_hb_decim_cc::calc_stages(d_quad_rate, PREF_QUAD_RATE);
+    d_decim = 1u << stages;
+    out_rate = d_quad_rate / d_decim;
+
+    hb.reset();
+    hb = make_rx_hb_decim_cc(d_quad_rate, stages, 0.4 * PREF_QUAD_RATE, d_offset);
+
+    d_use_resamp = fabs(out_rate - PREF_QUAD_RATE) > 0.5;
+    if (!iq_resamp)
+        iq_resamp = make_resampler_cc(PREF_QUAD_RATE / out_rate);
+    else if (d_use_resamp)
+        iq_resamp->set_rate(PREF_QUAD_RATE / out_rate);
+
+#ifndef QT_NO_DEBUG_OUTPUT
+    std::cout << "NB_RX input: " << stages << " halfband stages, resampler "
+              << (d_use_resamp ? PREF_QUAD_RATE / out_rate : 1.0) << std::endl;
+#endif
+}
+
+/*! \brief Connect halfband decimator and resampler between input and nb. */
+void nbrx::connect_input(void)
+{
+    connect(self(), 0, hb, 0);
+    if (d_use_resamp)
+    {
+        connect(hb, 0, iq_resamp, 0);
+        connect(iq_resamp, 0, nb, 0);
+    }
+    else
+    {
+        connect(hb, 0, nb, 0);
+    }
+}
+
+/*! \brief Disconnect halfband decimator and resampler. */
+void nbrx::disconnect_input(void)
+{
+    disconnect(self(), 0, hb, 0);
+    if (d_use_resamp)
+    {
+        disconnect(hb, 0, iq_resamp, 0);
+        disconnect(iq_resamp, 0, nb, 0);
+    }
+    else
+    {
+        disconnect(hb, 0, nb, 0);
+    }
+}
+
 void nbrx::set_audio_rate(float audio_rate)
 {
     (void) audio_rate;
@@ -172,75 +260,43 @@ void nbrx::set_agc_manual_gain(int gain)
     agc->set_manual_gain(gain);
 }
 
+/*! \brief Select demodulator.
+ *
+ * The demodulators are always connected so we only need to tell the
+ * selector which one to use. This does not require the flow graph to be
+ * locked or stopped.
+ */
 void nbrx::set_demod(int rx_demod)
 {
-    nbrx_demod current_demod = d_demod;
-
     /* check if new demodulator selection is valid */
     if ((rx_demod < NBRX_DEMOD_NONE) || (rx_demod >= NBRX_DEMOD_NUM))
         return;
 
-    if (rx_demod == current_demod) {
-        /* nothing to do */
-        return;
-    }
-
-    // for now we must depend on top level stop/lock
-    // because of https://github.com/csete/gqrx/issues/120
-    //lock();
-
-    /* disconnect current demodulator */
-    switch (current_demod) {
-
-    default:
-    case NBRX_DEMOD_NONE: /** FIXME! **/
-    case NBRX_DEMOD_SSB:
-        disconnect(agc, 0, demod_ssb, 0);
-        disconnect(demod_ssb, 0, audio_rr, 0);
-        break;
-
-    case NBRX_DEMOD_AM:
-        disconnect(agc, 0, demod_am, 0);
-        disconnect(demod_am, 0, audio_rr, 0);
-        break;
-
-    case NBRX_DEMOD_FM:
-        disconnect(agc, 0, demod_fm, 0);
-        disconnect(demod_fm, 0, audio_rr, 0);
-        break;
-    }
-
     switch (rx_demod) {
 
     case NBRX_DEMOD_NONE: /** FIXME! **/
     case NBRX_DEMOD_SSB:
         d_demod = NBRX_DEMOD_SSB;
-        connect(agc, 0, demod_ssb, 0);
-        connect(demod_ssb, 0, audio_rr, 0);
+        demod_sel->set_source(SEL_SSB);
         break;
 
     case NBRX_DEMOD_AM:
         d_demod = NBRX_DEMOD_AM;
-        connect(agc, 0, demod_am, 0);
-        connect(demod_am, 0, audio_rr, 0);
+        demod_sel->set_source(SEL_AM);
         break;
 
     case NBRX_DEMOD_FM:
-        d_demod = NBRX_DEMOD_FM;
-        connect(agc, 0, demod_fm, 0);
-        connect(demod_fm, 0, audio_rr, 0);
-        break;
-
     default:
-        /* use FMN */
         d_demod = NBRX_DEMOD_FM;
-        connect(agc, 0, demod_fm, 0);
-        connect(demod_fm, 0, audio_rr, 0);
+        demod_sel->set_source(SEL_FM);
         break;
     }
+}
 
-    /* continue processing */
-    //unlock();
+/*! \brief Get the latency of the last demodulator switch in seconds. */
+double nbrx::get_demod_latency()
+{
+    return demod_sel->get_switch_latency();
 }
 
 void nbrx::set_fm_maxdev(float maxdev_hz)
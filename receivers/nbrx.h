@@ -28,10 +28,12 @@
 #include "receivers/receiver_base.h"
 #include "dsp/rx_noise_blanker_cc.h"
 #include "dsp/rx_filter.h"
+#include "dsp/rx_hb_decim.h"
 #include "dsp/rx_meter.h"
 #include "dsp/rx_agc_xx.h"
 #include "dsp/rx_demod_fm.h"
 #include "dsp/rx_demod_am.h"
+#include "dsp/rx_demod_selector.h"
 //#include "dsp/resampler_ff.h"
 #include "dsp/resampler_xx.h"
 
@@ -46,6 +48,15 @@ nbrx_sptr make_nbrx(float quad_rate, float audio_rate);
  *  \ingroup RX
  *
  * This block provides receiver for AM, narrow band FM and SSB modes.
+ *
+ * The input is the full rate I/Q stream. The channel is selected with
+ * set_offset() and translated to 0 Hz by a halfband decimator cascade,
+ * which is followed by a fractional resampler when the input rate is not
+ * PREF_QUAD_RATE times a power of two.
+ *
+ * All demodulators are connected permanently and the audio is taken from
+ * one of them by a selector block, so that the demodulator can be changed
+ * while the flow graph is running.
  */
 class nbrx : public receiver_base_cf
 {
@@ -73,6 +84,10 @@ public:
 
     float get_signal_level(bool dbfs);
 
+    /* Frequency translation */
+    bool has_offset() { return true; }
+    void set_offset(double offset_hz);
+
     /* Noise blanker */
     bool has_nb() { return true; }
     void set_nb_on(int nbid, bool on);
@@ -93,6 +108,7 @@ public:
     void set_agc_manual_gain(int gain);
 
     void set_demod(int demod);
+    double get_demod_latency();
 
     /* FM parameters */
     bool has_fm() { return true; }
@@ -103,13 +119,22 @@ public:
     bool has_am() { return true; }
     void set_am_dcr(bool enabled);
 
+private:
+    void configure_input(void);
+    void connect_input(void);
+    void disconnect_input(void);
+
 private:
     bool   d_running;          /*!< Whether receiver is running or not. */
     float  d_quad_rate;        /*!< Input sample rate. */
     int    d_audio_rate;       /*!< Audio output rate. */
+    double d_offset;           /*!< Channel offset within the input. */
+    unsigned int d_decim;      /*!< Decimation in the halfband cascade. */
+    bool   d_use_resamp;       /*!< Whether the fractional resampler is needed. */
 
     nbrx_demod                d_demod;    /*!< Current demodulator. */
 
+    rx_hb_decim_cc_sptr       hb;          /*!< Translating halfband decimator. */
     resampler_cc_sptr         iq_resamp;   /*!< Baseband resampler. */
     rx_filter_sptr            filter;  /*!< Non-translating bandpass filter.*/
 
@@ -120,6 +145,7 @@ private:
     gr::blocks::complex_to_real::sptr   demod_ssb;  /*!< SSB demodulator. */
     rx_demod_fm_sptr          demod_fm;   /*!< FM demodulator. */
     rx_demod_am_sptr          demod_am;   /*!< AM demodulator. */
+    rx_demod_selector_ff_sptr demod_sel;  /*!< Demodulator selector. */
     resampler_ff_sptr         audio_rr;   /*!< Audio resampler. */
 
 };
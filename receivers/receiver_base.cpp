@@ -43,6 +43,21 @@ receiver_base_cf::~receiver_base_cf()
 }
 
 
+double receiver_base_cf::get_demod_latency()
+{
+    return 0.0;
+}
+
+bool receiver_base_cf::has_offset()
+{
+    return false;
+}
+
+void receiver_base_cf::set_offset(double offset_hz)
+{
+    (void) offset_hz;
+}
+
 bool receiver_base_cf::has_nb()
 {
     return false;
@@ -62,6 +62,13 @@ public:
 
     /* the rest is optional */
 
+    /* Time it took to switch to the current demodulator */
+    virtual double get_demod_latency();
+
+    /* Frequency translation (otherwise done by the caller) */
+    virtual bool has_offset();
+    virtual void set_offset(double offset_hz);
+
     /* Noise blanker */
     virtual bool has_nb();
     virtual void set_nb_on(int nbid, bool on);
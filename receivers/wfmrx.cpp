@@ -27,6 +27,11 @@
 #define PREF_QUAD_RATE   240e3 // Nominal channel spacing is 200 kHz
 #define PREF_MIDLE_RATE  120e3 // Midle rate for stereo decoder
 
+/* Inputs of the demodulator selector (two channels each) */
+#define SEL_MONO    0
+#define SEL_STEREO  1
+#define SEL_NUM     2
+
 wfmrx_sptr make_wfmrx(float quad_rate, float audio_rate)
 {
     return gnuradio::get_initial_sptr(new wfmrx(quad_rate, audio_rate));
@@ -44,20 +49,25 @@ wfmrx::wfmrx(float quad_rate, float audio_rate)
     filter = make_rx_filter(PREF_QUAD_RATE, -80000.0, 80000.0, 20000.0);
     sql = gr::analog::simple_squelch_cc::make(-150.0, 0.001);
     meter = make_rx_meter_c(DETECTOR_TYPE_RMS);
-    demod_fm = make_rx_demod_fm(PREF_QUAD_RATE, PREF_MIDLE_RATE, 75000.0, 50.0e-6);
-    midle_rr = make_resampler_ff(PREF_MIDLE_RATE/PREF_QUAD_RATE);
-    stereo = make_stereo_demod(PREF_MIDLE_RATE, d_audio_rate, true);
-    mono   = make_stereo_demod(PREF_MIDLE_RATE, d_audio_rate, false);
+    demod_fm = make_rx_demod_fm(PREF_QUAD_RATE, PREF_MIDLE_RATE, 75000.0, 0.0);
+    /* de-emphasis is done after the stereo decoder */
+    stereo = make_stereo_demod(PREF_MIDLE_RATE, d_audio_rate, true, 50.0e-6);
+    mono   = make_stereo_demod(PREF_MIDLE_RATE, d_audio_rate, false, 50.0e-6);
+    demod_sel = make_rx_demod_selector_ff(SEL_NUM, 2, SEL_MONO);
 
     connect(self(), 0, iq_resamp, 0);
     connect(iq_resamp, 0, filter, 0);
     connect(filter, 0, meter, 0);
     connect(filter, 0, sql, 0);
     connect(sql, 0, demod_fm, 0);
-    connect(demod_fm, 0, midle_rr, 0);
-    connect(midle_rr, 0, mono, 0);
-    connect(mono, 0, self(), 0); // left  channel
-    connect(mono, 1, self(), 1); // right channel
+    connect(demod_fm, 0, mono, 0);
+    connect(demod_fm, 0, stereo, 0);
+    connect(mono, 0, demod_sel, 2 * SEL_MONO);
+    connect(mono, 1, demod_sel, 2 * SEL_MONO + 1);
+    connect(stereo, 0, demod_sel, 2 * SEL_STEREO);
+    connect(stereo, 1, demod_sel, 2 * SEL_STEREO + 1);
+    connect(demod_sel, 0, self(), 0); // left  channel
+    connect(demod_sel, 1, self(), 1); // right channel
 }
 
 wfmrx::~wfmrx()
@@ -87,9 +97,7 @@ void wfmrx::set_quad_rate(float quad_rate)
         std::cout << "Changing NB_RX quad rate: "  << d_quad_rate << " -> " << quad_rate << std::endl;
 #endif
         d_quad_rate = quad_rate;
-        lock();
         iq_resamp->set_rate(PREF_QUAD_RATE/d_quad_rate);
-        unlock();
     }
 }
 
@@ -172,56 +180,36 @@ void nbrx::set_agc_manual_gain(int gain)
 }
 */
 
+/*! \brief Select demodulator.
+ *
+ * Both decoders are always connected so we only need to tell the selector
+ * which one to use. This does not require the flow graph to be locked.
+ */
 void wfmrx::set_demod(int demod)
 {
     /* check if new demodulator selection is valid */
     if ((demod < WFMRX_DEMOD_MONO) || (demod >= WFMRX_DEMOD_NUM))
         return;
 
-    if (demod == d_demod) {
-        /* nothing to do */
-        return;
-    }
-
-    /* lock graph while we reconfigure */
-    lock();
-
-    /* disconnect current demodulator */
-    switch (d_demod) {
-
-    case WFMRX_DEMOD_MONO:
-    default:
-        disconnect(midle_rr, 0, mono, 0);
-        disconnect(mono, 0, self(), 0); // left  channel
-        disconnect(mono, 1, self(), 1); // right channel
-        break;
-
-    case WFMRX_DEMOD_STEREO:
-    case WFMRX_DEMOD_STEREO_UKW: /** FIXME! **/
-        disconnect(midle_rr, 0, stereo, 0);
-        disconnect(stereo, 0, self(), 0); // left  channel
-        disconnect(stereo, 1, self(), 1); // right channel
-    }
-
     switch (demod) {
 
     case WFMRX_DEMOD_MONO:
     default:
-        connect(midle_rr, 0, mono, 0);
-        connect(mono, 0, self(), 0); // left  channel
-        connect(mono, 1, self(), 1); // right channel
+        demod_sel->set_source(SEL_MONO);
         break;
 
     case WFMRX_DEMOD_STEREO:
     case WFMRX_DEMOD_STEREO_UKW: /** FIXME! **/
-        connect(midle_rr, 0, stereo, 0);
-        connect(stereo, 0, self(), 0); // left  channel
-        connect(stereo, 1, self(), 1); // right channel
+        demod_sel->set_source(SEL_STEREO);
+        break;
     }
     d_demod = (wfmrx_demod) demod;
+}
 
-    /* continue processing */
-    unlock();
+/*! \brief Get the latency of the last demodulator switch in seconds. */
+double wfmrx::get_demod_latency()
+{
+    return demod_sel->get_switch_latency();
 }
 
 void wfmrx::set_fm_maxdev(float maxdev_hz)
@@ -231,5 +219,6 @@ void wfmrx::set_fm_maxdev(float maxdev_hz)
 
 void wfmrx::set_fm_deemph(double tau)
 {
-    demod_fm->set_tau(tau);
+    stereo->set_tau(tau);
+    mono->set_tau(tau);
 }
@@ -31,6 +31,7 @@
 #include "dsp/rx_meter.h"
 #include "dsp/rx_demod_fm.h"
 #include "dsp/stereo_demod.h"
+#include "dsp/rx_demod_selector.h"
 #include "dsp/resampler_xx.h"
 
 class wfmrx;
@@ -44,6 +45,10 @@ wfmrx_sptr make_wfmrx(float quad_rate, float audio_rate);
  *  \ingroup RX
  *
  * This block provides receiver for broadcast FM transmissions.
+ *
+ * The mono and stereo decoders are both connected and the audio is taken
+ * from one of them by a selector block, so that the demodulator can be
+ * changed while the flow graph is running.
  */
 class wfmrx : public receiver_base_cf
 {
@@ -89,6 +94,7 @@ public:
     void set_agc_manual_gain(int gain);*/
 
     void set_demod(int demod);
+    double get_demod_latency();
 
     /* FM parameters */
     bool has_fm() {return true; }
@@ -108,9 +114,9 @@ private:
     rx_meter_c_sptr           meter;     /*!< Signal strength. */
     gr::analog::simple_squelch_cc::sptr sql;       /*!< Squelch. */
     rx_demod_fm_sptr          demod_fm;  /*!< FM demodulator. */
-    resampler_ff_sptr         midle_rr;  /*!< Resampler. */
     stereo_demod_sptr         stereo;    /*!< FM stereo demodulator. */
     stereo_demod_sptr         mono;      /*!< FM stereo demodulator OFF. */
+    rx_demod_selector_ff_sptr demod_sel; /*!< Mono / stereo selector. */
 };
 
 #endif // WFMRX_H